@@ -0,0 +1,338 @@
+//--------------------------------------------------------------
+//
+//  AABBTree - dynamic bounding box tree and broad phase
+//
+
+#include "AABBTree.h"
+#include "TraversalStack.h"
+
+static Box combine(const Box& a, const Box& b) {
+	Box box = a;
+	box.expand(b);
+	return box;
+}
+
+static float boxArea(const Box& b) {
+	Vector3 size = b.parameters[1] - b.parameters[0];
+	return 2 * (size.x() * size.y() + size.y() * size.z() + size.z() * size.x());
+}
+
+// true if a contains b
+//
+static bool contains(const Box& a, const Box& b) {
+	for (int i = 0; i < 3; i++) {
+		if (b.parameters[0][i] < a.parameters[0][i] || b.parameters[1][i] > a.parameters[1][i]) return false;
+	}
+	return true;
+}
+
+void AABBTree::clear() {
+	nodes.clear();
+	root = -1;
+	freeList = -1;
+	proxyCount = 0;
+}
+
+int AABBTree::allocateNode() {
+	if (freeList == -1) {
+		nodes.push_back(AABBNode());
+		return nodes.size() - 1;
+	}
+	int node = freeList;
+	freeList = nodes[node].parent;
+	nodes[node] = AABBNode();
+	return node;
+}
+
+void AABBTree::freeNode(int node) {
+	nodes[node].parent = freeList;
+	nodes[node].height = -1;
+	freeList = node;
+}
+
+// insert:  add an object with box, return its proxy id
+//
+int AABBTree::insert(const Box& box, int userData) {
+	int proxy = allocateNode();
+	Vector3 m = Vector3(margin, margin, margin);
+	nodes[proxy].box = Box(box.parameters[0] - m, box.parameters[1] + m);
+	nodes[proxy].userData = userData;
+	nodes[proxy].height = 0;
+	nodes[proxy].moved = true;
+	insertLeaf(proxy);
+	proxyCount++;
+	return proxy;
+}
+
+void AABBTree::remove(int proxy) {
+	removeLeaf(proxy);
+	freeNode(proxy);
+	proxyCount--;
+}
+
+// update:  the object is now at box, having moved by displacement since
+//          the last frame.  nothing happens while box stays inside the
+//          fat box.  otherwise the leaf gets a new fat box, stretched in
+//          the direction of motion, and is reinserted.  true if it was
+//
+bool AABBTree::update(int proxy, const Box& box, const Vector3& displacement) {
+	if (contains(nodes[proxy].box, box)) return false;
+
+	removeLeaf(proxy);
+	Vector3 lo = box.parameters[0] - Vector3(margin, margin, margin);
+	Vector3 hi = box.parameters[1] + Vector3(margin, margin, margin);
+	Vector3 d = displacement * motionScale;
+	lo = Vector3(lo.x() + fminf(d.x(), 0), lo.y() + fminf(d.y(), 0), lo.z() + fminf(d.z(), 0));
+	hi = Vector3(hi.x() + fmaxf(d.x(), 0), hi.y() + fmaxf(d.y(), 0), hi.z() + fmaxf(d.z(), 0));
+	nodes[proxy].box = Box(lo, hi);
+	insertLeaf(proxy);
+	nodes[proxy].moved = true;
+	return true;
+}
+
+// insertLeaf:  walk down from the root to the sibling that makes the tree's
+//              total surface area grow least, put a new parent above it
+//              and rebalance back up to the root
+//
+void AABBTree::insertLeaf(int leaf) {
+	if (root == -1) {
+		root = leaf;
+		nodes[root].parent = -1;
+		return;
+	}
+
+	Box leafBox = nodes[leaf].box;
+	int index = root;
+	while (!nodes[index].isLeaf()) {
+		int child1 = nodes[index].child1;
+		int child2 = nodes[index].child2;
+		float area = boxArea(nodes[index].box);
+		float combinedArea = boxArea(combine(nodes[index].box, leafBox));
+
+		// cost of a new parent here, and the cost pushed down to a child
+		//
+		float cost = 2 * combinedArea;
+		float inheritanceCost = 2 * (combinedArea - area);
+
+		float cost1 = boxArea(combine(leafBox, nodes[child1].box)) + inheritanceCost;
+		if (!nodes[child1].isLeaf()) cost1 -= boxArea(nodes[child1].box);
+		float cost2 = boxArea(combine(leafBox, nodes[child2].box)) + inheritanceCost;
+		if (!nodes[child2].isLeaf()) cost2 -= boxArea(nodes[child2].box);
+
+		if (cost < cost1 && cost < cost2) break;
+		index = (cost1 < cost2) ? child1 : child2;
+	}
+	int sibling = index;
+
+	int oldParent = nodes[sibling].parent;
+	int newParent = allocateNode();
+	nodes[newParent].parent = oldParent;
+	nodes[newParent].box = combine(leafBox, nodes[sibling].box);
+	nodes[newParent].height = nodes[sibling].height + 1;
+	nodes[newParent].child1 = sibling;
+	nodes[newParent].child2 = leaf;
+	nodes[sibling].parent = newParent;
+	nodes[leaf].parent = newParent;
+	if (oldParent != -1) {
+		if (nodes[oldParent].child1 == sibling) nodes[oldParent].child1 = newParent;
+		else nodes[oldParent].child2 = newParent;
+	}
+	else root = newParent;
+
+	refit(nodes[leaf].parent);
+}
+
+void AABBTree::removeLeaf(int leaf) {
+	if (leaf == root) {
+		root = -1;
+		return;
+	}
+	int parent = nodes[leaf].parent;
+	int grandParent = nodes[parent].parent;
+	int sibling = (nodes[parent].child1 == leaf) ? nodes[parent].child2 : nodes[parent].child1;
+
+	if (grandParent != -1) {
+		if (nodes[grandParent].child1 == parent) nodes[grandParent].child1 = sibling;
+		else nodes[grandParent].child2 = sibling;
+		nodes[sibling].parent = grandParent;
+		freeNode(parent);
+		refit(grandParent);
+	}
+	else {
+		root = sibling;
+		nodes[sibling].parent = -1;
+		freeNode(parent);
+	}
+}
+
+// refit:  rebalance and recompute boxes and heights from node to the root
+//
+void AABBTree::refit(int node) {
+	int index = node;
+	while (index != -1) {
+		index = balance(index);
+		int child1 = nodes[index].child1;
+		int child2 = nodes[index].child2;
+		nodes[index].height = 1 + max(nodes[child1].height, nodes[child2].height);
+		nodes[index].box = combine(nodes[child1].box, nodes[child2].box);
+		index = nodes[index].parent;
+	}
+}
+
+// balance:  if the children of a differ in height by more than one, rotate
+//           the taller child up.  its taller grandchild stays under it and
+//           the shorter one moves under a.  returns the new subtree root
+//
+int AABBTree::balance(int iA) {
+	if (nodes[iA].isLeaf() || nodes[iA].height < 2) return iA;
+
+	int iB = nodes[iA].child1;
+	int iC = nodes[iA].child2;
+	int diff = nodes[iC].height - nodes[iB].height;
+	if (diff >= -1 && diff <= 1) return iA;
+
+	// up is the child moving up, keep is a's child that stays
+	//
+	int up = (diff > 1) ? iC : iB;
+	int keep = (diff > 1) ? iB : iC;
+	int iF = nodes[up].child1;
+	int iG = nodes[up].child2;
+
+	nodes[up].child1 = iA;
+	nodes[up].parent = nodes[iA].parent;
+	nodes[iA].parent = up;
+	if (nodes[up].parent != -1) {
+		int p = nodes[up].parent;
+		if (nodes[p].child1 == iA) nodes[p].child1 = up;
+		else nodes[p].child2 = up;
+	}
+	else root = up;
+
+	// taller grandchild stays with up, the other replaces up under a
+	//
+	int tall = (nodes[iF].height > nodes[iG].height) ? iF : iG;
+	int shortG = (tall == iF) ? iG : iF;
+	nodes[up].child2 = tall;
+	if (diff > 1) nodes[iA].child2 = shortG;
+	else nodes[iA].child1 = shortG;
+	nodes[shortG].parent = iA;
+
+	nodes[iA].box = combine(nodes[keep].box, nodes[shortG].box);
+	nodes[iA].height = 1 + max(nodes[keep].height, nodes[shortG].height);
+	nodes[up].box = combine(nodes[iA].box, nodes[tall].box);
+	nodes[up].height = 1 + max(nodes[iA].height, nodes[tall].height);
+	return up;
+}
+
+// query:  proxies whose fat boxes overlap box
+//
+void AABBTree::query(const Box& box, vector<int>& proxiesRtn) const {
+	if (root == -1) return;
+	TraversalStack<int, 256> stack;
+	stack.push(root);
+	while (!stack.empty()) {
+		int index = stack.pop();
+		Box nodeBox = nodes[index].box;
+		if (!nodeBox.overlap(box)) continue;
+		if (nodes[index].isLeaf()) {
+			proxiesRtn.push_back(index);
+			continue;
+		}
+		stack.push(nodes[index].child1);
+		stack.push(nodes[index].child2);
+	}
+}
+
+//--------------------------------------------------------------
+// BroadPhase
+//
+
+int BroadPhase::addBody(const Box& box, int userData) {
+	int proxy = tree.insert(box, userData);
+	moveBuffer.push_back(proxy);
+	return proxy;
+}
+
+void BroadPhase::removeBody(int proxy) {
+	for (int i = 0; i < moveBuffer.size(); i++) {
+		if (moveBuffer[i] == proxy) moveBuffer[i] = -1;
+	}
+	int n = 0;
+	for (int i = 0; i < pairs.size(); i++) {
+		if (pairs[i].a != proxy && pairs[i].b != proxy) pairs[n++] = pairs[i];
+	}
+	pairs.resize(n);
+	tree.remove(proxy);
+}
+
+void BroadPhase::moveBody(int proxy, const Box& box, const Vector3& displacement) {
+	bool alreadyMoved = tree.wasMoved(proxy);
+	if (tree.update(proxy, box, displacement) && !alreadyMoved) moveBuffer.push_back(proxy);
+}
+
+void BroadPhase::clear() {
+	tree.clear();
+	moveBuffer.clear();
+	pairs.clear();
+}
+
+int BroadPhase::findPairs() {
+	if (dropFlags.size() < tree.nodes.size()) dropFlags.resize(tree.nodes.size(), 0);
+
+	// pairs with a moved object are found again from scratch
+	//
+	for (int i = 0; i < moveBuffer.size(); i++) {
+		if (moveBuffer[i] != -1) dropFlags[moveBuffer[i]] = 1;
+	}
+	int n = 0;
+	for (int i = 0; i < pairs.size(); i++) {
+		if (!dropFlags[pairs[i].a] && !dropFlags[pairs[i].b]) pairs[n++] = pairs[i];
+	}
+	pairs.resize(n);
+
+	vector<int> hits;
+	for (int i = 0; i < moveBuffer.size(); i++) {
+		int proxy = moveBuffer[i];
+		if (proxy == -1) continue;
+		hits.clear();
+		tree.query(tree.getFatBox(proxy), hits);
+		for (int j = 0; j < hits.size(); j++) {
+			int other = hits[j];
+			if (other == proxy) continue;
+
+			// both moved:  only report it from the lower proxy
+			//
+			if (dropFlags[other] && other < proxy) continue;
+			BodyPair pair;
+			pair.a = min(proxy, other);
+			pair.b = max(proxy, other);
+			pairs.push_back(pair);
+		}
+	}
+	for (int i = 0; i < moveBuffer.size(); i++) {
+		if (moveBuffer[i] != -1) dropFlags[moveBuffer[i]] = 0;
+	}
+	sort(pairs.begin(), pairs.end());
+	return pairs.size();
+}
+
+// findTerrainCandidates:  every object whose fat box overlaps terrain faces,
+//                         with those faces, for the terrain narrow phase
+//
+int BroadPhase::findTerrainCandidates(const SpatialIndex& terrain, vector<TerrainCandidate>& candidatesRtn) {
+	candidatesRtn.clear();
+	for (int i = 0; i < tree.nodes.size(); i++) {
+		if (tree.nodes[i].height != 0) continue;
+		TerrainCandidate c;
+		c.proxy = i;
+		if (terrain.overlap(tree.nodes[i].box, c.faces) > 0) candidatesRtn.push_back(c);
+	}
+	return candidatesRtn.size();
+}
+
+void BroadPhase::endFrame() {
+	for (int i = 0; i < moveBuffer.size(); i++) {
+		if (moveBuffer[i] != -1) tree.clearMoved(moveBuffer[i]);
+	}
+	moveBuffer.clear();
+}
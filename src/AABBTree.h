@@ -0,0 +1,116 @@
+//--------------------------------------------------------------
+//
+//  AABBTree - dynamic bounding box tree for moving objects
+//
+//  Every object gets a leaf holding a "fat" box:  its real box grown
+//  by a margin and stretched along its motion, so small moves don't
+//  touch the tree at all.  When an object leaves its fat box the leaf
+//  is taken out and put back in (insert walks down picking the child
+//  that grows least in surface area).  After every insert or remove
+//  the path to the root is rebalanced with AVL style rotations, so
+//  the tree stays O(log n) deep however the objects move.
+//
+//  This is the tree used by Box2D / Bullet (b2DynamicTree,
+//  btDbvt):
+//
+//      Erin Catto, "Dynamic Bounding Volume Hierarchies", GDC 2019
+//
+//  BroadPhase keeps the list of objects that moved this frame and,
+//  from it, the object pairs whose fat boxes overlap and the objects
+//  whose boxes reach the terrain.
+//
+#pragma once
+#include "ofMain.h"
+#include "box.h"
+#include "SpatialIndex.h"
+
+class AABBNode {
+public:
+	bool isLeaf() const { return child1 == -1; }
+
+	Box box;
+	int userData = -1;
+	int parent = -1;	// next free node when on the free list
+	int child1 = -1;
+	int child2 = -1;
+	int height = -1;	// 0 for leaves, -1 when free
+	bool moved = false;
+};
+
+class AABBTree {
+public:
+	int insert(const Box& box, int userData);
+	void remove(int proxy);
+	bool update(int proxy, const Box& box, const Vector3& displacement);
+	void clear();
+
+	void query(const Box& box, vector<int>& proxiesRtn) const;
+	const Box& getFatBox(int proxy) const { return nodes[proxy].box; }
+	int getUserData(int proxy) const { return nodes[proxy].userData; }
+	int getHeight() const { return root == -1 ? 0 : nodes[root].height; }
+	int getProxyCount() const { return proxyCount; }
+	bool wasMoved(int proxy) const { return nodes[proxy].moved; }
+	void clearMoved(int proxy) { nodes[proxy].moved = false; }
+
+	vector<AABBNode> nodes;
+	int root = -1;
+	float margin = .1;		// fat box growth on every side
+	float motionScale = 4;	// fat box stretched by this many frames of motion
+
+private:
+	int allocateNode();
+	void freeNode(int node);
+	void insertLeaf(int leaf);
+	void removeLeaf(int leaf);
+	int balance(int node);
+	void refit(int node);
+
+	int freeList = -1;
+	int proxyCount = 0;
+};
+
+// pair of overlapping objects (proxy ids, a < b)
+//
+class BodyPair {
+public:
+	int a, b;
+	bool operator<(const BodyPair& p) const { return a < p.a || (a == p.a && b < p.b); }
+	bool operator==(const BodyPair& p) const { return a == p.a && b == p.b; }
+};
+
+// object near terrain:  the faces under its fat box
+//
+class TerrainCandidate {
+public:
+	int proxy;
+	vector<int> faces;
+};
+
+class BroadPhase {
+public:
+	int addBody(const Box& box, int userData);
+	void removeBody(int proxy);
+	void moveBody(int proxy, const Box& box, const Vector3& displacement);
+	void clear();
+
+	// bring the pair list up to date.  only objects that left their fat
+	// box this frame are queried, pairs between two objects that stayed
+	// put carry over from the last frame.  returns number of pairs
+	//
+	int findPairs();
+
+	// objects that moved this frame and whose boxes overlap terrain faces
+	//
+	int findTerrainCandidates(const SpatialIndex& terrain, vector<TerrainCandidate>& candidatesRtn);
+
+	// end of frame:  forget which objects moved
+	//
+	void endFrame();
+
+	AABBTree tree;
+	vector<int> moveBuffer;
+	vector<BodyPair> pairs;		// all overlapping fat box pairs, sorted
+
+private:
+	vector<char> dropFlags;		// per proxy, set while its old pairs are dropped
+};
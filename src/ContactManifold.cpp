@@ -0,0 +1,162 @@
+//--------------------------------------------------------------
+//
+//  ContactManifold - lander / terrain contact points
+//
+
+
+#include "ContactManifold.h"
+#include <float.h>
+
+static bool samePairs(const vector<TriContact>& a, const vector<TriContact>& b) {
+	if (a.size() != b.size()) return false;
+	for (int i = 0; i < a.size(); i++) {
+		if (!(a[i] == b[i])) return false;
+	}
+	return true;
+}
+
+// true if p (already on the plane of t) is inside triangle t
+//
+static bool insideTriangle(const Vector3& p, const Vector3 t[3], const Vector3& n) {
+	for (int i = 0; i < 3; i++) {
+		Vector3 e = t[(i + 1) % 3] - t[i];
+		if (((e ^ (p - t[i])) * n) < 0) return false;
+	}
+	return true;
+}
+
+void ContactManifold::clear() {
+	points.clear();
+	pairs.clear();
+	normal = Vector3(0, 1, 0);
+	depth = 0;
+	framesInContact = 0;
+	bReused = false;
+}
+
+// update:  build the manifold from this frame's triangle pairs (sorted, as
+//          returned by MeshBVH::collide).  return true if there is contact
+//
+bool ContactManifold::update(const Octree& octree, const MeshBVH& bvh, const glm::mat4& modelToWorld,
+	const vector<TriContact>& contacts)
+{
+	if (contacts.size() == 0) {
+		clear();
+		return false;
+	}
+
+	// nothing moved and same faces touching, keep what we have
+	//
+	vector<TriContact> last;
+	for (int i = 0; i < pairs.size(); i++) last.push_back(pairs[i].pair);
+	bReused = (framesInContact > 0 && lastTransform == modelToWorld && samePairs(last, contacts));
+	framesInContact++;
+	if (bReused) return true;
+
+	// refresh the pair cache, reusing face data of pairs still in contact
+	// (both lists are sorted so this is a merge)
+	//
+	vector<PairCache> newPairs;
+	newPairs.reserve(contacts.size());
+	int j = 0;
+	for (int i = 0; i < contacts.size(); i++) {
+		while (j < pairs.size() && pairs[j].pair < contacts[i]) j++;
+		if (j < pairs.size() && pairs[j].pair == contacts[i]) {
+			newPairs.push_back(pairs[j]);
+			continue;
+		}
+		PairCache pc;
+		pc.pair = contacts[i];
+		octree.getFaceVerts(contacts[i].terrainFace, pc.face);
+		pc.faceNormal = (pc.face[1] - pc.face[0]) ^ (pc.face[2] - pc.face[0]);
+		pc.faceNormal.normalize();
+		if (pc.faceNormal.y() < 0) pc.faceNormal = -pc.faceNormal;
+		newPairs.push_back(pc);
+	}
+	pairs.swap(newPairs);
+	lastTransform = modelToWorld;
+
+	vector<ContactPoint> candidates;
+	candidates.reserve(pairs.size());
+	for (int i = 0; i < pairs.size(); i++) {
+		candidates.push_back(contactPoint(pairs[i], bvh.tris[pairs[i].pair.landerTri], modelToWorld));
+	}
+
+	// manifold normal is the depth weighted average of the face normals
+	// (plain average if everything is just touching)
+	//
+	Vector3 sum = Vector3(0, 0, 0);
+	depth = 0;
+	for (int i = 0; i < candidates.size(); i++) {
+		sum = sum + candidates[i].normal * (candidates[i].depth + 1e-4f);
+		depth = fmaxf(depth, candidates[i].depth);
+	}
+	normal = sum;
+	normal.normalize();
+
+	reduce(candidates);
+	return true;
+}
+
+// contactPoint:  deepest lander vertex under the terrain face.  only vertices
+//                that project inside the face count, so a long lander
+//                triangle crossing the face edge does not report a huge depth
+//
+ContactPoint ContactManifold::contactPoint(const PairCache& pc, const BVHTri& tri, const glm::mat4& modelToWorld) {
+	ContactPoint c;
+	c.normal = pc.faceNormal;
+	c.depth = 0;
+
+	float nearest = 0;
+	for (int i = 0; i < 3; i++) {
+		Vector3 p = MeshBVH::transformPoint(modelToWorld, tri.v[i]);
+		float dist = (p - pc.face[0]) * pc.faceNormal;
+		Vector3 onPlane = p - pc.faceNormal * dist;
+		if (dist < 0 && -dist > c.depth && insideTriangle(onPlane, pc.face, pc.faceNormal)) {
+			c.depth = -dist;
+			c.point = onPlane;
+		}
+		if (i == 0 || fabsf(dist) < nearest) {
+			nearest = fabsf(dist);
+			if (c.depth == 0) c.point = onPlane;
+		}
+	}
+	return c;
+}
+
+// reduce:  keep at most maxPoints points - the deepest one, then the points
+//          that spread the manifold out the most
+//
+void ContactManifold::reduce(vector<ContactPoint>& candidates) {
+	points.clear();
+	if (candidates.size() <= maxPoints) {
+		points = candidates;
+		return;
+	}
+
+	int best = 0;
+	for (int i = 1; i < candidates.size(); i++) {
+		if (candidates[i].depth > candidates[best].depth) best = i;
+	}
+	points.push_back(candidates[best]);
+
+	while (points.size() < maxPoints) {
+		best = -1;
+		float bestDist = -1;
+		for (int i = 0; i < candidates.size(); i++) {
+			// distance to the closest point already chosen
+			//
+			float d = FLT_MAX;
+			for (int k = 0; k < points.size(); k++) {
+				Vector3 v = candidates[i].point - points[k].point;
+				d = fminf(d, v * v);
+			}
+			if (d > bestDist) {
+				bestDist = d;
+				best = i;
+			}
+		}
+		if (bestDist <= 0) break;
+		points.push_back(candidates[best]);
+	}
+}
@@ -0,0 +1,53 @@
+//--------------------------------------------------------------
+//
+//  ContactManifold - contact points, normal and penetration depth
+//  between the lander and the terrain, built from the triangle
+//  pairs found by the narrow phase (MeshBVH::collide).
+//
+//  The manifold is kept from frame to frame.  If the lander has not
+//  moved and touches the same faces it is returned as is; otherwise
+//  pairs that were already in contact keep their cached terrain face
+//  data and only the depth is recomputed.
+//
+#pragma once
+#include "ofMain.h"
+#include "Octree.h"
+#include "MeshBVH.h"
+
+class ContactPoint {
+public:
+	Vector3 point;		// on the terrain surface
+	Vector3 normal;		// terrain face normal (pointing up, out of the ground)
+	float depth;		// how far the lander is below the surface, >= 0
+};
+
+class ContactManifold {
+public:
+	bool update(const Octree& octree, const MeshBVH& bvh, const glm::mat4& modelToWorld,
+		const vector<TriContact>& contacts);
+	void clear();
+
+	vector<ContactPoint> points;	// reduced set, at most maxPoints
+	Vector3 normal = Vector3(0, 1, 0);
+	float depth = 0;
+	int framesInContact = 0;
+	bool bReused = false;		// true if last update() returned the cached manifold
+
+	static const int maxPoints = 4;
+
+private:
+	// per triangle pair data that does not change while the pair persists
+	//
+	class PairCache {
+	public:
+		TriContact pair;
+		Vector3 face[3];
+		Vector3 faceNormal;
+	};
+
+	ContactPoint contactPoint(const PairCache& pc, const BVHTri& tri, const glm::mat4& modelToWorld);
+	void reduce(vector<ContactPoint>& candidates);
+
+	vector<PairCache> pairs;
+	glm::mat4 lastTransform;
+};
@@ -0,0 +1,144 @@
+#include "Frustum.h"
+
+// row i of a (column major) glm matrix
+//
+static glm::vec4 row(const glm::mat4& m, int i) {
+	return glm::vec4(m[0][i], m[1][i], m[2][i], m[3][i]);
+}
+
+void Frustum::setPlane(int i, const glm::vec4& p) {
+	Vector3 n = Vector3(p.x, p.y, p.z);
+	float len = n.length();
+	if (len == 0) len = 1;
+	planes[i].normal = n / len;
+	planes[i].d = p.w / len;
+}
+
+// a point is inside when -w <= x, y, z <= w in clip space, each of the six
+// inequalities is a plane
+//
+Frustum::Frustum(const glm::mat4& m) {
+	glm::vec4 r0 = row(m, 0), r1 = row(m, 1), r2 = row(m, 2), r3 = row(m, 3);
+	setPlane(0, r3 + r0);
+	setPlane(1, r3 - r0);
+	setPlane(2, r3 + r1);
+	setPlane(3, r3 - r1);
+	setPlane(4, r3 + r2);
+	setPlane(5, r3 - r2);
+}
+
+// same as above, but the side planes go through the edges of the screen
+// rectangle:  x0 <= x / w <= x1  becomes  x - x0 * w >= 0  and  x1 * w - x >= 0
+//
+Frustum Frustum::fromScreenRect(const glm::mat4& m, const ofRectangle& viewport, const ofRectangle& rect) {
+	float x0 = 2 * (rect.x - viewport.x) / viewport.width - 1;
+	float x1 = 2 * (rect.x + rect.width - viewport.x) / viewport.width - 1;
+	float y0 = 1 - 2 * (rect.y + rect.height - viewport.y) / viewport.height;
+	float y1 = 1 - 2 * (rect.y - viewport.y) / viewport.height;
+	if (x0 > x1) swap(x0, x1);
+	if (y0 > y1) swap(y0, y1);
+
+	glm::vec4 r0 = row(m, 0), r1 = row(m, 1), r2 = row(m, 2), r3 = row(m, 3);
+	Frustum f;
+	f.setPlane(0, r0 - r3 * x0);
+	f.setPlane(1, r3 * x1 - r0);
+	f.setPlane(2, r1 - r3 * y0);
+	f.setPlane(3, r3 * y1 - r1);
+	f.setPlane(4, r3 + r2);
+	f.setPlane(5, r3 - r2);
+	return f;
+}
+
+// classify:  test the box corner furthest along each plane normal (outside if
+//            that is behind the plane) and the nearest corner (inside only if
+//            it is in front of every plane)
+//
+Frustum::Classify Frustum::classify(const Box& box) const {
+	Classify result = Inside;
+	for (int i = 0; i < 6; i++) {
+		const Vector3& n = planes[i].normal;
+		Vector3 pos = Vector3(n.x() >= 0 ? box.parameters[1].x() : box.parameters[0].x(),
+			n.y() >= 0 ? box.parameters[1].y() : box.parameters[0].y(),
+			n.z() >= 0 ? box.parameters[1].z() : box.parameters[0].z());
+		if (planes[i].distance(pos) < 0) return Outside;
+		Vector3 neg = Vector3(n.x() >= 0 ? box.parameters[0].x() : box.parameters[1].x(),
+			n.y() >= 0 ? box.parameters[0].y() : box.parameters[1].y(),
+			n.z() >= 0 ? box.parameters[0].z() : box.parameters[1].z());
+		if (planes[i].distance(neg) < 0) result = Intersect;
+	}
+	return result;
+}
+
+bool Frustum::inside(const Vector3& p) const {
+	for (int i = 0; i < 6; i++) {
+		if (planes[i].distance(p) < 0) return false;
+	}
+	return true;
+}
+
+// direction from the eye through screen pixel (x, y)
+//
+Vector3 PickCone::screenRay(const glm::mat4& inverse, float x, float y) const {
+	float nx = 2 * (x - viewport.x) / viewport.width - 1;
+	float ny = 1 - 2 * (y - viewport.y) / viewport.height;
+	glm::vec4 p = inverse * glm::vec4(nx, ny, -1, 1);
+	Vector3 dir = Vector3(p.x / p.w, p.y / p.w, p.z / p.w) - eye;
+	dir.normalize();
+	return dir;
+}
+
+// the cone axis goes through the mouse; the angle is the widest of the rays
+// through the edge of the pixel circle, plus a margin so the cone is never
+// smaller than the circle
+//
+PickCone::PickCone(const glm::mat4& vp, const ofRectangle& view, const Vector3& e,
+	float x, float y, float r)
+{
+	viewProjection = vp;
+	viewport = view;
+	mouseX = x;
+	mouseY = y;
+	radius = r;
+	eye = e;
+
+	glm::mat4 inverse = glm::inverse(vp);
+	axis = screenRay(inverse, x, y);
+	cosAngle = 1;
+	for (int i = 0; i < 8; i++) {
+		float a = i * PI / 4;
+		Vector3 dir = screenRay(inverse, x + r * cos(a), y + r * sin(a));
+		cosAngle = fminf(cosAngle, dir * axis);
+	}
+	float angle = fminf(acos(cosAngle) * 1.1f + 1e-4f, PI / 2);
+	cosAngle = cos(angle);
+	sinAngle = sin(angle);
+}
+
+// mayContain:  does the box's bounding sphere touch the cone
+//
+bool PickCone::mayContain(const Box& box) const {
+	Vector3 c = (box.parameters[0] + box.parameters[1]) * .5;
+	float r = (box.parameters[1] - box.parameters[0]).length() * .5f;
+
+	Vector3 d = c - (eye - axis * (r / sinAngle));
+	float len = d.length();
+	if (axis * d < len * cosAngle) return false;
+
+	d = c - eye;
+	len = d.length();
+	if (-(axis * d) >= len * sinAngle) return len <= r;
+	return true;
+}
+
+// inside:  point in front of the camera that projects within radius
+//          pixels of the mouse
+//
+bool PickCone::inside(const Vector3& p) const {
+	glm::vec4 clip = viewProjection * glm::vec4(p.x(), p.y(), p.z(), 1);
+	if (clip.w <= 0) return false;
+	float sx = (clip.x / clip.w + 1) / 2 * viewport.width + viewport.x;
+	float sy = (1 - clip.y / clip.w) / 2 * viewport.height + viewport.y;
+	float dx = sx - mouseX;
+	float dy = sy - mouseY;
+	return dx * dx + dy * dy < radius * radius;
+}
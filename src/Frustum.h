@@ -0,0 +1,74 @@
+#ifndef _FRUSTUM_H_
+#define _FRUSTUM_H_
+
+#include "ofMain.h"
+#include "vector3.h"
+#include "box.h"
+
+/*
+ * View frustum as 6 planes, extracted from a view-projection matrix as
+ * described in:
+ *
+ *      Gil Gribb and Klaus Hartmann
+ *      "Fast Extraction of Viewing Frustum Planes from the
+ *       World-View-Projection Matrix", 2001
+ *
+ * Plane normals point into the frustum.
+ *
+ * PickCone is the cone of rays through a circle of pixels around the mouse,
+ * for picking.  The cone is only used to throw away boxes; points are then
+ * tested exactly by projecting them to the screen (same math as
+ * ofCamera::worldToScreen).
+ *
+ */
+
+class Plane {
+public:
+	Vector3 normal;
+	float d;
+
+	float distance(const Vector3& p) const { return normal * p + d; }
+};
+
+class Frustum {
+public:
+	enum Classify { Outside, Inside, Intersect };
+
+	Frustum() { }
+	Frustum(const glm::mat4& viewProjection);
+
+	// sub-frustum through a screen rectangle (pixels, y down) of the viewport
+	static Frustum fromScreenRect(const glm::mat4& viewProjection, const ofRectangle& viewport,
+		const ofRectangle& rect);
+
+	Classify classify(const Box& box) const;
+	bool inside(const Vector3& p) const;
+
+	Plane planes[6];	// left, right, bottom, top, near, far
+
+private:
+	void setPlane(int i, const glm::vec4& p);
+};
+
+class PickCone {
+public:
+	PickCone(const glm::mat4& viewProjection, const ofRectangle& viewport, const Vector3& eye,
+		float mouseX, float mouseY, float radius);
+
+	bool mayContain(const Box& box) const;
+	bool inside(const Vector3& p) const;
+
+	glm::mat4 viewProjection;
+	ofRectangle viewport;
+	float mouseX, mouseY;
+	float radius;		// pixels
+
+	Vector3 eye;
+	Vector3 axis;
+	float cosAngle, sinAngle;
+
+private:
+	Vector3 screenRay(const glm::mat4& inverse, float x, float y) const;
+};
+
+#endif // _FRUSTUM_H_
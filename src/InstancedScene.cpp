@@ -0,0 +1,173 @@
+//--------------------------------------------------------------
+//
+//  InstancedScene - two level index for many copies of a few meshes
+//
+
+#include "InstancedScene.h"
+#include "MeshBVH.h"
+#include "TraversalStack.h"
+
+InstancedScene::~InstancedScene() {
+	clear();
+}
+
+void InstancedScene::clear() {
+	for (int i = 0; i < meshes.size(); i++) delete meshes[i];
+	meshes.clear();
+	instances.clear();
+	top.clear();
+}
+
+// addMesh:  index a mesh (in its own space) for use by instances.
+//           returns mesh id
+//
+int InstancedScene::addMesh(const ofMesh& mesh) {
+	OctreeIndex* index = new OctreeIndex();
+	index->build(mesh);
+	meshes.push_back(index);
+	return meshes.size() - 1;
+}
+
+Box InstancedScene::worldBox(int mesh, const glm::mat4& transform) const {
+	return MeshBVH::transformBox(transform, meshes[mesh]->octree->root.faceBounds);
+}
+
+// addInstance:  place a copy of mesh with transform (mesh to world).
+//               returns instance id
+//
+int InstancedScene::addInstance(int mesh, const glm::mat4& transform) {
+	MeshInstance inst;
+	inst.mesh = mesh;
+	inst.transform = transform;
+	inst.inverse = glm::inverse(transform);
+	inst.worldBox = worldBox(mesh, transform);
+	inst.proxy = top.insert(inst.worldBox, instances.size());
+	instances.push_back(inst);
+	return instances.size() - 1;
+}
+
+// moveInstance:  new transform for an instance.  only its top level leaf
+//                changes (and only if it left its fat box)
+//
+void InstancedScene::moveInstance(int instance, const glm::mat4& transform) {
+	MeshInstance& inst = instances[instance];
+	Box box = worldBox(inst.mesh, transform);
+	Vector3 displacement = box.center() - inst.worldBox.center();
+	inst.transform = transform;
+	inst.inverse = glm::inverse(transform);
+	inst.worldBox = box;
+	top.update(inst.proxy, box, displacement);
+	top.clearMoved(inst.proxy);
+}
+
+void InstancedScene::removeInstance(int instance) {
+	MeshInstance& inst = instances[instance];
+	if (inst.mesh == -1) return;
+	top.remove(inst.proxy);
+	inst.mesh = -1;
+	inst.proxy = -1;
+}
+
+// toInstance:  world ray to instance space, t is kept
+//
+Ray InstancedScene::toInstance(const MeshInstance& inst, const Ray& ray) {
+	glm::vec4 o = inst.inverse * glm::vec4(ray.origin.x(), ray.origin.y(), ray.origin.z(), 1);
+	glm::vec4 d = inst.inverse * glm::vec4(ray.direction.x(), ray.direction.y(), ray.direction.z(), 0);
+	return makeRay(Vector3(o.x, o.y, o.z), Vector3(d.x, d.y, d.z));
+}
+
+// intersectRay:  closest hit over all instances for t in (t0, t1).  the top
+//                level is walked nearest box first and stops at boxes past
+//                the best hit
+//
+bool InstancedScene::intersectRay(const Ray& ray, float t0, float t1, InstanceHit& hitRtn) const {
+	hitRtn.instance = -1;
+	if (top.root == -1) return false;
+	float best = t1;
+
+	struct Entry { int node; float t; };
+	TraversalStack<Entry, 256> stack;
+	float tNear, tFar;
+	if (!top.nodes[top.root].box.intersect(ray, t0, t1, tNear, tFar)) return false;
+	stack.push({ top.root, tNear });
+	while (!stack.empty()) {
+		Entry e = stack.pop();
+		if (e.t >= best) continue;
+		const AABBNode& node = top.nodes[e.node];
+		if (node.isLeaf()) {
+			const MeshInstance& inst = instances[node.userData];
+			RayHit hit;
+			if (meshes[inst.mesh]->intersectRay(toInstance(inst, ray), t0, best, hit) && hit.t < best) {
+				best = hit.t;
+				hitRtn.t = hit.t;
+				hitRtn.instance = node.userData;
+				hitRtn.face = hit.face;
+			}
+			continue;
+		}
+		float tc1, tc2;
+		bool hit1 = top.nodes[node.child1].box.intersect(ray, t0, best, tc1, tFar);
+		bool hit2 = top.nodes[node.child2].box.intersect(ray, t0, best, tc2, tFar);
+		if (hit1 && hit2 && tc1 < tc2) {
+			stack.push({ node.child2, tc2 });
+			stack.push({ node.child1, tc1 });
+			continue;
+		}
+		if (hit1) stack.push({ node.child1, tc1 });
+		if (hit2) stack.push({ node.child2, tc2 });
+	}
+	return hitRtn.instance >= 0;
+}
+
+bool InstancedScene::intersectAny(const Ray& ray, float t0, float t1) const {
+	if (top.root == -1) return false;
+	TraversalStack<int, 256> stack;
+	stack.push(top.root);
+	while (!stack.empty()) {
+		const AABBNode& node = top.nodes[stack.pop()];
+		if (!node.box.intersect(ray, t0, t1)) continue;
+		if (node.isLeaf()) {
+			const MeshInstance& inst = instances[node.userData];
+			if (meshes[inst.mesh]->intersectAny(toInstance(inst, ray), t0, t1)) return true;
+			continue;
+		}
+		stack.push(node.child1);
+		stack.push(node.child2);
+	}
+	return false;
+}
+
+// overlap:  faces of all instances whose (instance space) bounding box
+//           overlaps box moved into instance space.  conservative when
+//           the instance is rotated
+//
+int InstancedScene::overlap(const Box& box, vector<InstanceFace>& facesRtn) const {
+	int count = facesRtn.size();
+	vector<int> proxies;
+	top.query(box, proxies);
+	vector<int> faces;
+	for (int i = 0; i < proxies.size(); i++) {
+		int instance = top.getUserData(proxies[i]);
+		const MeshInstance& inst = instances[instance];
+		faces.clear();
+		meshes[inst.mesh]->overlap(MeshBVH::transformBox(inst.inverse, box), faces);
+		for (int j = 0; j < faces.size(); j++) {
+			InstanceFace f;
+			f.instance = instance;
+			f.face = faces[j];
+			facesRtn.push_back(f);
+		}
+	}
+	return facesRtn.size() - count;
+}
+
+void InstancedScene::draw() const {
+	for (int i = 0; i < instances.size(); i++) {
+		const MeshInstance& inst = instances[i];
+		if (inst.mesh == -1) continue;
+		ofPushMatrix();
+		ofMultMatrix(inst.transform);
+		meshes[inst.mesh]->octree->mesh.draw();
+		ofPopMatrix();
+	}
+}
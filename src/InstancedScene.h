@@ -0,0 +1,69 @@
+//--------------------------------------------------------------
+//
+//  InstancedScene - two level index for many copies of a few meshes
+//
+//  Each distinct mesh is indexed once, in its own coordinate space, by
+//  an octree (OctreeIndex).  An instance is a transform plus the mesh
+//  it uses.  The top level is an AABBTree over the instances' world
+//  boxes, so moving an instance only updates its leaf in the top level;
+//  the mesh octree is never touched.
+//
+//  Queries walk the top level, and for each instance reached move the
+//  ray or box into the instance's space.  The ray direction is moved
+//  without normalizing, so hit distances (t) are the same in both
+//  spaces and can be compared across instances.
+//
+#pragma once
+#include "ofMain.h"
+#include "AABBTree.h"
+#include "SpatialIndex.h"
+
+class MeshInstance {
+public:
+	int mesh = -1;
+	glm::mat4 transform;
+	glm::mat4 inverse;
+	Box worldBox;
+	int proxy = -1;		// leaf in the top level tree
+};
+
+class InstanceHit {
+public:
+	float t = 0;
+	int instance = -1;
+	int face = -1;		// face of the instance's mesh
+};
+
+class InstanceFace {
+public:
+	int instance;
+	int face;
+};
+
+class InstancedScene {
+public:
+	InstancedScene() { }
+	InstancedScene(const InstancedScene&) = delete;	// owns meshes
+	InstancedScene& operator=(const InstancedScene&) = delete;
+	~InstancedScene();
+
+	int addMesh(const ofMesh& mesh);
+	int addInstance(int mesh, const glm::mat4& transform);
+	void moveInstance(int instance, const glm::mat4& transform);
+	void removeInstance(int instance);
+	void clear();
+
+	bool intersectRay(const Ray& ray, float t0, float t1, InstanceHit& hitRtn) const;
+	bool intersectAny(const Ray& ray, float t0, float t1) const;
+	int overlap(const Box& box, vector<InstanceFace>& facesRtn) const;
+
+	void draw() const;
+
+	vector<OctreeIndex*> meshes;
+	vector<MeshInstance> instances;		// removed ones have mesh -1
+	AABBTree top;
+
+private:
+	static Ray toInstance(const MeshInstance& inst, const Ray& ray);
+	Box worldBox(int mesh, const glm::mat4& transform) const;
+};
@@ -0,0 +1,152 @@
+//--------------------------------------------------------------
+//
+//  JobScheduler - a frame's work as a graph of jobs on worker threads
+//
+
+#include "JobScheduler.h"
+
+int JobGraph::add(const string& name, std::function<void()> work) {
+	jobs.emplace_back();
+	jobs.back().name = name;
+	jobs.back().work = work;
+	return jobs.size() - 1;
+}
+
+// runsAfter:  job waits for before to finish
+//
+void JobGraph::runsAfter(int job, int before) {
+	jobs[before].dependents.push_back(job);
+	jobs[job].numDependencies++;
+}
+
+void JobGraph::resetTimings() {
+	for (int i = 0; i < jobs.size(); i++) {
+		jobs[i].totalMicros = 0;
+		jobs[i].numRuns = 0;
+	}
+}
+
+JobScheduler::~JobScheduler() {
+	stop();
+}
+
+void JobScheduler::start(int numThreads) {
+	stop();
+	if (numThreads == 0) numThreads = (int)std::thread::hardware_concurrency() - 1;
+	numThreads = max(numThreads, 0);
+	bStop = false;
+	queues.clear();
+	for (int i = 0; i <= numThreads; i++) queues.push_back(unique_ptr<Queue>(new Queue()));
+	for (int i = 0; i < numThreads; i++) workers.push_back(std::thread(&JobScheduler::work, this, i));
+}
+
+void JobScheduler::stop() {
+	{
+		std::lock_guard<std::mutex> lock(sleepMutex);
+		bStop = true;
+	}
+	workReady.notify_all();
+	for (int i = 0; i < workers.size(); i++) workers[i].join();
+	workers.clear();
+}
+
+// run:  every job of graph once, dependencies first.  returns when all
+//       are done.  the calling thread runs jobs meanwhile, and sleeps
+//       while others run the last ones until a job is queued or the
+//       last one finishes
+//
+void JobScheduler::run(JobGraph& graph) {
+	if (queues.size() == 0) start();
+	uint64_t start = ofGetElapsedTimeMicros();
+	int self = queues.size() - 1;
+	this->graph = &graph;
+	numLeft = graph.jobs.size();
+	for (int i = 0; i < graph.jobs.size(); i++) graph.jobs[i].waiting = graph.jobs[i].numDependencies;
+	for (int i = 0; i < graph.jobs.size(); i++) {
+		if (graph.jobs[i].numDependencies == 0) push(self, &graph.jobs[i]);
+	}
+	while (numLeft > 0) {
+		if (runOne(self)) continue;
+		std::unique_lock<std::mutex> lock(sleepMutex);
+		workReady.wait(lock, [this] { return numLeft == 0 || numQueued > 0; });
+	}
+	this->graph = NULL;
+	graph.micros = ofGetElapsedTimeMicros() - start;
+}
+
+// work:  worker thread self, runs jobs while there are any and sleeps
+//        when there are none
+//
+void JobScheduler::work(int self) {
+	while (true) {
+		if (runOne(self)) continue;
+		std::unique_lock<std::mutex> lock(sleepMutex);
+		workReady.wait(lock, [this] { return bStop || numQueued > 0; });
+		if (bStop) return;
+	}
+}
+
+// runOne:  the newest job on self's queue, or else the oldest on another
+//          thread's.  false if there was none anywhere
+//
+bool JobScheduler::runOne(int self) {
+	Job* job = NULL;
+	{
+		Queue& own = *queues[self];
+		std::lock_guard<std::mutex> lock(own.mutex);
+		if (own.jobs.size() > 0) {
+			job = own.jobs.back();
+			own.jobs.pop_back();
+		}
+	}
+	for (int i = 1; job == NULL && i < queues.size(); i++) {
+		Queue& other = *queues[(self + i) % queues.size()];
+		std::lock_guard<std::mutex> lock(other.mutex);
+		if (other.jobs.size() > 0) {
+			job = other.jobs.front();
+			other.jobs.pop_front();
+		}
+	}
+	if (job == NULL) return false;
+	numQueued--;
+	execute(self, job);
+	return true;
+}
+
+void JobScheduler::push(int self, Job* job) {
+	{
+		std::lock_guard<std::mutex> lock(queues[self]->mutex);
+		queues[self]->jobs.push_back(job);
+	}
+	{
+		std::lock_guard<std::mutex> lock(sleepMutex);
+		numQueued++;
+	}
+	workReady.notify_one();
+}
+
+// execute:  run job, time it, then queue the dependents it was the last
+//           dependency of
+//
+void JobScheduler::execute(int self, Job* job) {
+	uint64_t t1 = ofGetElapsedTimeMicros();
+	job->work();
+	uint64_t t2 = ofGetElapsedTimeMicros();
+	job->micros = t2 - t1;
+	job->totalMicros += job->micros;
+	job->numRuns++;
+	job->thread = self;
+
+	for (int i = 0; i < job->dependents.size(); i++) {
+		Job* next = &graph->jobs[job->dependents[i]];
+		if (--next->waiting == 0) push(self, next);
+	}
+
+	// the last one wakes run()'s thread.  taking the lock means run() is
+	// either waiting already or has yet to test numLeft
+	//
+	if (--numLeft == 0) {
+		std::lock_guard<std::mutex> lock(sleepMutex);
+		workReady.notify_all();
+	}
+}
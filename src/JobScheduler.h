@@ -0,0 +1,88 @@
+//--------------------------------------------------------------
+//
+//  JobScheduler - a frame's work as a graph of jobs on worker threads
+//
+//  A JobGraph is a set of named jobs and "runs after" edges between
+//  them.  JobScheduler::run() starts every job with nothing to wait for,
+//  and a finished job starts each dependent whose last dependency it
+//  was, so independent stages run side by side and run() returns once
+//  all of them are done.  The calling thread works too, so a machine
+//  with one core runs the graph in order with no worker threads.
+//
+//  Each thread has its own queue:  a job made ready by a thread goes on
+//  that thread's queue (its data is likely still in that core's cache)
+//  and the thread takes the newest job of its own first.  A thread with
+//  nothing left steals the oldest job from another's queue.
+//
+//  Jobs keep their time for the last run and the running total, for the
+//  per stage timings ('j' in the app).  A graph is built once and run
+//  every frame; don't change it while it runs.
+//
+#pragma once
+#include "ofMain.h"
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+#include <deque>
+
+class Job {
+public:
+	string name;
+	std::function<void()> work;
+	vector<int> dependents;			// jobs that run after this one
+	int numDependencies = 0;
+
+	// timing
+	//
+	uint64_t micros = 0;			// last run
+	uint64_t totalMicros = 0;
+	int64_t numRuns = 0;
+	int thread = -1;				// ran on, last run (the last one is the calling thread)
+
+	std::atomic<int> waiting{ 0 };	// dependencies not done yet, this run
+};
+
+class JobGraph {
+public:
+	int add(const string& name, std::function<void()> work);
+	void runsAfter(int job, int before);
+	void resetTimings();
+
+	std::deque<Job> jobs;			// (a deque, jobs don't move as it grows)
+	uint64_t micros = 0;			// last run, start to finish
+};
+
+class JobScheduler {
+public:
+	~JobScheduler();
+
+	// numThreads 0:  one less than the number of cores (none on one core)
+	//
+	void start(int numThreads = 0);
+	void stop();
+	void run(JobGraph& graph);
+
+	int numThreads() const { return workers.size(); }
+
+private:
+	class Queue {
+	public:
+		std::mutex mutex;
+		std::deque<Job*> jobs;
+	};
+
+	void work(int self);
+	bool runOne(int self);
+	void push(int self, Job* job);
+	void execute(int self, Job* job);
+
+	vector<std::thread> workers;
+	vector<unique_ptr<Queue> > queues;	// one per worker, then the calling thread's
+	JobGraph* graph = NULL;				// running now
+	std::atomic<int> numQueued{ 0 };
+	std::atomic<int> numLeft{ 0 };		// jobs of this run not finished
+	std::mutex sleepMutex;
+	std::condition_variable workReady;	// a job was queued, or the run's last one finished
+	bool bStop = false;
+};
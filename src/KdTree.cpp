@@ -0,0 +1,174 @@
+//--------------------------------------------------------------
+//
+//  KdTree - kd-tree backend for SpatialIndex
+//
+
+#include "KdTree.h"
+#include "Triangle.h"
+#include "TraversalStack.h"
+#include <float.h>
+
+void KdTreeIndex::build(const ofMesh& mesh) {
+	nodes.clear();
+	leafFaces.clear();
+	int n = numFaces(mesh);
+	verts.resize(n * 3);
+	faceBoxes.resize(n);
+	vector<int> faces(n);
+	for (int f = 0; f < n; f++) {
+		faceVerts(mesh, f, &verts[f * 3]);
+		faceBoxes[f] = faceBox(&verts[f * 3]);
+		faces[f] = f;
+	}
+	if (n == 0) return;
+	bounds = faceBoxes[0];
+	for (int f = 1; f < n; f++) bounds.expand(faceBoxes[f]);
+	subdivide(faces, bounds, 0);
+}
+
+// subdivide:  split faces (all touching box) at the median centroid on
+//             the box's longest axis.  stops when the node is small, too
+//             deep, or the split doesn't make either side smaller.
+//             return node index
+//
+int KdTreeIndex::subdivide(vector<int>& faces, const Box& box, int depth) {
+	int index = nodes.size();
+	nodes.push_back(KdNode());
+
+	Vector3 size = box.parameters[1] - box.parameters[0];
+	int axis = 0;
+	if (size.y() > size[axis]) axis = 1;
+	if (size.z() > size[axis]) axis = 2;
+
+	vector<int> side[2];
+	float split = 0;
+	if (faces.size() > maxLeafFaces && depth < maxDepth) {
+		vector<float> centers(faces.size());
+		for (int i = 0; i < faces.size(); i++) {
+			const Box& b = faceBoxes[faces[i]];
+			centers[i] = (b.parameters[0][axis] + b.parameters[1][axis]) * .5f;
+		}
+		nth_element(centers.begin(), centers.begin() + centers.size() / 2, centers.end());
+		split = centers[centers.size() / 2];
+		if (split <= box.parameters[0][axis] || split >= box.parameters[1][axis]) {
+			split = (box.parameters[0][axis] + box.parameters[1][axis]) * .5f;
+		}
+		for (int i = 0; i < faces.size(); i++) {
+			const Box& b = faceBoxes[faces[i]];
+			if (b.parameters[0][axis] <= split) side[0].push_back(faces[i]);
+			if (b.parameters[1][axis] >= split) side[1].push_back(faces[i]);
+		}
+	}
+
+	if (side[0].size() == 0 || side[1].size() == 0 ||
+		side[0].size() == faces.size() || side[1].size() == faces.size()) {
+		nodes[index].first = leafFaces.size();
+		nodes[index].count = faces.size();
+		leafFaces.insert(leafFaces.end(), faces.begin(), faces.end());
+		return index;
+	}
+	faces.clear();
+	faces.shrink_to_fit();
+
+	Box lower = box;
+	Box upper = box;
+	Vector3 p = lower.parameters[1];
+	lower.parameters[1] = Vector3(axis == 0 ? split : p.x(), axis == 1 ? split : p.y(), axis == 2 ? split : p.z());
+	p = upper.parameters[0];
+	upper.parameters[0] = Vector3(axis == 0 ? split : p.x(), axis == 1 ? split : p.y(), axis == 2 ? split : p.z());
+
+	int c0 = subdivide(side[0], lower, depth + 1);
+	int c1 = subdivide(side[1], upper, depth + 1);
+	nodes[index].axis = axis;
+	nodes[index].split = split;
+	nodes[index].child[0] = c0;
+	nodes[index].child[1] = c1;
+	return index;
+}
+
+bool KdTreeIndex::intersectRay(const Ray& ray, float t0, float t1, RayHit& hitRtn) const {
+	return intersect(ray, t0, t1, false, hitRtn);
+}
+
+bool KdTreeIndex::intersectAny(const Ray& ray, float t0, float t1) const {
+	RayHit hit;
+	return intersect(ray, t0, t1, true, hit);
+}
+
+// intersect:  front to back walk with an explicit stack of (node, tmin, tmax).
+//             a face listed in several leaves may be hit outside the
+//             current leaf, so the closest hit is only final once it lies
+//             within the leaf's own interval
+//
+bool KdTreeIndex::intersect(const Ray& ray, float t0, float t1, bool anyHit, RayHit& hitRtn) const {
+	if (nodes.size() == 0) return false;
+	float tNear, tFar;
+	if (!bounds.intersect(ray, t0, t1, tNear, tFar)) return false;
+
+	struct Entry { int node; float tmin, tmax; };
+	TraversalStack<Entry> stack;
+	stack.push({ 0, tNear, tFar });
+
+	float best = t1;
+	int bestFace = -1;
+	while (!stack.empty()) {
+		Entry e = stack.pop();
+		if (e.tmin > best) continue;
+		const KdNode* node = &nodes[e.node];
+		float tmin = e.tmin;
+		float tmax = e.tmax;
+
+		while (node->axis >= 0) {
+			int axis = node->axis;
+			float o = ray.origin[axis];
+			float tSplit = (node->split - o) * ray.inv_direction[axis];
+			int nearSide = (o < node->split || (o == node->split && ray.direction[axis] <= 0)) ? 0 : 1;
+			const KdNode* nearNode = &nodes[node->child[nearSide]];
+			int farNode = node->child[1 - nearSide];
+
+			if (tSplit > tmax || tSplit <= 0) node = nearNode;
+			else if (tSplit < tmin) node = &nodes[farNode];
+			else {
+				stack.push({ farNode, tSplit, tmax });
+				node = nearNode;
+				tmax = tSplit;
+			}
+		}
+
+		float t;
+		for (int i = node->first; i < node->first + node->count; i++) {
+			int f = leafFaces[i];
+			if (rayTriangle(ray.origin, ray.direction, &verts[f * 3], t0, best, t)) {
+				if (anyHit) return true;
+				best = t;
+				bestFace = f;
+			}
+		}
+		if (bestFace >= 0 && best <= tmax) break;
+	}
+	if (bestFace < 0) return false;
+	hitRtn.t = best;
+	hitRtn.face = bestFace;
+	return true;
+}
+
+int KdTreeIndex::overlap(const Box& box, vector<int>& facesRtn) const {
+	if (nodes.size() == 0) return 0;
+	int count = facesRtn.size();
+	TraversalStack<int> stack;
+	stack.push(0);
+	while (!stack.empty()) {
+		const KdNode& node = nodes[stack.pop()];
+		if (node.axis < 0) {
+			for (int i = node.first; i < node.first + node.count; i++) {
+				if (faceBoxes[leafFaces[i]].overlap(box)) facesRtn.push_back(leafFaces[i]);
+			}
+			continue;
+		}
+		if (box.parameters[0][node.axis] <= node.split) stack.push(node.child[0]);
+		if (box.parameters[1][node.axis] >= node.split) stack.push(node.child[1]);
+	}
+	sort(facesRtn.begin() + count, facesRtn.end());
+	facesRtn.erase(unique(facesRtn.begin() + count, facesRtn.end()), facesRtn.end());
+	return facesRtn.size() - count;
+}
@@ -0,0 +1,43 @@
+//--------------------------------------------------------------
+//
+//  KdTree - kd-tree over the faces of a mesh
+//
+//  Each node splits its box in two on the longest axis at the median
+//  face centroid.  Faces that straddle the split plane are listed on
+//  both sides, so leaves may share faces.  Rays walk the tree front
+//  to back, clipping the t interval at each split plane, and stop at
+//  the first leaf with a hit inside its own interval.
+//
+#pragma once
+#include "SpatialIndex.h"
+
+class KdNode {
+public:
+	int axis = -1;			// -1 for a leaf
+	float split = 0;
+	int child[2] = { -1, -1 };
+	int first = 0;			// leaf: faces are leafFaces[first .. first+count-1]
+	int count = 0;
+};
+
+class KdTreeIndex : public SpatialIndex {
+public:
+	string name() const { return "kd-tree"; }
+	void build(const ofMesh& mesh);
+	bool intersectRay(const Ray& ray, float t0, float t1, RayHit& hitRtn) const;
+	bool intersectAny(const Ray& ray, float t0, float t1) const;
+	int overlap(const Box& box, vector<int>& facesRtn) const;
+
+	vector<KdNode> nodes;
+	vector<int> leafFaces;
+	vector<Vector3> verts;		// 3 per face
+	vector<Box> faceBoxes;
+	Box bounds;
+
+	int maxLeafFaces = 8;
+	int maxDepth = 24;
+
+private:
+	int subdivide(vector<int>& faces, const Box& box, int depth);
+	bool intersect(const Ray& ray, float t0, float t1, bool anyHit, RayHit& hitRtn) const;
+};
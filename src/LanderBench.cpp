@@ -0,0 +1,185 @@
+//--------------------------------------------------------------
+//
+//  LanderBench - timing of the game simulation and frame, printed to
+//  the console.  Run with the rest from --bench (runAllBenchmarks()).
+//
+
+#include "LanderBench.h"
+#include "OctreeBench.h"
+#include "LanderSimulation.h"
+#include "SimulationThread.h"
+#include "JobScheduler.h"
+#include <thread>
+
+// makeTestLander:  a 1 x 1 x 1 box standing on the origin
+//
+ofMesh makeTestLander() {
+	ofMesh mesh;
+	for (int i = 0; i < 8; i++) mesh.addVertex(glm::vec3((i & 1) - .5, (i >> 1) & 1, ((i >> 2) & 1) - .5));
+	int faces[12][3] = { {0, 2, 1}, {1, 2, 3}, {4, 5, 6}, {5, 7, 6}, {0, 1, 4}, {1, 5, 4},
+		{2, 6, 3}, {3, 6, 7}, {0, 4, 2}, {2, 4, 6}, {1, 3, 5}, {3, 7, 5} };
+	for (int f = 0; f < 12; f++) {
+		for (int k = 0; k < 3; k++) mesh.addIndex(faces[f][k]);
+	}
+	return mesh;
+}
+
+// benchLanderSimulation:  the game with no window, flown by padAutopilot()
+//                         for up to numSteps steps, with the ground queries
+//                         answered in place and through a QueryService
+//
+void benchLanderSimulation(int numSteps) {
+	shared_ptr<Terrain> terrain = make_shared<Terrain>();
+	terrain->build(vector<ofMesh>(1, makeTestTerrain(256, 100)));
+	const char* phases[] = { "waiting", "flying to pad 1", "flying to pad 2", "flying to pad 3", "landed on all pads", "exploded", "out of fuel" };
+	cout << "lander simulation: headless, up to " << numSteps << " steps" << endl;
+
+	for (int service = 0; service <= 1; service++) {
+		QueryService queries;
+		LanderSimulation sim;
+		sim.setTerrain(terrain);
+		sim.setLander(vector<ofMesh>(1, makeTestLander()), glm::mat4(1.0));
+		sim.position = glm::vec3(0, 8, 0);
+		if (service) {
+			queries.start(terrain);
+			sim.queries = &queries;
+		}
+		sim.start();
+		int grounded = 0, crashes = 0;
+		uint64_t t1 = ofGetElapsedTimeMicros();
+		while (sim.numSteps < numSteps && sim.gameplay <= LanderSimulation::ToPad3) {
+			LanderEvents events = sim.step(padAutopilot(sim));
+			grounded += events.bTouchdown;
+			crashes += events.bCrash;
+		}
+		uint64_t t2 = ofGetElapsedTimeMicros();
+		cout << "  " << (service ? "query service:  " : "in place:  ") << sim.numSteps << " steps in " << (t2 - t1) / 1000.0 << " ms, "
+			<< (int)(sim.numSteps / ((t2 - t1) / 1e6)) << " steps/s, " << phases[sim.gameplay + 1] << ", fuel " << (int)sim.fuel
+			<< ", " << grounded << " steps on the ground, " << crashes << " crashes" << endl;
+	}
+}
+
+// benchSimulationThread:  numFrames frames of a stand-in draw (renderMicros
+//                         of busy work) with the simulation advanced in
+//                         the frame, then on a SimulationThread.  the
+//                         lander skims the ground at 20000 ticks/s, so
+//                         the sim's share of a frame shows
+//
+void benchSimulationThread(int numFrames, int renderMicros) {
+	shared_ptr<Terrain> terrain = make_shared<Terrain>();
+	terrain->build(vector<ofMesh>(1, makeTestTerrain(256, 100)));
+	cout << "simulation thread: " << numFrames << " frames, " << renderMicros << " microsec of drawing each, "
+		<< std::thread::hardware_concurrency() << " cores" << endl;
+
+	for (int threaded = 0; threaded <= 1; threaded++) {
+		LanderSimulation sim;
+		sim.setTerrain(terrain);
+		sim.setLander(vector<ofMesh>(1, makeTestLander()), glm::mat4(1.0));
+		sim.setTickRate(20000);
+		sim.place(glm::vec3(-40, 4, 0));
+		sim.start();
+		SimulationThread simThread;
+		if (threaded) simThread.start(&sim);
+
+		LanderControls controls;
+		controls.right = true;
+		uint64_t start = ofGetElapsedTimeMicros();
+		uint64_t last = start;
+		uint64_t simMicros = 0;
+		float lastFrame = 1.0 / 60;
+		for (int frame = 0; frame < numFrames; frame++) {
+			uint64_t t1 = ofGetElapsedTimeMicros();
+			if (threaded) {
+				const LanderSnapshot& state = simThread.latest();
+				controls.up = state.altitude < .4 && state.velocity.y < .5;
+				simThread.setInput(controls, NULL);
+			}
+			else {
+				controls.up = sim.altitude < .4 && sim.velocity.y < .5;
+				sim.advance(lastFrame, controls);
+			}
+			uint64_t t2 = ofGetElapsedTimeMicros();
+			simMicros += t2 - t1;
+			while (ofGetElapsedTimeMicros() - t2 < renderMicros) { }
+			uint64_t now = ofGetElapsedTimeMicros();
+			lastFrame = (now - last) / 1e6;
+			last = now;
+		}
+		uint64_t end = ofGetElapsedTimeMicros();
+		simThread.stop();
+		float seconds = (end - start) / 1e6;
+		cout << "  " << (threaded ? "own thread:  " : "in the frame:  ") << (end - start) / 1000.0 / numFrames << " ms a frame, "
+			<< simMicros / 1000.0 / numFrames << " ms of it waiting on the sim, " << sim.numSteps << " steps ("
+			<< (int)(100 * sim.numSteps * sim.dt / seconds) << "% of real time)";
+		if (threaded) cout << ", thread " << simThread.advanceMicros / max((int64_t)1, (int64_t)simThread.numAdvances) << " microsec an advance";
+		cout << endl;
+	}
+}
+
+// benchJobScheduler:  a frame's worth of independent terrain work (landing
+//                     sites, sight lines, occupancy, points) and a stage
+//                     that waits for all of them, as a job graph run
+//                     numFrames times on the calling thread alone, then
+//                     with worker threads
+//
+void benchJobScheduler(int numFrames) {
+	shared_ptr<Terrain> terrain = make_shared<Terrain>();
+	terrain->build(vector<ofMesh>(1, makeTestTerrain(256, 100)));
+	const Terrain& ground = *terrain;
+	vector<Ray> sights;
+	vector<Box> boxes;
+	for (int i = 0; i < 500; i++) {
+		Vector3 eye = Vector3(ofRandom(-50, 50), ofRandom(3, 10), ofRandom(-50, 50));
+		Vector3 target = Vector3(ofRandom(-50, 50), 0, ofRandom(-50, 50));
+		sights.push_back(makeRay(eye, target - eye));
+		Vector3 p = Vector3(ofRandom(-50, 50), ofRandom(-3, 3), ofRandom(-50, 50));
+		boxes.push_back(Box(p, p + Vector3(1, 1, 1)));
+	}
+	cout << "job scheduler: " << numFrames << " frames, " << std::thread::hardware_concurrency() << " cores" << endl;
+
+	for (int threads = 0; threads <= 3; threads += 3) {
+		vector<const TreeNode*> sites;
+		int blocked = 0, solid = 0, total = 0;
+		vector<int> points;
+		JobGraph graph;
+		int landing = graph.add("landing sites", [&] {
+			ground.octree.findLandingSites(Vector3(20, 0, 20), 5, 30, .05, sites);
+		});
+		int sight = graph.add("sight lines", [&] {
+			blocked = 0;
+			for (int i = 0; i < 100; i++) blocked += ground.index->intersectAny(sights[i], 0, 1);
+		});
+		int occupancy = graph.add("occupancy", [&] {
+			solid = 0;
+			for (int i = 0; i < boxes.size(); i++) solid += ground.occupancy.overlap(boxes[i]);
+		});
+		int inBox = graph.add("points", [&] {
+			points.clear();
+			for (int i = 0; i < 50; i++) ground.octree.getPointsInBox(boxes[i], points);
+		});
+		int join = graph.add("join", [&] {
+			total = sites.size() + blocked + solid + points.size();
+		});
+		graph.runsAfter(join, landing);
+		graph.runsAfter(join, sight);
+		graph.runsAfter(join, occupancy);
+		graph.runsAfter(join, inBox);
+
+		JobScheduler scheduler;
+		scheduler.start(threads);
+		uint64_t graphMicros = 0;
+		int64_t check = 0;
+		for (int frame = 0; frame < numFrames; frame++) {
+			scheduler.run(graph);
+			graphMicros += graph.micros;
+			check += total;
+		}
+		uint64_t stages = 0;
+		for (int i = 0; i < graph.jobs.size(); i++) stages += graph.jobs[i].totalMicros;
+		cout << "  " << threads << " workers:  " << graphMicros / numFrames << " microsec a frame, stages add up to "
+			<< stages / numFrames << ", result " << check / numFrames << endl;
+		for (int i = 0; i < graph.jobs.size(); i++) {
+			cout << "    " << graph.jobs[i].name << ":  " << graph.jobs[i].totalMicros / graph.jobs[i].numRuns << " microsec" << endl;
+		}
+	}
+}
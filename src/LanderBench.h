@@ -0,0 +1,13 @@
+//--------------------------------------------------------------
+//
+//  LanderBench - timing of the game simulation and frame, printed to
+//  the console.  Run with the rest from --bench (runAllBenchmarks()).
+//
+#pragma once
+#include "ofMain.h"
+
+void benchLanderSimulation(int numSteps);
+void benchSimulationThread(int numFrames, int renderMicros);
+void benchJobScheduler(int numFrames);
+
+ofMesh makeTestLander();			// a 1 x 1 x 1 box standing on the origin
@@ -0,0 +1,225 @@
+//--------------------------------------------------------------
+//
+//  LanderChecks - pass/fail checks of the lander simulation
+//
+
+#include "LanderChecks.h"
+#include "LanderSimulation.h"
+#include "OctreeBench.h"
+#include "LanderBench.h"
+#include "TerrainTiles.h"
+
+// check:  one line of results, counted in failures if it didn't pass
+//
+static void check(bool pass, const string& name, const string& result, int& failures) {
+	cout << (pass ? "PASS  " : "FAIL  ") << name << ":  " << result << endl;
+	if (!pass) failures++;
+}
+
+// testTerrain:  a fresh one for each check that can crater it
+//
+static shared_ptr<Terrain> testTerrain() {
+	shared_ptr<Terrain> terrain = make_shared<Terrain>();
+	terrain->build(vector<ofMesh>(1, makeTestTerrain(256, 100)));
+	return terrain;
+}
+
+static void setUp(LanderSimulation& sim, shared_ptr<Terrain> terrain) {
+	sim.setTerrain(terrain);
+	sim.setLander(vector<ofMesh>(1, makeTestLander()), glm::mat4(1.0));
+}
+
+// checkFrameTimeSpikes:  a flight (constant controls) fed frames of random
+//                        length with stalls under maxFrameTime, against
+//                        the same flight stepped once per tick.  the
+//                        frames have to run as many steps as their time
+//                        covers, and a stall runs more steps, not longer
+//                        ones, so the two flights end in the same place
+//
+static void checkFrameTimeSpikes(int numSteps, int& failures) {
+	shared_ptr<Terrain> terrain = testTerrain();
+	LanderControls controls;
+	controls.right = true;
+	controls.turnLeft = true;
+	LanderSimulation ticked, framed;
+	LanderSimulation* sims[2] = { &ticked, &framed };
+	for (int k = 0; k < 2; k++) {
+		setUp(*sims[k], terrain);
+		sims[k]->place(glm::vec3(-40, 30, 0));
+		sims[k]->start();
+	}
+	float spike = framed.maxFrameTime * .8;
+	ofSeedRandom(1);
+	int frames = 0, spikes = 0;
+	double frameTotal = 0;
+	while (framed.numSteps < numSteps) {
+		float frameTime = ofRandom(.002, .05);
+		if (frames % 50 == 49) {
+			frameTime = spike;
+			spikes++;
+		}
+		framed.advance(frameTime, controls);
+		frameTotal += frameTime;
+		frames++;
+	}
+
+	// the accumulator is a float, so allow it a step of rounding
+	//
+	int64_t expected = (int64_t)floor(frameTotal * framed.tickRate);
+	bool stepsPass = llabs(framed.numSteps - expected) <= 1;
+	while (ticked.numSteps < framed.numSteps) ticked.step(controls);
+	float difference = glm::length(ticked.position - framed.position) + fabs(ticked.rotation - framed.rotation);
+	check(stepsPass && difference == 0, "frame time spikes", ofToString(frames) + " frames of 2-50 ms and " + ofToString(spikes)
+		+ " of " + ofToString((int)(spike * 1000)) + " ms (under maxFrameTime), " + ofToString(frameTotal) + " s at "
+		+ ofToString(framed.tickRate) + " Hz:  " + ofToString(framed.numSteps) + " steps, " + ofToString(expected)
+		+ " expected, off one step per tick by " + ofToString(difference), failures);
+}
+
+// checkFrameTimeClamp:  frames longer than maxFrameTime (a stall, a drag
+//                       of the window) only run maxFrameTime of steps
+//
+static void checkFrameTimeClamp(int numFrames, int& failures) {
+	LanderSimulation sim;
+	setUp(sim, testTerrain());
+	sim.place(glm::vec3(-40, 30, 0));
+	sim.start();
+	float frameTime = sim.maxFrameTime * 2;
+	for (int i = 0; i < numFrames; i++) sim.advance(frameTime, LanderControls());
+	int64_t expected = (int64_t)floor(numFrames * sim.maxFrameTime * sim.tickRate);
+	check(llabs(sim.numSteps - expected) <= 1, "frame time clamp", ofToString(numFrames) + " frames of "
+		+ ofToString((int)(frameTime * 1000)) + " ms cut to maxFrameTime " + ofToString((int)(sim.maxFrameTime * 1000))
+		+ " ms at " + ofToString(sim.tickRate) + " Hz:  " + ofToString(sim.numSteps) + " steps, " + ofToString(expected)
+		+ " expected", failures);
+}
+
+// checkNoTunnelling:  drops at 150 units/s (2.5 units a step, the lander
+//                     is 1 high) from random points.  every one has to
+//                     crash; one that ends below the ground went through
+//
+static void checkNoTunnelling(int numDrops, int& failures) {
+	LanderSimulation sim;
+	setUp(sim, testTerrain());
+	ofSeedRandom(1);
+	int caught = 0, through = 0;
+	for (int i = 0; i < numDrops; i++) {
+		sim.gameplay = LanderSimulation::Waiting;
+		sim.bGrounded = false;
+		sim.manifold.clear();
+		sim.place(glm::vec3(ofRandom(-45, 45), 6, ofRandom(-45, 45)));
+		sim.velocity = glm::vec3(0, -150, 0);
+		sim.start();
+		for (int k = 0; k < 10 && sim.gameplay == LanderSimulation::ToPad1; k++) {
+			sim.step(LanderControls());
+		}
+		if (sim.gameplay == LanderSimulation::Exploded) caught++;
+		else if (sim.position.y < -3) through++;
+	}
+	check(caught == numDrops && through == 0, "no tunnelling", ofToString(numDrops) + " drops:  " + ofToString(caught)
+		+ " crashes, " + ofToString(through) + " through the ground, " + ofToString(sim.numSubsteps) + " substeps in "
+		+ ofToString(sim.numSteps) + " steps", failures);
+}
+
+// checkFuelBurn:  one second of main engine at several tick rates burns
+//                 fuelRate, give or take rounding
+//
+static void checkFuelBurn(int& failures) {
+	shared_ptr<Terrain> terrain = testTerrain();
+	float rates[] = { 30, 60, 144, 240 };
+	string result;
+	bool pass = true;
+	for (int i = 0; i < 4; i++) {
+		LanderSimulation sim;
+		setUp(sim, terrain);
+		sim.setTickRate(rates[i]);
+		sim.place(glm::vec3(0, 30, 0));
+		sim.start();
+		LanderControls controls;
+		controls.up = true;
+		controls.thrust = 0;		// stay put, only the burn matters
+		float fuel = sim.fuel;
+		for (int k = 0; k < rates[i]; k++) sim.step(controls);
+		float burnt = fuel - sim.fuel;
+		if (fabs(burnt - sim.fuelRate) > 1) pass = false;
+		result += (i > 0 ? ", " : "") + ofToString(burnt) + " at " + ofToString(rates[i]) + " Hz";
+	}
+	check(pass, "fuel burn", result + " (a second of main engine)", failures);
+}
+
+// checkAutopilot:  padAutopilot() from above the origin has to set down
+//                  on all pads without a crash within maxTime seconds
+//
+static void checkAutopilot(float tickRate, float maxTime, int& failures) {
+	LanderSimulation sim;
+	setUp(sim, testTerrain());
+	sim.setTickRate(tickRate);
+	sim.position = glm::vec3(0, 8, 0);
+	sim.start();
+	int crashes = 0;
+	while (sim.numSteps < maxTime * tickRate && sim.gameplay <= LanderSimulation::ToPad3) {
+		crashes += sim.step(padAutopilot(sim)).bCrash;
+	}
+	const char* phases[] = { "waiting", "flying to pad 1", "flying to pad 2", "flying to pad 3", "landed on all pads", "exploded", "out of fuel" };
+	check(sim.gameplay == LanderSimulation::Landed && crashes == 0, "autopilot at " + ofToString(tickRate) + " Hz",
+		string(phases[sim.gameplay + 1]) + " after " + ofToString(sim.numSteps * sim.dt) + " s, " + ofToString(crashes)
+		+ " crashes, fuel " + ofToString((int)sim.fuel), failures);
+}
+
+// checkTileCrash:  drops onto a streamed tile beside the terrain have to
+//                 crash on the tile and leave both the tile and the
+//                 terrain as they were (tiles are never edited).  a drop
+//                 onto the terrain still makes its crater
+//
+static void checkTileCrash(int numDrops, int& failures) {
+	shared_ptr<Terrain> terrain = testTerrain();
+	ofMesh tileMesh = makeTestTerrain(256, 100);
+	for (int i = 0; i < tileMesh.getNumVertices(); i++) tileMesh.getVertices()[i].x += 100;
+	shared_ptr<TerrainTile> tile = make_shared<TerrainTile>();
+	tile->i = 1;
+	tile->terrain = make_shared<Terrain>();
+	tile->terrain->build(vector<ofMesh>(1, tileMesh));
+	tile->bounds = tile->terrain->octree.root.box;
+	shared_ptr<TileList> tiles = make_shared<TileList>(1, tile);
+
+	LanderSimulation sim;
+	setUp(sim, terrain);
+	sim.tiles = tiles;
+	int terrainLeaves = terrain->numLeaves, tileLeaves = tile->terrain->numLeaves;
+	ofSeedRandom(1);
+	int onTile = 0;
+	for (int i = 0; i <= numDrops; i++) {
+		sim.gameplay = LanderSimulation::Waiting;
+		sim.bGrounded = false;
+		sim.manifold.clear();
+		float x = (i < numDrops) ? ofRandom(60, 140) : 0;		// the last one on the terrain
+		sim.place(glm::vec3(x, 6, ofRandom(-40, 40)));
+		sim.velocity = glm::vec3(0, -150, 0);
+		sim.start();
+		for (int k = 0; k < 10 && sim.gameplay == LanderSimulation::ToPad1; k++) {
+			LanderEvents events = sim.step(LanderControls());
+			if (events.bCrash && events.crashTerrain == tile->terrain.get()) onTile++;
+		}
+		if (i == numDrops - 1) {
+			terrainLeaves -= terrain->numLeaves;
+			tileLeaves -= tile->terrain->numLeaves;
+		}
+	}
+	check(onTile == numDrops && terrainLeaves == 0 && tileLeaves == 0 && sim.numCraters == 1, "crash on a tile",
+		ofToString(onTile) + " of " + ofToString(numDrops) + " drops crashed on the tile, leaves changed by "
+		+ ofToString(terrainLeaves) + " (terrain) and " + ofToString(tileLeaves) + " (tile), "
+		+ ofToString(sim.numCraters) + " crater(s) with the last drop on the terrain", failures);
+}
+
+// runLanderChecks:  all of them.  returns the number that failed
+//
+int runLanderChecks() {
+	int failures = 0;
+	checkFrameTimeSpikes(3600, failures);
+	checkFrameTimeClamp(40, failures);
+	checkNoTunnelling(100, failures);
+	checkTileCrash(20, failures);
+	checkFuelBurn(failures);
+	checkAutopilot(60, 300, failures);
+	checkAutopilot(240, 300, failures);
+	cout << (failures == 0 ? "all checks passed" : ofToString(failures) + " check(s) failed") << endl;
+	return failures;
+}
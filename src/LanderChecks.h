@@ -0,0 +1,28 @@
+//--------------------------------------------------------------
+//
+//  LanderChecks - pass/fail checks of the lander simulation
+//
+//  Run with "--check" on the command line (see main.cpp), no window.
+//  Each check prints a line starting PASS or FAIL with what it measured
+//  and the process exits with the number of failures, so a script can
+//  run them.  The benchmarks (OctreeBench) only time things; these hold
+//  the simulation to what it promises:
+//
+//      frame time spikes  - advance() runs as many steps as its frames
+//                           cover, and with random frames and stalls
+//                           ends exactly where one step per tick does
+//      frame time clamp   - a frame longer than maxFrameTime only runs
+//                           maxFrameTime of steps
+//      no tunnelling      - fast drops onto the terrain all crash, none
+//                           go through the ground
+//      crash on a tile    - crashes on a streamed tile leave it (and the
+//                           terrain) unchanged; the terrain still craters
+//      fuel burn          - a second of main engine burns the same fuel
+//                           at any tick rate
+//      autopilot          - padAutopilot() lands on every pad, at the
+//                           default and a high tick rate
+//
+#pragma once
+#include "ofMain.h"
+
+int runLanderChecks();
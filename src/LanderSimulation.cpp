@@ -0,0 +1,458 @@
+//--------------------------------------------------------------
+//
+//  LanderSimulation - the game without the window
+//
+
+#include "LanderSimulation.h"
+#include "ObjLoader.h"
+
+// setLander:  meshes in lander model space (the BVH is built once here),
+//             base takes them to lander space (scale, model fixups), the
+//             rest of the lander matrix is pose()
+//
+void LanderSimulation::setLander(const vector<ofMesh>& meshes, const glm::mat4& base) {
+	landerBVH.create(meshes);
+	landerBase = base;
+	glm::vec3 lo(FLT_MAX), hi(-FLT_MAX);
+	for (int i = 0; i < meshes.size(); i++) {
+		for (int k = 0; k < meshes[i].getNumVertices(); k++) {
+			glm::vec4 p = base * glm::vec4(meshes[i].getVertex(k), 1.0);
+			glm::vec3 v = glm::vec3(p.x, p.y, p.z);
+			lo = glm::min(lo, v);
+			hi = glm::max(hi, v);
+		}
+	}
+	if (lo.x > hi.x) lo = hi = glm::vec3(0, 0, 0);
+	bounds = Box(Vector3(lo.x, lo.y, lo.z), Vector3(hi.x, hi.y, hi.z));
+	manifold.clear();
+}
+
+// loadLander:  lander model from an OBJ file (no model loader needed),
+//              scaled uniformly
+//
+bool LanderSimulation::loadLander(const string& path, float scale) {
+	vector<ofMesh> meshes;
+	if (!loadObjMeshes(path, meshes)) return false;
+	setLander(meshes, glm::scale(glm::mat4(1.0), glm::vec3(scale, scale, scale)));
+	return true;
+}
+
+// setTerrain:  a new terrain version.  contact state built on the old one
+//              is dropped
+//
+void LanderSimulation::setTerrain(shared_ptr<Terrain> terrain) {
+	this->terrain = terrain;
+	manifold.clear();
+	contactTerrain = NULL;
+	groundBoxes.clear();
+}
+
+void LanderSimulation::start() {
+	if (gameplay == Waiting) gameplay = ToPad1;
+}
+
+glm::mat4 LanderSimulation::pose() const {
+	return glm::rotate(glm::translate(glm::mat4(1.0), position), glm::radians(rotation), glm::vec3(0, 1, 0));
+}
+
+glm::mat4 LanderSimulation::landerMatrix() const {
+	return pose() * landerBase;
+}
+
+Box LanderSimulation::landerBox() const {
+	Vector3 p = Vector3(position.x, position.y, position.z);
+	return Box(p + bounds.min(), p + bounds.max());
+}
+
+// withinPad:  pads are 10 x 10 squares on x-z (x, z in pad.x, pad.y)
+//
+bool LanderSimulation::withinPad(int pad) const {
+	if (pad < 0 || pad >= pads.size()) return false;
+	glm::vec3 p = pads[pad];
+	return ((position.x > p.x - 5 && position.x < p.x + 5)
+		&& (position.z > p.y - 5 && position.z < p.y + 5));
+}
+
+// advance:  a frame of frameTime seconds:  as many whole steps as it
+//           covers (the rest waits for the next frame), with the controls
+//           held through all of them.  returns the steps' events together
+//
+LanderEvents LanderSimulation::advance(float frameTime, const LanderControls& controls) {
+	LanderEvents events;
+	accumulator += ofClamp(frameTime, 0, maxFrameTime);
+	while (accumulator >= dt) {
+		accumulator -= dt;
+		LanderEvents e = step(controls);
+		events.bThrust = events.bThrust || e.bThrust;
+		events.bMainEngine = events.bMainEngine || e.bMainEngine;
+		events.bTouchdown = events.bTouchdown || e.bTouchdown;
+		events.bOutOfFuel = events.bOutOfFuel || e.bOutOfFuel;
+		if (e.bCrash) {
+			events.bCrash = true;
+			events.crashPoint = e.crashPoint;
+			events.crashTerrain = e.crashTerrain;
+		}
+	}
+	return events;
+}
+
+// step:  dt seconds of the game, in substepsNeeded() substeps
+//
+LanderEvents LanderSimulation::step(const LanderControls& controls) {
+	LanderEvents events;
+	numSteps++;
+	previousPosition = position;
+	previousRotation = rotation;
+	if (fuel <= 0) {
+		gameplay = OutOfFuel;
+		events.bOutOfFuel = true;
+	}
+
+	int n = substepsNeeded();
+	float h = dt / n;
+	for (int s = 0; s < n; s++) {
+		numSubsteps++;
+
+		// ground queries:  the lander box against octree leaves (used below
+		// by the collision check) and the altitude ray (its answer is used
+		// next step when it goes through the query service).  the extra
+		// substeps need the leaves right away and answer them in place
+		//
+		Box box = landerBox();
+		Ray down = makeRay(Vector3(position.x, position.y, position.z), Vector3(0, -1, 0));
+		QueryResult ground;
+		std::future<QueryResult> groundQuery;
+		bool bService = queries && s == 0;
+		if (bService) {
+			groundQuery = queries->submit(QueryRequest::leaves(box));
+			if (altitudeQuery.valid()) {
+				QueryResult result = altitudeQuery.get();
+				if (result.hit) altitude = result.t;
+			}
+			altitudeQuery = queries->submit(QueryRequest::closest(down));
+			queries->flush();
+		}
+		else {
+			answer(QueryRequest::leaves(box), ground);
+			if (!queries && s == 0) {
+				QueryResult result;
+				answer(QueryRequest::closest(down), result);
+				if (result.hit) altitude = result.t;
+			}
+		}
+		checkCollision(bService ? &groundQuery : NULL, ground, h, events);
+		bodies.endFrame();
+
+		if (s == 0) {
+			if (gameplay >= ToPad1 && gameplay <= ToPad3 && bGrounded && bLevelLanding && withinPad(gameplay)) {
+				gameplay++;
+			}
+			if (gameplay >= ToPad1 && gameplay <= ToPad3) applyControls(controls, events);
+		}
+		if (isFlying()) integrate(h);
+	}
+	force = glm::vec3(0, 0, 0);
+	angularForce = 0;
+	return events;
+}
+
+// substepsNeeded:  1 when nothing solid is within a step's travel of the
+//                  lander, otherwise enough that no substep moves it more
+//                  than substepTravel (up to maxSubsteps)
+//
+int LanderSimulation::substepsNeeded() const {
+	float travel = glm::length(velocity) * dt;
+	float limit = (substepTravel > 0) ? substepTravel : (bounds.max().y() - bounds.min().y()) * .25;
+	if (limit <= 0 || travel <= limit || terrain == NULL) return 1;
+
+	Box box = landerBox();
+	vector<const Terrain*> grounds(1, terrain.get());
+	if (tiles) {
+		vector<int> under;
+		TerrainTiles::overlapping(*tiles, box, under);
+		for (int i = 0; i < under.size(); i++) grounds.push_back((*tiles)[under[i]]->terrain.get());
+	}
+	bool bNear = false;
+	for (int g = 0; g < grounds.size() && !bNear; g++) {
+		float reach = travel + grounds[g]->occupancy.voxelSize;
+		Vector3 margin = Vector3(reach, reach, reach);
+		bNear = grounds[g]->occupancy.overlap(Box(box.min() - margin, box.max() + margin));
+	}
+	if (!bNear) return 1;
+	return min(maxSubsteps, (int)ceil(travel / limit));
+}
+
+// place:  put the lander at p directly (dragged in the view), with no
+//         motion from where it was to draw
+//
+void LanderSimulation::place(const glm::vec3& p) {
+	position = previousPosition = p;
+	previousRotation = rotation;
+}
+
+// renderPosition:  where the time left in the accumulator puts the
+//                  lander between the last two steps.  drawing it there
+//                  keeps motion smooth when the frame rate and the tick
+//                  rate differ
+//
+glm::vec3 LanderSimulation::renderPosition() const {
+	float alpha = ofClamp(accumulator / dt, 0, 1);
+	return previousPosition + (position - previousPosition) * alpha;
+}
+
+float LanderSimulation::renderRotation() const {
+	float alpha = ofClamp(accumulator / dt, 0, 1);
+	return ofLerp(previousRotation, rotation, alpha);
+}
+
+void LanderSimulation::applyControls(const LanderControls& controls, LanderEvents& events) {
+	float thrust = controls.thrust;
+	if (bGrounded && !controls.up) {
+		velocity = glm::vec3(0, 0, 0);
+		acceleration = glm::vec3(0, 0, 0);
+		force = glm::vec3(0, 0, 0);
+	}
+	if (controls.up) {
+		force += thrust * glm::vec3(0, 1, 0);
+		fuel -= fuelRate * dt;
+		events.bThrust = true;
+		events.bMainEngine = true;
+		bGrounded = false;
+	}
+	if (bGrounded) return;
+	if (controls.left) force += -thrust * glm::vec3(1, 0, 0);
+	if (controls.right) force += thrust * glm::vec3(1, 0, 0);
+	if (controls.down) force += -thrust * glm::vec3(0, 1, 0);
+	if (controls.forward) force += thrust * glm::vec3(0, 0, 1);
+	if (controls.back) force += -thrust * glm::vec3(0, 0, 1);
+	if (controls.turnLeft) angularForce += 50;
+	if (controls.turnRight) angularForce += -50;
+	if (controls.left || controls.right || controls.down || controls.forward || controls.back ||
+		controls.turnLeft || controls.turnRight) events.bThrust = true;
+}
+
+// integrate:  h seconds of motion (a step or a substep).  damping is
+//             .999 per 60th of a second whatever the tick rate or
+//             substeps
+//
+void LanderSimulation::integrate(float h) {
+	float damping = pow(.999f, h * 60);
+	position += velocity * h;
+	glm::vec3 accel = acceleration;
+	accel += (force + gravity);
+	velocity += accel * h;
+	velocity *= damping;
+
+	rotation += (angularVelocity * h);
+	float a = angularAcceleration;
+	a += angularForce;
+	angularVelocity += a * h;
+	angularVelocity *= damping;
+}
+
+// checkCollision:  broad phase (occupancy, fat boxes), the leaf boxes from
+//                  the ground query, then lander triangles against terrain
+//                  triangles for the contact manifold.  a hard hit
+//                  explodes the lander and makes a crater, otherwise it is
+//                  pushed back out and rests.  groundQuery NULL:  ground
+//                  is already answered.  h:  the (sub)step length
+//
+void LanderSimulation::checkCollision(std::future<QueryResult>* groundQuery, QueryResult& ground, float h, LanderEvents& events) {
+	Box landerBounds = landerBox();
+
+	// keep the lander's broad phase body up to date (one step of motion
+	// stretches its fat box) and refresh the moving object pairs
+	//
+	Vector3 step = Vector3(velocity.x, velocity.y, velocity.z) * h;
+	if (landerBody == -1) landerBody = bodies.addBody(landerBounds, 0);
+	else bodies.moveBody(landerBody, landerBounds, step);
+	bodies.findPairs();
+
+	// the ground under the lander:  the main terrain and the streamed tiles
+	// its box reaches (it can be over several at a tile border)
+	//
+	vector<const Terrain*> grounds(1, terrain.get());
+	if (tiles) {
+		vector<int> under;
+		TerrainTiles::overlapping(*tiles, landerBounds, under);
+		for (int i = 0; i < under.size(); i++) grounds.push_back((*tiles)[under[i]]->terrain.get());
+	}
+
+	// nothing solid anywhere near the lander (grown by a voxel since the
+	// voxelization is sampled), skip the octree.  then bodies whose fat
+	// boxes reach terrain faces go on to the octree
+	//
+	groundBoxes.clear();
+	vector<const Terrain*> nearGrounds;
+	for (int g = 0; g < grounds.size(); g++) {
+		const OccupancyGrid& occupancy = grounds[g]->occupancy;
+		Vector3 margin = Vector3(occupancy.voxelSize, occupancy.voxelSize, occupancy.voxelSize);
+		if (!occupancy.overlap(Box(landerBounds.min() - margin, landerBounds.max() + margin))) continue;
+
+		bodies.findTerrainCandidates(*grounds[g]->index, terrainCandidates);
+		for (int i = 0; i < terrainCandidates.size(); i++) {
+			if (terrainCandidates[i].proxy == landerBody) {
+				nearGrounds.push_back(grounds[g]);
+				break;
+			}
+		}
+	}
+	if (nearGrounds.size() == 0) {
+		manifold.clear();
+		return;
+	}
+
+	// leaf boxes from the query started at the top of the step
+	//
+	if (groundQuery) ground = groundQuery->get();
+	groundBoxes = ground.boxes;
+	if (!ground.hit) {
+		manifold.clear();
+		return;
+	}
+
+	// narrow phase:  the boxes only say we are close, make sure a lander
+	// triangle actually touches a terrain triangle and build the contact
+	// manifold (normal, depth) from the touching faces.  the manifold
+	// caches face data, so it starts over when the ground it is built on
+	// changes (lander crossing onto another tile)
+	//
+	contacts.clear();
+	glm::mat4 modelToWorld = landerMatrix();
+	const Terrain* touching = nearGrounds[0];
+	if (landerBVH.tris.size() > 0) {
+		for (int g = 0; g < nearGrounds.size(); g++) {
+			contacts.clear();
+			touching = nearGrounds[g];
+			if (landerBVH.collide(nearGrounds[g]->octree, modelToWorld, contacts) > 0) break;
+		}
+		if (touching != contactTerrain) manifold.clear();
+		contactTerrain = touching;
+		if (!manifold.update(touching->octree, landerBVH, modelToWorld, contacts)) return;
+	}
+	glm::vec3 n = glm::vec3(manifold.normal.x(), manifold.normal.y(), manifold.normal.z());
+
+	// use the speed into the surface, so hitting a slope sideways
+	// counts the same as dropping onto flat ground
+	//
+	glm::vec3 temp = force + velocity;
+	if (glm::dot(temp, n) < -4) {
+		velocity = glm::vec3(0, 200, 0);
+		gameplay = Exploded;
+
+		// blast a crater where the lander hit
+		//
+		Vector3 hit = Vector3(0, 0, 0);
+		for (int i = 0; i < manifold.points.size(); i++) hit = hit + manifold.points[i].point;
+		if (manifold.points.size() > 0) hit = hit / manifold.points.size();
+		else hit = Vector3(position.x, position.y, position.z);
+		events.bCrash = true;
+		events.crashPoint = hit;
+		events.crashTerrain = touching;
+		if (bMakeCraters && events.crashTerrain == terrain.get()) makeCrater(hit);
+	}
+	else {
+		// resting contact:  push the lander back out of the ground
+		//
+		if (manifold.depth > 0) position += n * manifold.depth;
+		bGrounded = true;
+		bLevelLanding = n.y >= cos(glm::radians(maxLandingSlope));
+		events.bTouchdown = true;
+	}
+}
+
+// makeCrater:  stamp a crater into the terrain at p and bring everything
+//              built from the terrain up to date for the changed region
+//              only.  the main terrain only:  tiles are const snapshots
+//              shared with the loaders and queries, so a crash on a tile
+//              (LanderEvents::crashTerrain) leaves no crater
+//
+void LanderSimulation::makeCrater(const Vector3& p) {
+	if (queries) queries->drain();
+	uint64_t start = ofGetElapsedTimeMicros();
+	Box region = terrain->octree.stampCrater(p, craterRadius, craterDepth, craterDepth * .3);
+	terrain->occupancy.update(terrain->octree, region);
+	craterMicros = ofGetElapsedTimeMicros() - start;
+	numCraters++;
+	terrain->countLeaves();
+
+	// backends other than the octree hold their own copy of the terrain
+	//
+	OctreeIndex* index = dynamic_cast<OctreeIndex*>(terrain->index);
+	if (index == NULL || index->octree != &terrain->octree) {
+		delete terrain->index;
+		terrain->index = new OctreeIndex(&terrain->octree);
+	}
+	manifold.clear();
+}
+
+// answer:  a ground query on the calling thread (as the query service
+//          would answer it)
+//
+void LanderSimulation::answer(const QueryRequest& request, QueryResult& result) const {
+	OctreeReader reader(terrain->octree);
+	QueryService::execute(*terrain, tiles.get(), reader, request, result);
+}
+
+// padAutopilot:  flies to the current pad and sets down slowly, for
+//                headless runs.  climbs away from ground it can't land on
+//
+LanderControls padAutopilot(const LanderSimulation& sim) {
+	LanderControls controls;
+	if (sim.gameplay < LanderSimulation::ToPad1 || sim.gameplay > LanderSimulation::ToPad3) return controls;
+	glm::vec3 pad = sim.pads[sim.gameplay];
+	float dx = pad.x - sim.position.x;
+	float dz = pad.y - sim.position.z;
+	float distance = sqrt(dx * dx + dz * dz);
+
+	// horizontal speed toward the pad, slower as it gets close
+	//
+	float vx = ofClamp(dx * .5, -3, 3);
+	float vz = ofClamp(dz * .5, -3, 3);
+	controls.right = sim.velocity.x < vx - .2;
+	controls.left = sim.velocity.x > vx + .2;
+	controls.forward = sim.velocity.z < vz - .2;
+	controls.back = sim.velocity.z > vz + .2;
+
+	// cruise a few units up, descend once over the pad
+	//
+	float vy = 0;
+	if (distance > 1 || !sim.withinPad(sim.gameplay)) vy = (sim.altitude < 4) ? 1 : 0;
+	else vy = -ofClamp(sim.altitude * .5, .5, 2);
+	if (sim.bGrounded && (!sim.withinPad(sim.gameplay) || !sim.bLevelLanding)) vy = 1;
+	controls.up = sim.velocity.y < vy;
+	controls.down = sim.velocity.y > vy + 1;
+	return controls;
+}
+
+// runHeadless:  "--headless" mode:  the terrain at terrainPath and the
+//               lander at landerPath (OBJ, data path relative), flown by
+//               padAutopilot() for up to numSteps steps with no window.
+//               prints the steps per second and how far it got
+//
+int runHeadless(const string& terrainPath, const string& landerPath, int numSteps) {
+	shared_ptr<Terrain> terrain = make_shared<Terrain>();
+	if (!terrain->load(terrainPath)) {
+		cout << "headless: can't load " << terrainPath << endl;
+		return 1;
+	}
+	LanderSimulation sim;
+	sim.setTerrain(terrain);
+	if (!sim.loadLander(landerPath, .005)) {
+		cout << "headless: can't load " << landerPath << endl;
+		return 1;
+	}
+	sim.start();
+	int touchdowns = 0;
+	uint64_t t1 = ofGetElapsedTimeMicros();
+	while (sim.numSteps < numSteps && sim.gameplay <= LanderSimulation::ToPad3) {
+		LanderEvents events = sim.step(padAutopilot(sim));
+		if (events.bTouchdown) touchdowns++;
+	}
+	uint64_t t2 = ofGetElapsedTimeMicros();
+	const char* phases[] = { "waiting", "flying to pad 1", "flying to pad 2", "flying to pad 3", "landed on all pads", "exploded", "out of fuel" };
+	cout << "headless: " << sim.numSteps << " steps (" << sim.numSteps * sim.dt << " s of game) in " << (t2 - t1) / 1000.0
+		<< " ms, " << (int)(sim.numSteps / ((t2 - t1) / 1e6)) << " steps/s" << endl;
+	cout << "  " << phases[sim.gameplay + 1] << ", fuel " << (int)sim.fuel << ", " << touchdowns << " steps on the ground" << endl;
+	return 0;
+}
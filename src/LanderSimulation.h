@@ -0,0 +1,156 @@
+//--------------------------------------------------------------
+//
+//  LanderSimulation - the game without the window
+//
+//  Lander physics, controls, fuel, altitude, ground contact and the
+//  landing pad sequence, stepped against a Terrain (and any streamed
+//  tiles) with no GL context and no model loader.  It runs the same in
+//  the app and headless (benchmarks, scripted flights with "--headless"
+//  on the command line, see main.cpp).
+//
+//  ofApp is a view on top of it:  each frame it turns the keys into
+//  LanderControls, calls step(), puts the lander model where the
+//  simulation says, and plays sound and particles from the step's
+//  LanderEvents.
+//
+//  The ground queries (altitude ray, lander box against octree leaves)
+//  go through a QueryService when one is set, submitted at the start of
+//  a step as the app did before, and are answered in place otherwise.
+//
+//  Time is fixed:  every step() is dt seconds (1 / tickRate) whatever the
+//  frame rate.  advance() runs as many steps as a frame's time covers and
+//  carries the rest over to the next frame, so a slow frame runs more
+//  steps rather than longer ones.  Close to the ground a step is split in
+//  substeps, each with its own collision check, so a fast lander can't
+//  pass through thin terrain between two checks.  The view draws the
+//  lander at renderPosition() and renderRotation(), between the last two
+//  steps by the time left over.
+//
+#pragma once
+#include "ofMain.h"
+#include "Terrain.h"
+#include "TerrainTiles.h"
+#include "QueryService.h"
+#include "MeshBVH.h"
+#include "ContactManifold.h"
+#include "AABBTree.h"
+
+class LanderControls {
+public:
+	float thrust = 8;
+	bool up = false, down = false;
+	bool left = false, right = false;		// -x, +x
+	bool forward = false, back = false;		// +z, -z
+	bool turnLeft = false, turnRight = false;
+};
+
+// what happened in a step, for the view (sound, particles, cameras)
+//
+class LanderEvents {
+public:
+	bool bThrust = false;		// an engine fired
+	bool bMainEngine = false;	// the up engine fired (exhaust)
+	bool bTouchdown = false;	// resting on the ground
+	bool bCrash = false;		// hit the ground too hard, crater made at crashPoint
+	bool bOutOfFuel = false;
+	Vector3 crashPoint = Vector3(0, 0, 0);
+	const Terrain* crashTerrain = NULL;	// ground hit:  the terrain or a tile (compared only)
+};
+
+class LanderSimulation {
+public:
+	// gameplay:  waiting for start, flying to pad 1, 2, 3, then over
+	//
+	enum Phase { Waiting = -1, ToPad1, ToPad2, ToPad3, Landed, Exploded, OutOfFuel };
+
+	void setLander(const vector<ofMesh>& meshes, const glm::mat4& base);
+	bool loadLander(const string& path, float scale);
+	void setTerrain(shared_ptr<Terrain> terrain);
+
+	void start();
+	void setTickRate(float rate) { tickRate = rate; dt = 1.0 / rate; }
+	LanderEvents advance(float frameTime, const LanderControls& controls);
+	LanderEvents step(const LanderControls& controls);
+	int substepsNeeded() const;
+	void place(const glm::vec3& p);
+	void makeCrater(const Vector3& p);
+
+	glm::mat4 pose() const;			// position and heading
+	glm::vec3 renderPosition() const;	// between the last two steps, for drawing
+	float renderRotation() const;
+	glm::mat4 landerMatrix() const;	// lander model to world
+	Box landerBox() const;
+	bool withinPad(int pad) const;
+	bool isFlying() const { return gameplay == ToPad1 || gameplay == ToPad2 || gameplay == ToPad3 || gameplay == Exploded; }
+
+	// lander state
+	//
+	glm::vec3 position = glm::vec3(0, 0, 0);
+	glm::vec3 velocity = glm::vec3(0, 0, 0);
+	glm::vec3 acceleration = glm::vec3(0, 0, 0);
+	glm::vec3 force = glm::vec3(0, 0, 0);
+	glm::vec3 gravity = glm::vec3(0, -2.5, 0);
+	float rotation = 0.0;			// degrees about y
+	float angularForce = 0;
+	float angularVelocity = 0.0;
+	float angularAcceleration = 0.0;
+	float altitude = 0;				// ground distance below the lander, last step
+	float fuel = 20000;
+	float fuelRate = 600;			// burnt a second of main engine (10 a step at 60 Hz)
+	int gameplay = Waiting;
+	bool bGrounded = false;
+	bool bLevelLanding = true;
+
+	// fixed timestep
+	//
+	float tickRate = 60;			// steps per second (set with setTickRate())
+	float dt = 1.0 / 60;
+	float accumulator = 0;			// frame time not yet stepped, less than dt after advance()
+	float maxFrameTime = .25;		// longer frames (a stall, a drag of the window) are cut to this
+	int maxSubsteps = 8;
+	float substepTravel = 0;		// most a substep may move (0:  a quarter of the lander's height)
+	glm::vec3 previousPosition = glm::vec3(0, 0, 0);	// pose before the last step, for drawing
+	float previousRotation = 0;
+
+	float maxLandingSlope = 30;		// degrees
+	float craterRadius = 4;
+	float craterDepth = 1.5;
+	bool bMakeCraters = true;		// false:  a crash only reports crashPoint, the terrain's owner calls makeCrater()
+									// (crashes on tiles make none, see makeCrater())
+	vector<glm::vec3> pads = { glm::vec3(5, 5, -4), glm::vec3(20, 20, -4), glm::vec3(40, 50, -4) };	// x, z in .x, .y
+
+	// world
+	//
+	shared_ptr<Terrain> terrain;
+	shared_ptr<const TileList> tiles;	// streamed tiles, set each frame (NULL for none)
+	QueryService* queries = NULL;		// NULL:  ground queries answered in place
+
+	// collision
+	//
+	MeshBVH landerBVH;				// lander model space
+	glm::mat4 landerBase = glm::mat4(1.0);	// lander model to lander space (scale)
+	Box bounds;						// lander space, unrotated
+	vector<Box> groundBoxes;		// octree leaves the lander box reached, last step
+	ContactManifold manifold;
+	const Terrain* contactTerrain = NULL;	// terrain or tile the manifold was built on (compared only)
+	BroadPhase bodies;				// moving objects (lander, debris, props)
+	int landerBody = -1;
+
+	int64_t numSteps = 0;
+	int64_t numSubsteps = 0;		// more than numSteps when steps were split near the ground
+	int numCraters = 0;
+	uint64_t craterMicros = 0;		// last crater, stamp and occupancy update
+
+private:
+	void applyControls(const LanderControls& controls, LanderEvents& events);
+	void integrate(float h);
+	void checkCollision(std::future<QueryResult>* groundQuery, QueryResult& ground, float h, LanderEvents& events);
+	void answer(const QueryRequest& request, QueryResult& result) const;
+
+	vector<TriContact> contacts;
+	vector<TerrainCandidate> terrainCandidates;
+	std::future<QueryResult> altitudeQuery;
+};
+
+LanderControls padAutopilot(const LanderSimulation& sim);
+int runHeadless(const string& terrainPath, const string& landerPath, int numSteps);
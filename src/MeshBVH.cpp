@@ -0,0 +1,352 @@
+//--------------------------------------------------------------
+//
+//  MeshBVH - lander triangle BVH and lander vs terrain narrow phase
+//
+
+
+#include "MeshBVH.h"
+#include "Triangle.h"
+#include "TraversalStack.h"
+#include <float.h>
+
+static Box triBounds(const BVHTri& t) {
+	Box box = Box(t.v[0], t.v[0]);
+	box.expand(t.v[1]);
+	box.expand(t.v[2]);
+	return box;
+}
+
+static Vector3 triCentroid(const BVHTri& t) {
+	return (t.v[0] + t.v[1] + t.v[2]) / 3;
+}
+
+static float boxArea(const Box& b) {
+	Vector3 size = b.parameters[1] - b.parameters[0];
+	return 2 * (size.x() * size.y() + size.y() * size.z() + size.z() * size.x());
+}
+
+static float boxVolume(const Box& b) {
+	Vector3 size = b.parameters[1] - b.parameters[0];
+	return size.x() * size.y() * size.z();
+}
+
+Vector3 MeshBVH::transformPoint(const glm::mat4& m, const Vector3& p) {
+	glm::vec4 q = m * glm::vec4(p.x(), p.y(), p.z(), 1);
+	return Vector3(q.x, q.y, q.z);
+}
+
+// transform an axis aligned box, return the axis aligned box around the result
+//
+Box MeshBVH::transformBox(const glm::mat4& m, const Box& box) {
+	Vector3 center = (box.parameters[0] + box.parameters[1]) * .5;
+	Vector3 extent = (box.parameters[1] - box.parameters[0]) * .5;
+	Vector3 c = transformPoint(m, center);
+	float e[3];
+	for (int r = 0; r < 3; r++) {
+		e[r] = fabsf(m[0][r]) * extent.x() + fabsf(m[1][r]) * extent.y() + fabsf(m[2][r]) * extent.z();
+	}
+	Vector3 ext = Vector3(e[0], e[1], e[2]);
+	return Box(c - ext, c + ext);
+}
+
+void MeshBVH::clear() {
+	tris.clear();
+	nodes.clear();
+}
+
+// create:  gather triangles of all the meshes and build the tree
+//
+void MeshBVH::create(const vector<ofMesh>& meshes) {
+	clear();
+	for (int m = 0; m < meshes.size(); m++) {
+		const ofMesh& mesh = meshes[m];
+		bool indexed = mesh.getNumIndices() > 0;
+		int nFaces = indexed ? mesh.getNumIndices() / 3 : mesh.getNumVertices() / 3;
+		for (int f = 0; f < nFaces; f++) {
+			BVHTri t;
+			t.mesh = m;
+			t.face = f;
+			for (int i = 0; i < 3; i++) {
+				glm::vec3 p = mesh.getVertex(indexed ? mesh.getIndex(f * 3 + i) : f * 3 + i);
+				t.v[i] = Vector3(p.x, p.y, p.z);
+			}
+			tris.push_back(t);
+		}
+	}
+	if (tris.size() == 0) return;
+	nodes.reserve(2 * tris.size() / maxLeafTris + 1);
+	subdivide(0, tris.size());
+	cout << "BVH: " << tris.size() << " triangles, " << nodes.size() << " nodes" << endl;
+}
+
+// subdivide:  make a node for tris[first .. first+count-1] and split it.
+//             the centroids are sorted into numBins bins along each axis and
+//             the bin boundary with the lowest SAH cost
+//                 area(left) * count(left) + area(right) * count(right)
+//             is used.  falls back to a median split if the bins can't
+//             separate anything.  return node index
+//
+int MeshBVH::subdivide(int first, int count) {
+	int index = nodes.size();
+	nodes.push_back(BVHNode());
+
+	Box box = triBounds(tris[first]);
+	Vector3 c0 = triCentroid(tris[first]);
+	Box cbox = Box(c0, c0);
+	for (int i = first; i < first + count; i++) {
+		box.expand(triBounds(tris[i]));
+		cbox.expand(triCentroid(tris[i]));
+	}
+	nodes[index].box = box;
+
+	if (count <= maxLeafTris) {
+		nodes[index].first = first;
+		nodes[index].count = count;
+		return index;
+	}
+
+	int bestAxis = -1;
+	int bestSplit = 0;
+	float bestCost = FLT_MAX;
+	for (int axis = 0; axis < 3; axis++) {
+		float lo = cbox.parameters[0][axis];
+		float extent = cbox.parameters[1][axis] - lo;
+		if (extent <= 0) continue;
+
+		int binCount[numBins] = { 0 };
+		Box binBox[numBins];
+		for (int i = first; i < first + count; i++) {
+			int b = min((int)((triCentroid(tris[i])[axis] - lo) / extent * numBins), numBins - 1);
+			if (binCount[b] == 0) binBox[b] = triBounds(tris[i]);
+			else binBox[b].expand(triBounds(tris[i]));
+			binCount[b]++;
+		}
+
+		// sweep from the right to get the right side of every split,
+		// then from the left
+		//
+		float rightArea[numBins];
+		int rightCount[numBins];
+		Box acc;
+		int n = 0;
+		for (int b = numBins - 1; b > 0; b--) {
+			if (binCount[b] > 0) {
+				if (n == 0) acc = binBox[b];
+				else acc.expand(binBox[b]);
+				n += binCount[b];
+			}
+			rightCount[b] = n;
+			rightArea[b] = (n > 0) ? boxArea(acc) : 0;
+		}
+		n = 0;
+		for (int b = 0; b < numBins - 1; b++) {
+			if (binCount[b] > 0) {
+				if (n == 0) acc = binBox[b];
+				else acc.expand(binBox[b]);
+				n += binCount[b];
+			}
+			if (n == 0 || rightCount[b + 1] == 0) continue;
+			float cost = boxArea(acc) * n + rightArea[b + 1] * rightCount[b + 1];
+			if (cost < bestCost) {
+				bestCost = cost;
+				bestAxis = axis;
+				bestSplit = b + 1;
+			}
+		}
+	}
+
+	int mid = first + count / 2;
+	if (bestAxis >= 0) {
+		int axis = bestAxis;
+		float lo = cbox.parameters[0][axis];
+		float extent = cbox.parameters[1][axis] - lo;
+		int split = bestSplit;
+		BVHTri* p = partition(&tris[0] + first, &tris[0] + first + count,
+			[axis, lo, extent, split](const BVHTri& t) {
+				return min((int)((triCentroid(t)[axis] - lo) / extent * numBins), numBins - 1) < split;
+			});
+		mid = p - &tris[0];
+	}
+	if (mid == first || mid == first + count) {
+		Vector3 size = cbox.parameters[1] - cbox.parameters[0];
+		int axis = 0;
+		if (size.y() > size[axis]) axis = 1;
+		if (size.z() > size[axis]) axis = 2;
+		mid = first + count / 2;
+		nth_element(tris.begin() + first, tris.begin() + mid, tris.begin() + first + count,
+			[axis](const BVHTri& a, const BVHTri& b) {
+				return triCentroid(a)[axis] < triCentroid(b)[axis];
+			});
+	}
+
+	int left = subdivide(first, mid - first);
+	int right = subdivide(mid, first + count - mid);
+	nodes[index].left = left;
+	nodes[index].right = right;
+	return index;
+}
+
+// collide:  find all model triangles touching terrain triangles.  modelToWorld
+//           is the model's current transform.  appends unique pairs to
+//           contactsRtn, returns number of pairs found
+//
+int MeshBVH::collide(const Octree& octree, const glm::mat4& modelToWorld, vector<TriContact>& contactsRtn) {
+	if (nodes.size() == 0) return 0;
+	glm::mat4 worldToModel = glm::inverse(modelToWorld);
+	int start = contactsRtn.size();
+	collide(octree, octree.root, 0, worldToModel, contactsRtn);
+
+	// a terrain face can be in the leaves of all 3 of its vertices
+	//
+	sort(contactsRtn.begin() + start, contactsRtn.end());
+	contactsRtn.erase(unique(contactsRtn.begin() + start, contactsRtn.end()), contactsRtn.end());
+	return contactsRtn.size() - start;
+}
+
+// dual traversal:  descend whichever of the two nodes is bigger
+//
+void MeshBVH::collide(const Octree& octree, const TreeNode& tnode, int bnode,
+	const glm::mat4& worldToModel, vector<TriContact>& contactsRtn)
+{
+	const BVHNode& b = nodes[bnode];
+	Box tbox = transformBox(worldToModel, tnode.faceBounds);
+	if (!tbox.overlap(b.box)) return;
+
+	bool tLeaf = tnode.children.size() == 0;
+	bool bLeaf = b.count > 0;
+	if (tLeaf && bLeaf) {
+		collideLeaves(octree, tnode, b, worldToModel, contactsRtn);
+	}
+	else if (tLeaf || (!bLeaf && boxVolume(b.box) > boxVolume(tbox))) {
+		collide(octree, tnode, b.left, worldToModel, contactsRtn);
+		collide(octree, tnode, b.right, worldToModel, contactsRtn);
+	}
+	else {
+		for (int i = 0; i < tnode.children.size(); i++) {
+			collide(octree, tnode.children[i], bnode, worldToModel, contactsRtn);
+		}
+	}
+}
+
+void MeshBVH::collideLeaves(const Octree& octree, const TreeNode& tnode, const BVHNode& bnode,
+	const glm::mat4& worldToModel, vector<TriContact>& contactsRtn)
+{
+	for (int i = 0; i < tnode.faces.size(); i++) {
+		Vector3 t[3];
+		octree.getFaceVerts(tnode.faces[i], t);
+		for (int k = 0; k < 3; k++) t[k] = transformPoint(worldToModel, t[k]);
+
+		Box fbox = Box(t[0], t[0]);
+		fbox.expand(t[1]);
+		fbox.expand(t[2]);
+		if (!fbox.overlap(bnode.box)) continue;
+
+		for (int j = bnode.first; j < bnode.first + bnode.count; j++) {
+			if (triTriOverlap(tris[j].v, t)) {
+				TriContact c;
+				c.landerTri = j;
+				c.terrainFace = tnode.faces[i];
+				contactsRtn.push_back(c);
+			}
+		}
+	}
+}
+
+// intersect:  closest triangle along the ray for t in (t0, t1).  walks the
+//             tree with a small stack, nearer child first, and drops any
+//             node that starts past the best hit so far
+//
+bool MeshBVH::intersect(const Ray& ray, float t0, float t1, float& tRtn, int& triRtn) const {
+	triRtn = -1;
+	tRtn = t1;
+	if (nodes.size() == 0) return false;
+
+	struct Entry { int node; float t; };
+	TraversalStack<Entry> stack;
+	float tNear, tFar;
+	if (!nodes[0].box.intersect(ray, t0, t1, tNear, tFar)) return false;
+	stack.push({ 0, tNear });
+
+	while (!stack.empty()) {
+		Entry e = stack.pop();
+		if (e.t >= tRtn) continue;
+		const BVHNode& node = nodes[e.node];
+		if (node.count > 0) {
+			float t;
+			for (int i = node.first; i < node.first + node.count; i++) {
+				if (rayTriangle(ray.origin, ray.direction, tris[i].v, t0, tRtn, t)) {
+					tRtn = t;
+					triRtn = i;
+				}
+			}
+			continue;
+		}
+		float tl, tr, tf;
+		bool hitLeft = nodes[node.left].box.intersect(ray, t0, tRtn, tl, tf);
+		bool hitRight = nodes[node.right].box.intersect(ray, t0, tRtn, tr, tf);
+
+		// push the far one first so the near one is popped next
+		//
+		if (hitLeft && hitRight) {
+			if (tl < tr) {
+				stack.push({ node.right, tr });
+				stack.push({ node.left, tl });
+			}
+			else {
+				stack.push({ node.left, tl });
+				stack.push({ node.right, tr });
+			}
+		}
+		else if (hitLeft) {
+			stack.push({ node.left, tl });
+		}
+		else if (hitRight) {
+			stack.push({ node.right, tr });
+		}
+	}
+	return triRtn >= 0;
+}
+
+// intersectAny:  true as soon as any triangle is hit for t in (t0, t1)
+//
+bool MeshBVH::intersectAny(const Ray& ray, float t0, float t1) const {
+	if (nodes.size() == 0) return false;
+	TraversalStack<int> stack;
+	stack.push(0);
+	while (!stack.empty()) {
+		const BVHNode& node = nodes[stack.pop()];
+		if (!node.box.intersect(ray, t0, t1)) continue;
+		if (node.count > 0) {
+			float t;
+			for (int i = node.first; i < node.first + node.count; i++) {
+				if (rayTriangle(ray.origin, ray.direction, tris[i].v, t0, t1, t)) return true;
+			}
+			continue;
+		}
+		stack.push(node.right);
+		stack.push(node.left);
+	}
+	return false;
+}
+
+// overlap:  triangles whose bounding box overlaps box.  returns count found
+//
+int MeshBVH::overlap(const Box& box, vector<int>& trisRtn) const {
+	if (nodes.size() == 0) return 0;
+	int count = trisRtn.size();
+	TraversalStack<int> stack;
+	stack.push(0);
+	while (!stack.empty()) {
+		const BVHNode& node = nodes[stack.pop()];
+		if (!node.box.overlap(box)) continue;
+		if (node.count > 0) {
+			for (int i = node.first; i < node.first + node.count; i++) {
+				if (triBounds(tris[i]).overlap(box)) trisRtn.push_back(i);
+			}
+			continue;
+		}
+		stack.push(node.right);
+		stack.push(node.left);
+	}
+	return trisRtn.size() - count;
+}
@@ -0,0 +1,81 @@
+//--------------------------------------------------------------
+//
+//  MeshBVH - bounding volume hierarchy over the triangles of a
+//  mesh, kept in the mesh's own coordinate space.  Built top down
+//  with the binned surface area heuristic (SAH).
+//
+//  The lander's is built once when the model is loaded.  Each frame
+//  the terrain octree boxes are moved into model space and the two
+//  trees are walked together (collide()); only where a BVH leaf and
+//  an octree leaf overlap are the actual triangles tested against
+//  each other.  The terrain can be indexed by one too (BVHIndex in
+//  SpatialIndex), queried with intersect() and overlap().
+//
+#pragma once
+#include "ofMain.h"
+#include "Octree.h"
+
+// a triangle of the model, in model space
+//
+class BVHTri {
+public:
+	Vector3 v[3];
+	int mesh;
+	int face;		// index of the face in its mesh
+};
+
+// interior nodes use left/right, leaf nodes use first/count
+// into the (reordered) triangle array
+//
+class BVHNode {
+public:
+	Box box;
+	int left = -1;
+	int right = -1;
+	int first = 0;
+	int count = 0;
+};
+
+// a model triangle touching a terrain face
+//
+class TriContact {
+public:
+	int landerTri;
+	int terrainFace;
+
+	bool operator<(const TriContact& c) const {
+		return landerTri < c.landerTri || (landerTri == c.landerTri && terrainFace < c.terrainFace);
+	}
+	bool operator==(const TriContact& c) const {
+		return landerTri == c.landerTri && terrainFace == c.terrainFace;
+	}
+};
+
+class MeshBVH {
+public:
+	void create(const vector<ofMesh>& meshes);
+	void clear();
+	int collide(const Octree& octree, const glm::mat4& modelToWorld, vector<TriContact>& contactsRtn);
+
+	// model space queries, triangle indices are into tris
+	//
+	bool intersect(const Ray& ray, float t0, float t1, float& tRtn, int& triRtn) const;
+	bool intersectAny(const Ray& ray, float t0, float t1) const;
+	int overlap(const Box& box, vector<int>& trisRtn) const;
+
+	static Box transformBox(const glm::mat4& m, const Box& box);
+	static Vector3 transformPoint(const glm::mat4& m, const Vector3& p);
+
+	vector<BVHTri> tris;
+	vector<BVHNode> nodes;
+
+	static const int maxLeafTris = 4;
+	static const int numBins = 12;
+
+private:
+	int subdivide(int first, int count);
+	void collide(const Octree& octree, const TreeNode& tnode, int bnode,
+		const glm::mat4& worldToModel, vector<TriContact>& contactsRtn);
+	void collideLeaves(const Octree& octree, const TreeNode& tnode, const BVHNode& bnode,
+		const glm::mat4& worldToModel, vector<TriContact>& contactsRtn);
+};
@@ -0,0 +1,133 @@
+//--------------------------------------------------------------
+//
+//  Numa - NUMA topology, thread pinning and per node terrain copies
+//
+
+#include "Numa.h"
+#include <fstream>
+#include <sstream>
+#ifdef __linux__
+#include <sched.h>
+#include <pthread.h>
+#endif
+
+// parseCpuList:  "0-3,8,10-11" as in /sys cpulist files
+//
+static vector<int> parseCpuList(const string& text) {
+	vector<int> cpus;
+	std::stringstream in(text);
+	string range;
+	while (getline(in, range, ',')) {
+		if (range.find_first_of("0123456789") == string::npos) continue;
+		int lo = 0, hi = 0;
+		size_t dash = range.find('-');
+		lo = hi = atoi(range.c_str());
+		if (dash != string::npos) hi = atoi(range.c_str() + dash + 1);
+		for (int cpu = lo; cpu <= hi; cpu++) cpus.push_back(cpu);
+	}
+	return cpus;
+}
+
+static NumaTopology detectTopology() {
+	NumaTopology topology;
+#ifdef __linux__
+	cpu_set_t allowed;
+	CPU_ZERO(&allowed);
+	sched_getaffinity(0, sizeof(allowed), &allowed);
+	for (int node = 0; node < 1024; node++) {
+		std::ifstream in("/sys/devices/system/node/node" + ofToString(node) + "/cpulist");
+		if (!in) {
+			if (node > 0 && topology.bDetected) break;
+			continue;
+		}
+		string text;
+		getline(in, text);
+		vector<int> cpus;
+		vector<int> listed = parseCpuList(text);
+		for (int i = 0; i < listed.size(); i++) {
+			if (listed[i] < CPU_SETSIZE && CPU_ISSET(listed[i], &allowed)) cpus.push_back(listed[i]);
+		}
+		topology.bDetected = true;
+		if (cpus.size() > 0) topology.nodes.push_back(cpus);
+	}
+	if (topology.nodes.size() > 0) return topology;
+	topology.bDetected = false;
+	vector<int> cpus;
+	for (int cpu = 0; cpu < CPU_SETSIZE; cpu++) {
+		if (CPU_ISSET(cpu, &allowed)) cpus.push_back(cpu);
+	}
+	topology.nodes.push_back(cpus);
+#else
+	vector<int> cpus;
+	for (int cpu = 0; cpu < max(1, (int)std::thread::hardware_concurrency()); cpu++) cpus.push_back(cpu);
+	topology.nodes.push_back(cpus);
+#endif
+	return topology;
+}
+
+const NumaTopology& NumaTopology::get() {
+	static const NumaTopology topology = detectTopology();
+	return topology;
+}
+
+int NumaTopology::nodeOfCpu(int cpu) const {
+	for (int node = 0; node < nodes.size(); node++) {
+		if (find(nodes[node].begin(), nodes[node].end(), cpu) != nodes[node].end()) return node;
+	}
+	return -1;
+}
+
+// pinThreadToNode:  false if the node doesn't exist or pinning isn't
+//                   supported here
+//
+bool pinThreadToNode(int node) {
+	const NumaTopology& topology = NumaTopology::get();
+	if (node < 0 || node >= topology.numNodes()) return false;
+#ifdef __linux__
+	cpu_set_t cpus;
+	CPU_ZERO(&cpus);
+	for (int i = 0; i < topology.nodes[node].size(); i++) CPU_SET(topology.nodes[node][i], &cpus);
+	return pthread_setaffinity_np(pthread_self(), sizeof(cpus), &cpus) == 0;
+#else
+	return false;
+#endif
+}
+
+// currentNumaNode:  node of the CPU the calling thread is on now (0 if
+//                   unknown)
+//
+int currentNumaNode() {
+#ifdef __linux__
+	int node = NumaTopology::get().nodeOfCpu(sched_getcpu());
+	return max(node, 0);
+#else
+	return 0;
+#endif
+}
+
+// local:  node's copy of terrain, made now by the calling thread if
+//         there is none for this version yet.  call it from a thread
+//         pinned to node, so the copy's memory lands there
+//
+shared_ptr<Terrain> TerrainReplicas::local(const shared_ptr<Terrain>& terrain, int node) {
+	if (node < 0 || node >= replicas.size()) return terrain;
+	Replica& replica = replicas[node];
+	std::lock_guard<std::mutex> lock(replica.mutex);
+	if (replica.copy == NULL || replica.source.lock() != terrain) {
+		replica.copy.reset();		// free the old copy first, the new one may need the room
+		replica.copy = terrain->replicate();
+		replica.source = terrain;
+	}
+	return replica.copy;
+}
+
+// clear:  drop every copy (after an edit in place of the terrain they
+//         were made from)
+//
+void TerrainReplicas::clear() {
+	for (int node = 0; node < replicas.size(); node++) {
+		std::lock_guard<std::mutex> lock(replicas[node].mutex);
+		replicas[node].copy.reset();
+		replicas[node].source.reset();
+	}
+}
@@ -0,0 +1,53 @@
+//--------------------------------------------------------------
+//
+//  Numa - NUMA topology, thread pinning and per node terrain copies
+//
+//  On a multi-socket machine each socket (NUMA node) has memory of its
+//  own, and a thread reading another node's memory pays extra latency
+//  on every octree node it visits.  Linux puts a page on the node of
+//  the thread that first writes it, so a copy of the terrain made by a
+//  thread pinned to a node lives on that node (first touch, no libnuma
+//  needed).  TerrainReplicas keeps one such copy per node for each
+//  terrain version; QueryService uses it with bReplicate set, pinning
+//  each worker to a node and answering from that node's copy.
+//
+//  The topology comes from /sys/devices/system/node (Linux).  Elsewhere,
+//  or on a single socket, there is one node holding every CPU and
+//  pinning does nothing.
+//
+#pragma once
+#include "ofMain.h"
+#include "Terrain.h"
+#include <mutex>
+
+class NumaTopology {
+public:
+	static const NumaTopology& get();		// detected on first use
+
+	int numNodes() const { return nodes.size(); }
+	int nodeOfCpu(int cpu) const;
+
+	vector<vector<int> > nodes;		// CPUs of each node this process may run on
+	bool bDetected = false;			// false:  one node made up of every CPU
+};
+
+bool pinThreadToNode(int node);		// current thread, to the node's CPUs
+int currentNumaNode();
+
+class TerrainReplicas {
+public:
+	TerrainReplicas() : replicas(NumaTopology::get().numNodes()) { }
+
+	shared_ptr<Terrain> local(const shared_ptr<Terrain>& terrain, int node);
+	void clear();
+
+private:
+	class Replica {
+	public:
+		std::weak_ptr<Terrain> source;
+		shared_ptr<Terrain> copy;
+		std::mutex mutex;
+	};
+
+	vector<Replica> replicas;		// by node
+};
@@ -0,0 +1,73 @@
+//--------------------------------------------------------------
+//
+//  ObjLoader - geometry only Wavefront OBJ reader
+//
+
+#include "ObjLoader.h"
+#include <fstream>
+#include <sstream>
+#include <unordered_map>
+
+// objIndex:  vertex number from a face entry ("7", "7/2", "7//3", "-1")
+//            as a 0 based index into positions, -1 if bad
+//
+static int objIndex(const string& entry, int numPositions) {
+	int i = atoi(entry.c_str());
+	if (i < 0) i = numPositions + i;
+	else i = i - 1;
+	if (i < 0 || i >= numPositions) return -1;
+	return i;
+}
+
+// loadObjMeshes:  meshes of the file at path (data path relative, like
+//                 ofxAssimpModelLoader).  false if it can't be read or
+//                 has no faces
+//
+bool loadObjMeshes(const string& path, vector<ofMesh>& meshesRtn) {
+	ifstream file(ofToDataPath(path));
+	if (!file) return false;
+
+	vector<glm::vec3> positions;
+	unordered_map<int, int> remap;		// position to vertex of the current mesh
+	ofMesh mesh;
+	int numMeshes = meshesRtn.size();
+
+	string line;
+	vector<int> poly;
+	while (getline(file, line)) {
+		istringstream in(line);
+		string tag;
+		in >> tag;
+		if (tag == "v") {
+			glm::vec3 p;
+			in >> p.x >> p.y >> p.z;
+			positions.push_back(p);
+		}
+		else if (tag == "f") {
+			poly.clear();
+			string entry;
+			while (in >> entry) {
+				int i = objIndex(entry, positions.size());
+				if (i < 0) continue;
+				auto it = remap.find(i);
+				if (it == remap.end()) {
+					it = remap.insert(make_pair(i, (int)mesh.getNumVertices())).first;
+					mesh.addVertex(positions[i]);
+				}
+				poly.push_back(it->second);
+			}
+			for (int k = 2; k < poly.size(); k++) {
+				mesh.addIndex(poly[0]);
+				mesh.addIndex(poly[k - 1]);
+				mesh.addIndex(poly[k]);
+			}
+		}
+		else if ((tag == "o" || tag == "g") && mesh.getNumIndices() > 0) {
+			meshesRtn.push_back(mesh);
+			mesh.clear();
+			remap.clear();
+		}
+	}
+	if (mesh.getNumIndices() > 0) meshesRtn.push_back(mesh);
+	return meshesRtn.size() > numMeshes;
+}
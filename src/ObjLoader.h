@@ -0,0 +1,15 @@
+//--------------------------------------------------------------
+//
+//  ObjLoader - geometry only Wavefront OBJ reader
+//
+//  Reads positions and faces into ofMeshes on the CPU, without a GL
+//  context, so it can run on a background thread (ofxAssimpModelLoader
+//  can't).  Every object / group ("o", "g") with faces becomes its own
+//  mesh, in file order.  Polygons are split into triangle fans, negative
+//  (relative) indices are supported; texture coordinates, normals and
+//  materials are skipped (Octree averages face normals).
+//
+#pragma once
+#include "ofMain.h"
+
+bool loadObjMeshes(const string& path, vector<ofMesh>& meshesRtn);
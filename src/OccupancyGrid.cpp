@@ -0,0 +1,222 @@
+//--------------------------------------------------------------
+//
+//  OccupancyGrid - sparse voxel occupancy of the terrain
+//
+
+
+#include "OccupancyGrid.h"
+#include <float.h>
+
+// pack brick coordinates, 21 bits each (offset so negatives work)
+//
+uint64_t OccupancyGrid::brickKey(int bx, int by, int bz) {
+	const uint64_t mask = (1 << 21) - 1;
+	const int offset = 1 << 20;
+	return ((uint64_t)((bx + offset) & mask) << 42) | ((uint64_t)((by + offset) & mask) << 21) |
+		(uint64_t)((bz + offset) & mask);
+}
+
+int OccupancyGrid::voxelCoord(float v, int axis) const {
+	return (int)floorf((v - origin[axis]) / voxelSize);
+}
+
+void OccupancyGrid::setVoxel(int x, int y, int z) {
+	bricks[brickKey(x >> 2, y >> 2, z >> 2)] |= (uint64_t)1 << bitIndex(x, y, z);
+}
+
+void OccupancyGrid::clearVoxel(int x, int y, int z) {
+	unordered_map<uint64_t, uint64_t>::iterator it = bricks.find(brickKey(x >> 2, y >> 2, z >> 2));
+	if (it == bricks.end()) return;
+	it->second &= ~((uint64_t)1 << bitIndex(x, y, z));
+	if (it->second == 0) bricks.erase(it);
+}
+
+bool OccupancyGrid::getVoxel(int x, int y, int z) const {
+	unordered_map<uint64_t, uint64_t>::const_iterator it = bricks.find(brickKey(x >> 2, y >> 2, z >> 2));
+	if (it == bricks.end()) return false;
+	return (it->second >> bitIndex(x, y, z)) & 1;
+}
+
+void OccupancyGrid::clear() {
+	bricks.clear();
+}
+
+// create:  voxelize the terrain at the given resolution from the octree's
+//          leaves.  each face is visited once even though it can be in the
+//          leaves of all three of its vertices
+//
+void OccupancyGrid::create(const Octree& octree, float size) {
+	float startTime = ofGetElapsedTimeMillis();
+	clear();
+	voxelSize = size;
+	bounds = octree.root.box;
+	origin = bounds.parameters[0];
+
+	vector<const TreeNode*> leaves;
+	octree.getLeaves(octree.root, leaves);
+	vector<char> faceDone(octree.getNumFaces(), 0);
+	for (int i = 0; i < leaves.size(); i++) {
+		const TreeNode& leaf = *leaves[i];
+		for (int j = 0; j < leaf.points.size(); j++) {
+			glm::vec3 p = octree.mesh.getVertex(leaf.points[j]);
+			setVoxel(voxelCoord(p.x, 0), voxelCoord(p.y, 1), voxelCoord(p.z, 2));
+		}
+		for (int j = 0; j < leaf.faces.size(); j++) {
+			if (faceDone[leaf.faces[j]]) continue;
+			faceDone[leaf.faces[j]] = 1;
+			Vector3 v[3];
+			octree.getFaceVerts(leaf.faces[j], v);
+			markTriangle(v);
+		}
+	}
+	float endTime = ofGetElapsedTimeMillis();
+	cout << "occupancy grid: " << bricks.size() << " bricks, " << endTime - startTime << " millisec" << endl;
+}
+
+// update:  the terrain changed inside region (see Octree::stampCrater()).
+//          clear the voxels wholly inside it (voxels on the edge may
+//          also hold terrain outside) and mark them again from the faces
+//          of the leaves reaching into it
+//
+void OccupancyGrid::update(const Octree& octree, const Box& region) {
+	int lo[3], hi[3];
+	for (int i = 0; i < 3; i++) {
+		lo[i] = voxelCoord(region.parameters[0][i], i) + 1;
+		hi[i] = voxelCoord(region.parameters[1][i], i) - 1;
+	}
+	for (int z = lo[2]; z <= hi[2]; z++)
+		for (int y = lo[1]; y <= hi[1]; y++)
+			for (int x = lo[0]; x <= hi[0]; x++)
+				clearVoxel(x, y, z);
+	bounds.expand(region);
+
+	vector<const TreeNode*> leaves;
+	octree.getLeaves(region, octree.root, leaves);
+	vector<int> faces;
+	for (int i = 0; i < leaves.size(); i++) {
+		const TreeNode& leaf = *leaves[i];
+		for (int j = 0; j < leaf.points.size(); j++) {
+			glm::vec3 p = octree.mesh.getVertex(leaf.points[j]);
+			setVoxel(voxelCoord(p.x, 0), voxelCoord(p.y, 1), voxelCoord(p.z, 2));
+		}
+		faces.insert(faces.end(), leaf.faces.begin(), leaf.faces.end());
+	}
+	sort(faces.begin(), faces.end());
+	faces.erase(unique(faces.begin(), faces.end()), faces.end());
+	for (int i = 0; i < faces.size(); i++) {
+		Vector3 v[3];
+		octree.getFaceVerts(faces[i], v);
+		markTriangle(v);
+	}
+}
+
+// markTriangle:  sample the triangle at half voxel spacing
+//
+void OccupancyGrid::markTriangle(const Vector3 v[3]) {
+	float longest = fmaxf((v[1] - v[0]).length(), fmaxf((v[2] - v[1]).length(), (v[0] - v[2]).length()));
+	int steps = (int)ceilf(longest / (voxelSize * .5f));
+	if (steps < 1) steps = 1;
+	for (int i = 0; i <= steps; i++) {
+		for (int j = 0; j <= steps - i; j++) {
+			float a = i / (float)steps;
+			float b = j / (float)steps;
+			Vector3 p = v[0] + (v[1] - v[0]) * a + (v[2] - v[0]) * b;
+			setVoxel(voxelCoord(p.x(), 0), voxelCoord(p.y(), 1), voxelCoord(p.z(), 2));
+		}
+	}
+}
+
+bool OccupancyGrid::occupied(const Vector3& p) const {
+	return getVoxel(voxelCoord(p.x(), 0), voxelCoord(p.y(), 1), voxelCoord(p.z(), 2));
+}
+
+// intersect:  march the ray through the voxels from t0 to t1 (clipped to the
+//             grid bounds); return the entry t of the first occupied voxel
+//
+bool OccupancyGrid::intersect(const Ray& ray, float t0, float t1, float& tRtn) const {
+	float tNear, tFar;
+	if (!bounds.intersect(ray, t0, t1, tNear, tFar)) return false;
+
+	Vector3 p = ray.origin + ray.direction * tNear;
+	int cell[3], step[3];
+	float tMax[3], tDelta[3];
+	for (int i = 0; i < 3; i++) {
+		cell[i] = voxelCoord(p[i], i);
+		if (ray.direction[i] > 0) {
+			step[i] = 1;
+			tMax[i] = tNear + ((origin[i] + (cell[i] + 1) * voxelSize) - p[i]) / ray.direction[i];
+			tDelta[i] = voxelSize / ray.direction[i];
+		}
+		else if (ray.direction[i] < 0) {
+			step[i] = -1;
+			tMax[i] = tNear + ((origin[i] + cell[i] * voxelSize) - p[i]) / ray.direction[i];
+			tDelta[i] = -voxelSize / ray.direction[i];
+		}
+		else {
+			step[i] = 0;
+			tMax[i] = FLT_MAX;
+			tDelta[i] = FLT_MAX;
+		}
+	}
+
+	float t = tNear;
+	while (t <= tFar) {
+		if (getVoxel(cell[0], cell[1], cell[2])) {
+			tRtn = t;
+			return true;
+		}
+		int axis = 0;
+		if (tMax[1] < tMax[axis]) axis = 1;
+		if (tMax[2] < tMax[axis]) axis = 2;
+		t = tMax[axis];
+		tMax[axis] += tDelta[axis];
+		cell[axis] += step[axis];
+	}
+	return false;
+}
+
+// overlap:  true if any occupied voxel touches the box.  works a brick at a
+//           time, masking off the voxels of the brick outside the box
+//
+bool OccupancyGrid::overlap(const Box& box) const {
+	int lo[3], hi[3];
+	for (int i = 0; i < 3; i++) {
+		lo[i] = voxelCoord(box.parameters[0][i], i);
+		hi[i] = voxelCoord(box.parameters[1][i], i);
+	}
+	for (int bz = lo[2] >> 2; bz <= hi[2] >> 2; bz++) {
+		for (int by = lo[1] >> 2; by <= hi[1] >> 2; by++) {
+			for (int bx = lo[0] >> 2; bx <= hi[0] >> 2; bx++) {
+				unordered_map<uint64_t, uint64_t>::const_iterator it = bricks.find(brickKey(bx, by, bz));
+				if (it == bricks.end()) continue;
+
+				// voxel range inside this brick, 0..3 on each axis
+				//
+				int x0 = max(lo[0] - bx * 4, 0), x1 = min(hi[0] - bx * 4, 3);
+				int y0 = max(lo[1] - by * 4, 0), y1 = min(hi[1] - by * 4, 3);
+				int z0 = max(lo[2] - bz * 4, 0), z1 = min(hi[2] - bz * 4, 3);
+				uint64_t row = ((1 << (x1 + 1)) - 1) & ~((1 << x0) - 1);
+				uint64_t mask = 0;
+				for (int z = z0; z <= z1; z++) {
+					for (int y = y0; y <= y1; y++) {
+						mask |= row << ((z << 4) | (y << 2));
+					}
+				}
+				if (it->second & mask) return true;
+			}
+		}
+	}
+	return false;
+}
+
+// batch form, hitsRtn[i] is 1 if boxes[i] touches the terrain
+//
+int OccupancyGrid::overlap(const vector<Box>& boxes, vector<int>& hitsRtn) const {
+	int count = 0;
+	hitsRtn.resize(boxes.size());
+	for (int i = 0; i < boxes.size(); i++) {
+		hitsRtn[i] = overlap(boxes[i]) ? 1 : 0;
+		count += hitsRtn[i];
+	}
+	return count;
+}
@@ -0,0 +1,44 @@
+//--------------------------------------------------------------
+//
+//  OccupancyGrid - sparse voxel occupancy of the terrain
+//
+//  Space is cut into cubic voxels of voxelSize.  Voxels are grouped
+//  in 4x4x4 bricks stored as one 64 bit mask each, and only bricks
+//  with something in them are kept (hash map keyed by brick coords).
+//  Built from the leaves of an Octree: leaf points and leaf faces
+//  mark the voxels they touch.
+//
+//  Point tests are a hash lookup, rays are marched voxel by voxel
+//  (Amanatides & Woo DDA) and box tests AND the brick masks.
+//
+#pragma once
+#include "ofMain.h"
+#include "Octree.h"
+#include <unordered_map>
+
+class OccupancyGrid {
+public:
+	void create(const Octree& octree, float voxelSize);
+	void update(const Octree& octree, const Box& region);
+	void clear();
+
+	bool occupied(const Vector3& p) const;
+	bool intersect(const Ray& ray, float t0, float t1, float& tRtn) const;
+	bool overlap(const Box& box) const;
+	int overlap(const vector<Box>& boxes, vector<int>& hitsRtn) const;
+
+	void setVoxel(int x, int y, int z);
+	void clearVoxel(int x, int y, int z);
+	bool getVoxel(int x, int y, int z) const;
+
+	float voxelSize = 1;
+	Vector3 origin = Vector3(0, 0, 0);
+	Box bounds;
+	unordered_map<uint64_t, uint64_t> bricks;
+
+private:
+	static uint64_t brickKey(int bx, int by, int bz);
+	static int bitIndex(int x, int y, int z) { return ((z & 3) << 4) | ((y & 3) << 2) | (x & 3); }
+	int voxelCoord(float v, int axis) const;
+	void markTriangle(const Vector3 v[3]);
+};
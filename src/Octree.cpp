@@ -11,6 +11,8 @@
 
 
 #include "Octree.h"
+#include "OctreeQuery.h"
+#include <float.h>
 
 
 
@@ -56,7 +58,7 @@ Box Octree::meshBounds(const ofMesh& mesh) {
 //                      inside the Box.  Return count of points found;
 //
 int Octree::getMeshPointsInBox(const ofMesh& mesh, const vector<int>& points,
-	Box& box, vector<int>& pointsRtn)
+	const Box& box, vector<int>& pointsRtn) const
 {
 	int count = 0;
 	for (int i = 0; i < points.size(); i++) {
@@ -73,7 +75,7 @@ int Octree::getMeshPointsInBox(const ofMesh& mesh, const vector<int>& points,
 //                      inside the Box.  Return count of faces found;
 //
 int Octree::getMeshFacesInBox(const ofMesh& mesh, const vector<int>& faces,
-	Box& box, vector<int>& facesRtn)
+	const Box& box, vector<int>& facesRtn) const
 {
 	int count = 0;
 	for (int i = 0; i < faces.size(); i++) {
@@ -96,7 +98,7 @@ int Octree::getMeshFacesInBox(const ofMesh& mesh, const vector<int>& faces,
 
 //  Subdivide a Box into eight(8) equal size boxes, return them in boxList;
 //
-void Octree::subDivideBox8(const Box& box, vector<Box>& boxList) {
+void Octree::subDivideBox8(const Box& box, vector<Box>& boxList) const {
 	Vector3 min = box.parameters[0];
 	Vector3 max = box.parameters[1];
 	Vector3 size = max - min;
@@ -132,6 +134,7 @@ void Octree::create(const ofMesh& geo, int numLevels) {
 	// initialize octree structure
 	//
 	mesh = geo;
+	maxLevels = numLevels;
 	int level = 0;
 	root.box = meshBounds(mesh);
 	if (!bUseFaces) {
@@ -148,6 +151,16 @@ void Octree::create(const ofMesh& geo, int numLevels) {
 	//
 	level++;
 	subdivide(mesh, root, numLevels, level);
+
+	// attach triangles to the leaves so queries can go past the leaf boxes
+	//
+	buildVertexFaces();
+	addLeafFaces(root);
+
+	// per node height / normal summaries for terrain analysis
+	//
+	buildVertexNormals();
+	computeAggregates(root);
 	float endTime = ofGetElapsedTimeMillis();
 	//cout << "CREATE END: " << endTime / 1000 << " SECONDS\n" << endl;
 }
@@ -178,6 +191,7 @@ void Octree::subdivide(const ofMesh& mesh, TreeNode& node, int numLevels, int le
 
 	for (int i = 0; i < boxList.size(); i++) {
 		node2.box = boxList[i];
+		node2.points.clear();
 
 		int count = getMeshPointsInBox(mesh, node.points, boxList[i], node2.points);
 
@@ -190,10 +204,102 @@ void Octree::subdivide(const ofMesh& mesh, TreeNode& node, int numLevels, int le
 	}
 }
 
+// number of triangles in the mesh (indexed or not)
+//
+int Octree::getNumFaces() const {
+	if (mesh.getNumIndices() > 0) return mesh.getNumIndices() / 3;
+	return mesh.getNumVertices() / 3;
+}
+
+// return the three corners of a triangle of the mesh
+//
+void Octree::getFaceVerts(int face, Vector3 v[3]) const {
+	for (int i = 0; i < 3; i++) {
+		int index = (mesh.getNumIndices() > 0) ? mesh.getIndex(face * 3 + i) : face * 3 + i;
+		glm::vec3 p = mesh.getVertex(index);
+		v[i] = Vector3(p.x, p.y, p.z);
+	}
+}
+
+// buildVertexFaces:  for every vertex, make a list of the faces that use it.
+//                    stored as one flat array with a start offset per vertex
+//
+void Octree::buildVertexFaces() {
+	int nVerts = mesh.getNumVertices();
+	int nFaces = getNumFaces();
+	bool indexed = mesh.getNumIndices() > 0;
+
+	vertFaceExtra.clear();
+	vertFaceStart.assign(nVerts + 1, 0);
+	for (int f = 0; f < nFaces; f++) {
+		for (int i = 0; i < 3; i++) {
+			int v = indexed ? mesh.getIndex(f * 3 + i) : f * 3 + i;
+			vertFaceStart[v + 1]++;
+		}
+	}
+	for (int i = 0; i < nVerts; i++) {
+		vertFaceStart[i + 1] += vertFaceStart[i];
+	}
+
+	vector<int> fill(vertFaceStart.begin(), vertFaceStart.end() - 1);
+	vertFaceList.resize(vertFaceStart[nVerts]);
+	for (int f = 0; f < nFaces; f++) {
+		for (int i = 0; i < 3; i++) {
+			int v = indexed ? mesh.getIndex(f * 3 + i) : f * 3 + i;
+			vertFaceList[fill[v]++] = f;
+		}
+	}
+}
+
+// appendVertexFaces:  add the faces using vertex index to facesRtn.  faces
+//                     removed since create() are -1 in the flat list, faces
+//                     added since are in vertFaceExtra
+//
+void Octree::appendVertexFaces(int index, vector<int>& facesRtn) const {
+	if (index + 1 < vertFaceStart.size()) {
+		for (int j = vertFaceStart[index]; j < vertFaceStart[index + 1]; j++) {
+			if (vertFaceList[j] >= 0) facesRtn.push_back(vertFaceList[j]);
+		}
+	}
+	unordered_map<int, vector<int> >::const_iterator it = vertFaceExtra.find(index);
+	if (it != vertFaceExtra.end()) {
+		facesRtn.insert(facesRtn.end(), it->second.begin(), it->second.end());
+	}
+}
+
+// addLeafFaces:  store in each leaf the (unique) faces that touch its points,
+//                and find the box around them (faceBounds) for every node.
+//                a face can stick out of the leaf box, and a ray can hit it
+//                where there is no leaf at all, so triangle queries walk the
+//                tree by faceBounds instead of box
+//
+void Octree::addLeafFaces(TreeNode& node) {
+	node.faceBounds = node.box;
+	if (node.children.size() > 0) {
+		for (int i = 0; i < node.children.size(); i++) {
+			addLeafFaces(node.children[i]);
+			node.faceBounds.expand(node.children[i].faceBounds);
+		}
+		return;
+	}
+	node.faces.clear();
+	for (int i = 0; i < node.points.size(); i++) {
+		appendVertexFaces(node.points[i], node.faces);
+	}
+	sort(node.faces.begin(), node.faces.end());
+	node.faces.erase(unique(node.faces.begin(), node.faces.end()), node.faces.end());
+
+	Vector3 v[3];
+	for (int i = 0; i < node.faces.size(); i++) {
+		getFaceVerts(node.faces[i], v);
+		for (int k = 0; k < 3; k++) node.faceBounds.expand(v[k]);
+	}
+}
+
 // Implement functions below for Homework project
 //
 
-bool Octree::intersect(const Ray& ray, const TreeNode& node, TreeNode& nodeRtn) {
+bool Octree::intersect(const Ray& ray, const TreeNode& node, TreeNode& nodeRtn) const {
 	float endTime;
 	bool intersects = false;
 	if (node.box.intersect(ray, 0, INFINITE)) {
@@ -218,21 +324,556 @@ bool Octree::intersect(const Ray& ray, const TreeNode& node, TreeNode& nodeRtn)
 	return intersects;
 }
 
-bool Octree::intersect(const Box& box, TreeNode& node, vector<Box>& boxListRtn) {
-	bool intersects = false;
-	if (node.box.overlap(box)) {
-		if (node.children.size() == 0) {
-			boxListRtn.push_back(node.box); intersects = true;
+// intersect (box):  boxes of the leaves below node that box overlaps
+//
+bool Octree::intersect(const Box& box, const TreeNode& node, vector<Box>& boxListRtn) const {
+	BoxLeavesQuery q(box, boxListRtn);
+	traverseOctree(node, q);
+	return q.found > 0;
+}
+
+// intersectSegment:  any-hit query for the segment a -> b.  unlike the ray
+//                    query above it stops at the first triangle that blocks
+//                    the segment and never looks past b
+//
+bool Octree::intersectSegment(const Vector3& a, const Vector3& b) const {
+	return intersectSegment(makeRay(a, b - a), 0, 1);
+}
+
+// the segment of ray with t in (t0, t1)
+//
+bool Octree::intersectSegment(const Ray& ray, float t0, float t1) const {
+	RayAnyQuery q(*this, ray, t0, t1);
+	traverseOctree(root, q);
+	return q.hit;
+}
+
+// intersectSegments:  batch of any-hit queries, hitsRtn[i] is 1 if segment
+//                     from[i] -> to[i] is blocked.  returns number blocked
+//
+int Octree::intersectSegments(const vector<Vector3>& from, const vector<Vector3>& to, vector<int>& hitsRtn) const {
+	int count = 0;
+	hitsRtn.resize(from.size());
+	for (int i = 0; i < from.size(); i++) {
+		hitsRtn[i] = intersectSegment(from[i], to[i]) ? 1 : 0;
+		count += hitsRtn[i];
+	}
+	return count;
+}
+
+// getPointsInFrustum:  indices of mesh points inside the frustum, each once.
+//                       (a point on a box boundary can be in two nodes)
+//
+int Octree::getPointsInFrustum(const Frustum& frustum, vector<int>& pointsRtn) const {
+	vector<int> found;
+	FrustumPointsQuery q(*this, frustum, found);
+	traverseOctree(root, q);
+
+	vector<char> seen(mesh.getNumVertices(), 0);
+	pointsRtn.clear();
+	for (int i = 0; i < found.size(); i++) {
+		if (seen[found[i]]) continue;
+		seen[found[i]] = 1;
+		pointsRtn.push_back(found[i]);
+	}
+	return pointsRtn.size();
+}
+
+// intersectClosest:  nearest triangle hit by the ray for t in (t0, t1).
+//                    returns distance in tRtn and face index in faceRtn
+//
+bool Octree::intersectClosest(const Ray& ray, float t0, float t1, float& tRtn, int& faceRtn) const {
+	RayClosestQuery q(*this, ray, t0, t1);
+	traverseOctree(root, q);
+	tRtn = q.t;
+	faceRtn = q.face;
+	return faceRtn >= 0;
+}
+
+// intersect (frustum):  return leaves inside or crossing the frustum
+//
+bool Octree::intersect(const Frustum& frustum, const TreeNode& node, vector<const TreeNode*>& leavesRtn) const {
+	Frustum::Classify c = frustum.classify(node.box);
+	if (c == Frustum::Outside) return false;
+
+	int count = leavesRtn.size();
+	if (c == Frustum::Inside || node.children.size() == 0) {
+		getLeaves(node, leavesRtn);
+	}
+	else {
+		for (int i = 0; i < node.children.size(); i++) {
+			intersect(frustum, node.children[i], leavesRtn);
 		}
-		else {
-			for (int i = 0; i < node.children.size(); i++) {
-				if (intersect(box, node.children[i], boxListRtn)) {
-					intersects = true;
-				}
+	}
+	return leavesRtn.size() > count;
+}
+
+// all leaves below node, no tests
+//
+void Octree::getLeaves(const TreeNode& node, vector<const TreeNode*>& leavesRtn) const {
+	if (node.children.size() == 0) {
+		leavesRtn.push_back(&node);
+		return;
+	}
+	for (int i = 0; i < node.children.size(); i++) {
+		getLeaves(node.children[i], leavesRtn);
+	}
+}
+
+// leaves whose faces reach into box
+//
+void Octree::getLeaves(const Box& box, const TreeNode& node, vector<const TreeNode*>& leavesRtn) const {
+	Box bounds = node.faceBounds;
+	if (!bounds.overlap(box)) return;
+	if (node.children.size() == 0) {
+		leavesRtn.push_back(&node);
+		return;
+	}
+	for (int i = 0; i < node.children.size(); i++) {
+		getLeaves(box, node.children[i], leavesRtn);
+	}
+}
+
+// pickVertex:  front to back search (see PickQuery).  children outside the
+//              cone are skipped, the rest are visited nearest first and
+//              once a vertex has been found, any box further away than it
+//              is skipped too
+//
+int Octree::pickVertex(const PickCone& cone) const {
+	PickQuery q(*this, cone);
+	traverseOctree(root, q);
+	return q.index;
+}
+
+// buildVertexNormals:  use the mesh normals if it has them, otherwise
+//                     average the normals of the faces around each vertex
+//
+void Octree::buildVertexNormals() {
+	int n = mesh.getNumVertices();
+	vertNormals.resize(n);
+	if (mesh.getNumNormals() == n) {
+		for (int i = 0; i < n; i++) {
+			glm::vec3 v = mesh.getNormal(i);
+			vertNormals[i] = Vector3(v.x, v.y, v.z);
+			vertNormals[i].normalize();
+		}
+		return;
+	}
+	for (int i = 0; i < n; i++) {
+		vertNormals[i] = faceNormal(i);
+	}
+}
+
+// faceNormal:  unit average of the (upward) normals of the faces around
+//              vertex index
+//
+Vector3 Octree::faceNormal(int index) const {
+	vector<int> faces;
+	appendVertexFaces(index, faces);
+	Vector3 sum = Vector3(0, 0, 0);
+	for (int j = 0; j < faces.size(); j++) {
+		Vector3 v[3];
+		getFaceVerts(faces[j], v);
+		Vector3 fn = (v[1] - v[0]) ^ (v[2] - v[0]);
+		if (fn.y() < 0) fn = -fn;		// terrain faces up
+		sum = sum + fn;
+	}
+	if (sum * sum == 0) sum = Vector3(0, 1, 0);
+	sum.normalize();
+	return sum;
+}
+
+// computeAggregates:  height range, normal sum and normal cone of a node.
+//                     leaves are computed from their points, other nodes
+//                     are merged from their children
+//
+void Octree::computeAggregates(TreeNode& node) {
+	for (int i = 0; i < node.children.size(); i++) {
+		computeAggregates(node.children[i]);
+	}
+	aggregateNode(node);
+}
+
+// aggregateNode:  the part of computeAggregates for one node, children must
+//                 already be up to date
+//
+void Octree::aggregateNode(TreeNode& node) {
+	node.normalSum = Vector3(0, 0, 0);
+	node.numNormals = 0;
+	node.minHeight = FLT_MAX;
+	node.maxHeight = -FLT_MAX;
+
+	if (node.children.size() == 0) {
+		for (int i = 0; i < node.points.size(); i++) {
+			float h = mesh.getVertex(node.points[i]).y;
+			node.minHeight = fminf(node.minHeight, h);
+			node.maxHeight = fmaxf(node.maxHeight, h);
+			node.normalSum = node.normalSum + vertNormals[node.points[i]];
+			node.numNormals++;
+		}
+	}
+	else {
+		for (int i = 0; i < node.children.size(); i++) {
+			const TreeNode& child = node.children[i];
+			node.minHeight = fminf(node.minHeight, child.minHeight);
+			node.maxHeight = fmaxf(node.maxHeight, child.maxHeight);
+			node.normalSum = node.normalSum + child.normalSum;
+			node.numNormals += child.numNormals;
+		}
+	}
+	if (node.numNormals == 0) return;
+
+	float len = node.normalSum.length();
+	node.roughness = 1 - len / node.numNormals;
+	node.meanNormal = (len > 0) ? node.normalSum / len : Vector3(0, 1, 0);
+
+	// normal cone:  exact for leaves, for other nodes a cone around all the
+	// children's cones
+	//
+	float angle = 0;
+	if (node.children.size() == 0) {
+		for (int i = 0; i < node.points.size(); i++) {
+			float c = fmaxf(-1, fminf(1, node.meanNormal * vertNormals[node.points[i]]));
+			angle = fmaxf(angle, acosf(c));
+		}
+	}
+	else {
+		for (int i = 0; i < node.children.size(); i++) {
+			const TreeNode& child = node.children[i];
+			float c = fmaxf(-1, fminf(1, node.meanNormal * child.meanNormal));
+			angle = fmaxf(angle, acosf(c) + child.coneAngle);
+		}
+	}
+	node.coneAngle = fminf(angle, PI);
+}
+
+int Octree::findLandingSites(const Vector3& center, float radius, float maxSlope, float maxRoughness,
+	vector<const TreeNode*>& sitesRtn) const
+{
+	sitesRtn.clear();
+	findLandingSites(root, center, radius, maxSlope * PI / 180, maxRoughness, sitesRtn);
+	return sitesRtn.size();
+}
+
+// findLandingSites:  (maxSlope in radians here)
+//      - skip a node outside the circle, or whose normals are all too steep
+//      - take a node whole if it is inside the circle, every normal is flat
+//        enough and it is smooth enough
+//      - otherwise split it (leaves are judged by their own average)
+//
+void Octree::findLandingSites(const TreeNode& node, const Vector3& center, float radius, float maxSlope,
+	float maxRoughness, vector<const TreeNode*>& sitesRtn) const
+{
+	const Vector3& min = node.box.parameters[0];
+	const Vector3& max = node.box.parameters[1];
+
+	// horizontal distance from center to nearest / furthest point of the box
+	//
+	float nx = fmaxf(fmaxf(min.x() - center.x(), center.x() - max.x()), 0);
+	float nz = fmaxf(fmaxf(min.z() - center.z(), center.z() - max.z()), 0);
+	if (nx * nx + nz * nz > radius * radius) return;
+	float fx = fmaxf(fabsf(min.x() - center.x()), fabsf(max.x() - center.x()));
+	float fz = fmaxf(fabsf(min.z() - center.z()), fabsf(max.z() - center.z()));
+	bool allInside = (fx * fx + fz * fz <= radius * radius);
+
+	float slope = acosf(fmaxf(-1, fminf(1, node.meanNormal.y())));
+	if (slope - node.coneAngle > maxSlope) return;
+
+	if (allInside && slope + node.coneAngle <= maxSlope && node.roughness <= maxRoughness) {
+		sitesRtn.push_back(&node);
+		return;
+	}
+	if (node.children.size() == 0) {
+		if (slope <= maxSlope && node.roughness <= maxRoughness) sitesRtn.push_back(&node);
+		return;
+	}
+	for (int i = 0; i < node.children.size(); i++) {
+		findLandingSites(node.children[i], center, radius, maxSlope, maxRoughness, sitesRtn);
+	}
+}
+
+//--------------------------------------------------------------
+// incremental updates
+//
+// a point belongs to every node whose box holds it (boxes are closed, so
+// a point on a split plane is in both children, same as in create()).
+// nodes with no points are dropped, nodes with one point are leaves.
+//
+
+// insertPoint:  add mesh vertex index (already in the mesh) to the tree
+//
+void Octree::insertPoint(int index) {
+	glm::vec3 v = mesh.getVertex(index);
+	Vector3 p = Vector3(v.x, v.y, v.z);
+	growRoot(p);
+	if (vertNormals.size() < mesh.getNumVertices()) {
+		vertNormals.resize(mesh.getNumVertices(), Vector3(0, 1, 0));
+	}
+	updateVertexNormal(index);
+	insertPoint(root, index, p, 1);
+}
+
+// removePoint:  take vertex index out of the tree.  it stays in the mesh
+//               (removing it would renumber the index), faces using it
+//               should be removed first
+//
+void Octree::removePoint(int index) {
+	glm::vec3 v = mesh.getVertex(index);
+	removePoint(root, index, Vector3(v.x, v.y, v.z));
+}
+
+// movePoint:  move vertex index to p in the mesh and the tree.  only the
+//             nodes below where the old and new positions part ways change
+//
+void Octree::movePoint(int index, const glm::vec3& p) {
+	glm::vec3 v = mesh.getVertex(index);
+	Vector3 from = Vector3(v.x, v.y, v.z);
+	Vector3 to = Vector3(p.x, p.y, p.z);
+	mesh.setVertex(index, p);
+	growRoot(to);
+	movePoint(root, index, from, to, 1);
+}
+
+// insertFace:  add a triangle to the mesh index, return its face number.
+//              the vertices should already be in the tree
+//
+int Octree::insertFace(int i0, int i1, int i2) {
+	mesh.addIndex(i0);
+	mesh.addIndex(i1);
+	mesh.addIndex(i2);
+	int face = getNumFaces() - 1;
+	vertFaceExtra[i0].push_back(face);
+	vertFaceExtra[i1].push_back(face);
+	vertFaceExtra[i2].push_back(face);
+	return face;
+}
+
+// removeFace:  drop a triangle from the vertex/face lists and collapse it
+//              in the mesh index (to keep the other face numbers), so it
+//              no longer draws or gets hit
+//
+void Octree::removeFace(int face) {
+	if (mesh.getNumIndices() == 0) return;
+	for (int i = 0; i < 3; i++) {
+		int v = mesh.getIndex(face * 3 + i);
+		if (v + 1 < vertFaceStart.size()) {
+			for (int j = vertFaceStart[v]; j < vertFaceStart[v + 1]; j++) {
+				if (vertFaceList[j] == face) vertFaceList[j] = -1;
 			}
 		}
+		unordered_map<int, vector<int> >::iterator it = vertFaceExtra.find(v);
+		if (it != vertFaceExtra.end()) {
+			it->second.erase(remove(it->second.begin(), it->second.end(), face), it->second.end());
+		}
 	}
-	return intersects;
+	int v0 = mesh.getIndex(face * 3);
+	mesh.setIndex(face * 3 + 1, v0);
+	mesh.setIndex(face * 3 + 2, v0);
+}
+
+void Octree::insertPoint(TreeNode& node, int index, const Vector3& p, int level) {
+	node.points.push_back(index);
+	if (node.children.size() == 0) {
+
+		// a leaf with two points splits, as in create().  the new leaves
+		// can hold points outside the edited region, so they are
+		// finished here rather than by refit()
+		//
+		if (node.points.size() >= 2) {
+			subdivide(mesh, node, maxLevels, level);
+			addLeafFaces(node);
+			computeAggregates(node);
+		}
+		return;
+	}
+	for (int i = 0; i < node.children.size(); i++) {
+		if (node.children[i].box.inside(p)) insertPoint(node.children[i], index, p, level + 1);
+	}
+	addOctants(node, index, p);
+}
+
+// addOctants:  make a one point leaf for each octant of node holding p
+//              that has no child yet
+//
+void Octree::addOctants(TreeNode& node, int index, const Vector3& p) {
+	vector<Box> boxList;
+	subDivideBox8(node.box, boxList);
+	for (int k = 0; k < boxList.size(); k++) {
+		if (!boxList[k].inside(p)) continue;
+		Vector3 c = boxList[k].center();
+		bool found = false;
+		for (int i = 0; i < node.children.size() && !found; i++) {
+			if (node.children[i].box.inside(c)) found = true;
+		}
+		if (found) continue;
+		TreeNode leaf;
+		leaf.box = boxList[k];
+		leaf.faceBounds = leaf.box;
+		leaf.points.push_back(index);
+		node.children.push_back(leaf);
+	}
+}
+
+void Octree::removePoint(TreeNode& node, int index, const Vector3& p) {
+	vector<int>::iterator it = find(node.points.begin(), node.points.end(), index);
+	if (it == node.points.end()) return;
+	node.points.erase(it);
+	for (int i = node.children.size() - 1; i >= 0; i--) {
+		if (!node.children[i].box.inside(p)) continue;
+		removePoint(node.children[i], index, p);
+		if (node.children[i].points.size() == 0) node.children.erase(node.children.begin() + i);
+	}
+
+	// merge:  one point left, this is a leaf again
+	//
+	if (node.points.size() <= 1) node.children.clear();
+}
+
+// movePoint:  node holds both from and to
+//
+void Octree::movePoint(TreeNode& node, int index, const Vector3& from, const Vector3& to, int level) {
+	for (int i = node.children.size() - 1; i >= 0; i--) {
+		TreeNode& child = node.children[i];
+		bool inFrom = child.box.inside(from);
+		bool inTo = child.box.inside(to);
+		if (inFrom && inTo) movePoint(child, index, from, to, level + 1);
+		else if (inFrom) {
+			removePoint(child, index, from);
+			if (child.points.size() == 0) node.children.erase(node.children.begin() + i);
+		}
+		else if (inTo) insertPoint(child, index, to, level + 1);
+	}
+	if (node.children.size() > 0) addOctants(node, index, to);
+}
+
+// growRoot:  double the root box toward p until it holds p.  the old root
+//            becomes one octant of the new one
+//
+void Octree::growRoot(const Vector3& p) {
+	while (!root.box.inside(p)) {
+		Vector3 lo = root.box.min();
+		Vector3 hi = root.box.max();
+		Vector3 size = hi - lo;
+		lo = Vector3(p.x() < lo.x() ? lo.x() - size.x() : lo.x(),
+			p.y() < lo.y() ? lo.y() - size.y() : lo.y(),
+			p.z() < lo.z() ? lo.z() - size.z() : lo.z());
+		hi = lo + size * 2;
+
+		TreeNode newRoot;
+		newRoot.box = Box(lo, hi);
+		newRoot.points = root.points;
+		newRoot.children.push_back(TreeNode());
+		swap(newRoot.children[0], root);
+		swap(root, newRoot);
+		maxLevels++;
+		root.faceBounds = root.box;
+		root.faceBounds.expand(root.children[0].faceBounds);
+		aggregateNode(root);
+	}
+}
+
+// editRegion:  box around points and every face using them, i.e. what
+//              refit() needs to look at after those points changed
+//
+Box Octree::editRegion(const vector<int>& points) const {
+	glm::vec3 p = mesh.getVertex(points.size() > 0 ? points[0] : 0);
+	Box region = Box(Vector3(p.x, p.y, p.z), Vector3(p.x, p.y, p.z));
+	vector<int> faces;
+	for (int i = 0; i < points.size(); i++) {
+		faces.clear();
+		appendVertexFaces(points[i], faces);
+		p = mesh.getVertex(points[i]);
+		region.expand(Vector3(p.x, p.y, p.z));
+		Vector3 v[3];
+		for (int j = 0; j < faces.size(); j++) {
+			getFaceVerts(faces[j], v);
+			for (int k = 0; k < 3; k++) region.expand(v[k]);
+		}
+	}
+	return region;
+}
+
+void Octree::refit(const Box& region) {
+	refit(root, region);
+}
+
+// refit:  redo leaf faces, face bounds and aggregates of the nodes that
+//         touch region (by box or by face bounds), bottom up
+//
+void Octree::refit(TreeNode& node, const Box& region) {
+	Box box = node.box;
+	Box bounds = node.faceBounds;
+	if (!box.overlap(region) && !bounds.overlap(region)) return;
+	if (node.children.size() == 0) addLeafFaces(node);
+	else {
+		node.faceBounds = node.box;
+		for (int i = 0; i < node.children.size(); i++) {
+			refit(node.children[i], region);
+			node.faceBounds.expand(node.children[i].faceBounds);
+		}
+	}
+	aggregateNode(node);
+}
+
+// updateVertexNormal:  recompute the normal of vertex index from its faces
+//                      (also in the mesh, if it has normals)
+//
+void Octree::updateVertexNormal(int index) {
+	Vector3 n = faceNormal(index);
+	vertNormals[index] = n;
+	if (mesh.getNumNormals() == mesh.getNumVertices()) {
+		mesh.setNormal(index, glm::vec3(n.x(), n.y(), n.z()));
+	}
+}
+
+int Octree::getPointsInBox(const Box& box, vector<int>& pointsRtn) const {
+	int count = pointsRtn.size();
+	BoxPointsQuery q(*this, box, pointsRtn);
+	traverseOctree(root, q);
+	sort(pointsRtn.begin() + count, pointsRtn.end());
+	pointsRtn.erase(unique(pointsRtn.begin() + count, pointsRtn.end()), pointsRtn.end());
+	return pointsRtn.size() - count;
+}
+
+// stampCrater:  press a bowl of the given radius and depth into the terrain
+//               at center (horizontally), with a raised rim around it.
+//               edits the mesh and the tree together and returns the box
+//               of terrain that changed
+//
+//               height change at horizontal distance d (in radii):
+//                   -depth * (1 - d^2)            inside the bowl
+//                   + rimHeight * exp(-(4(d-1))^2)   the rim, out to 1.5
+//
+Box Octree::stampCrater(const Vector3& center, float radius, float depth, float rimHeight) {
+	float reach = radius * 1.5f;
+	Vector3 lo = Vector3(center.x() - reach, root.box.min().y(), center.z() - reach);
+	Vector3 hi = Vector3(center.x() + reach, root.box.max().y(), center.z() + reach);
+	vector<int> points;
+	getPointsInBox(Box(lo, hi), points);
+	if (points.size() == 0) return Box(center, center);
+
+	Box region = editRegion(points);
+	vector<int> moved;
+	for (int i = 0; i < points.size(); i++) {
+		glm::vec3 p = mesh.getVertex(points[i]);
+		float dx = p.x - center.x();
+		float dz = p.z - center.z();
+		float d = sqrtf(dx * dx + dz * dz) / radius;
+		if (d >= 1.5f) continue;
+		float dy = rimHeight * expf(-(4 * (d - 1)) * (4 * (d - 1)));
+		if (d < 1) dy -= depth * (1 - d * d);
+		movePoint(points[i], glm::vec3(p.x, p.y + dy, p.z));
+		moved.push_back(points[i]);
+	}
+
+	// normals change for the moved points and their neighbors
+	//
+	region.expand(editRegion(moved));
+	vector<int> ring;
+	getPointsInBox(region, ring);
+	for (int i = 0; i < ring.size(); i++) updateVertexNormal(ring[i]);
+	refit(region);
+	return region;
 }
 
 void Octree::draw(TreeNode& node, int numLevels, int level) {
@@ -12,6 +12,9 @@
 #include "ofMain.h"
 #include "box.h"
 #include "ray.h"
+#include "Triangle.h"
+#include "Frustum.h"
+#include <unordered_map>
 
 
 
@@ -19,16 +22,100 @@ class TreeNode {
 public:
 	Box box;
 	vector<int> points;
+	vector<int> faces;		// leaf only: mesh faces that touch the leaf's points
+	Box faceBounds;			// box around all faces below this node (covers box)
 	vector<TreeNode> children;
+
+	// terrain aggregates over all points below this node, computed bottom
+	// up in Octree::computeAggregates()
+	//
+	float minHeight = 0;
+	float maxHeight = 0;
+	Vector3 normalSum = Vector3(0, 0, 0);	// sum of unit vertex normals
+	int numNormals = 0;
+	Vector3 meanNormal = Vector3(0, 1, 0);
+	float coneAngle = 0;		// every normal is within this angle (radians) of meanNormal
+	float roughness = 0;		// 1 - |average normal|, 0 for a plane
 };
 
+// Threads:  the const member functions only read the tree and mesh and
+// keep their state on the stack or in arguments, so any number of threads
+// may query one Octree at the same time.  Everything else (create, the
+// edits, refit, aggregates) needs the tree to itself; no query may run
+// while it changes.  Each thread should own its result vectors and
+// counters, see OctreeReader
+//
+// The segment, closest hit, frustum and box point, leaf box and pick
+// queries are thin wrappers over traverseOctree() and the policies in
+// OctreeQuery.h
+//
 class Octree {
 public:
 
 	void create(const ofMesh& mesh, int numLevels);
 	void subdivide(const ofMesh& mesh, TreeNode& node, int numLevels, int level);
-	bool intersect(const Ray&, const TreeNode& node, TreeNode& nodeRtn);
-	bool intersect(const Box&, TreeNode& node, vector<Box>& boxListRtn);
+	bool intersect(const Ray&, const TreeNode& node, TreeNode& nodeRtn) const;
+	bool intersect(const Box&, const TreeNode& node, vector<Box>& boxListRtn) const;
+
+	// any-hit (line of sight) queries:  true if the segment a -> b is blocked
+	//
+	bool intersectSegment(const Vector3& a, const Vector3& b) const;
+	bool intersectSegment(const Ray& ray, float t0, float t1) const;
+	int intersectSegments(const vector<Vector3>& from, const vector<Vector3>& to, vector<int>& hitsRtn) const;
+
+	// closest triangle hit along a ray
+	//
+	bool intersectClosest(const Ray& ray, float t0, float t1, float& tRtn, int& faceRtn) const;
+
+	// region queries:  points or leaves inside a frustum (view or screen
+	// rectangle, see Frustum).  subtrees fully inside are taken whole
+	//
+	int getPointsInFrustum(const Frustum& frustum, vector<int>& pointsRtn) const;
+	bool intersect(const Frustum& frustum, const TreeNode& node, vector<const TreeNode*>& leavesRtn) const;
+	void getLeaves(const TreeNode& node, vector<const TreeNode*>& leavesRtn) const;
+	void getLeaves(const Box& box, const TreeNode& node, vector<const TreeNode*>& leavesRtn) const;
+
+	// screen space picking:  closest vertex to the eye within the pick cone's
+	// pixel radius.  returns vertex index or -1
+	//
+	int pickVertex(const PickCone& cone) const;
+
+	// terrain aggregates and landing site search:  regions within radius
+	// (horizontally) of center whose slope is at most maxSlope (degrees) and
+	// roughness at most maxRoughness
+	//
+	void buildVertexNormals();
+	void computeAggregates(TreeNode& node);
+	void aggregateNode(TreeNode& node);
+	int findLandingSites(const Vector3& center, float radius, float maxSlope, float maxRoughness,
+		vector<const TreeNode*>& sitesRtn) const;
+	void findLandingSites(const TreeNode& node, const Vector3& center, float radius, float maxSlope,
+		float maxRoughness, vector<const TreeNode*>& sitesRtn) const;
+	// incremental updates for deformable terrain.  points are mesh vertex
+	// indices, faces are triangles of the mesh index.  these only fix up
+	// which nodes hold a point (splitting and merging nodes locally);
+	// after a batch of edits call refit() with a box around everything
+	// that changed (see editRegion()) to redo leaf faces, face bounds and
+	// aggregates there.  stampCrater() does all of it
+	//
+	void insertPoint(int index);
+	void removePoint(int index);
+	void movePoint(int index, const glm::vec3& p);
+	int insertFace(int i0, int i1, int i2);
+	void removeFace(int face);
+	void refit(const Box& region);
+	Box editRegion(const vector<int>& points) const;
+	Box stampCrater(const Vector3& center, float radius, float depth, float rimHeight);
+
+	void insertPoint(TreeNode& node, int index, const Vector3& p, int level);
+	void removePoint(TreeNode& node, int index, const Vector3& p);
+	void movePoint(TreeNode& node, int index, const Vector3& from, const Vector3& to, int level);
+	void addOctants(TreeNode& node, int index, const Vector3& p);
+	void growRoot(const Vector3& p);
+	void refit(TreeNode& node, const Box& region);
+	int getPointsInBox(const Box& box, vector<int>& pointsRtn) const;
+	void updateVertexNormal(int index);
+
 	void draw(TreeNode& node, int numLevels, int level);
 	void draw(int numLevels, int level) {
 		draw(root, numLevels, level);
@@ -36,16 +123,30 @@ public:
 	void drawLeafNodes(TreeNode& node);
 	static void drawBox(const Box& box);
 	static Box meshBounds(const ofMesh&);
-	int getMeshPointsInBox(const ofMesh& mesh, const vector<int>& points, Box& box, vector<int>& pointsRtn);
-	int getMeshFacesInBox(const ofMesh& mesh, const vector<int>& faces, Box& box, vector<int>& facesRtn);
-	void subDivideBox8(const Box& b, vector<Box>& boxList);
+	int getMeshPointsInBox(const ofMesh& mesh, const vector<int>& points, const Box& box, vector<int>& pointsRtn) const;
+	int getMeshFacesInBox(const ofMesh& mesh, const vector<int>& faces, const Box& box, vector<int>& facesRtn) const;
+	void subDivideBox8(const Box& b, vector<Box>& boxList) const;
+
+	// triangle (face) access for narrow phase tests
+	//
+	int getNumFaces() const;
+	void getFaceVerts(int face, Vector3 v[3]) const;
+	void buildVertexFaces();
+	void appendVertexFaces(int index, vector<int>& facesRtn) const;
+	void addLeafFaces(TreeNode& node);
+	Vector3 faceNormal(int index) const;
 
 	ofMesh mesh;
 	TreeNode root;
 	bool bUseFaces = false;
+	int maxLevels = 20;		// numLevels given to create(), +1 each time the root grows
 
-	// debug;
+	// vertex to face adjacency (compressed: faces of vertex i are
+	// vertFaceList[vertFaceStart[i]] .. vertFaceList[vertFaceStart[i+1] - 1])
 	//
-	int strayVerts = 0;
-	int numLeaf = 0;
+	vector<int> vertFaceStart;
+	vector<int> vertFaceList;			// -1 for faces removed since create()
+	unordered_map<int, vector<int> > vertFaceExtra;	// faces added since create()
+
+	vector<Vector3> vertNormals;	// unit, from the mesh or averaged from faces
 };
\ No newline at end of file
@@ -0,0 +1,1333 @@
+//--------------------------------------------------------------
+//
+//  OctreeBench - timing of octree queries
+//
+
+
+#include "OctreeBench.h"
+#include "OccupancyGrid.h"
+#include "AABBTree.h"
+#include "InstancedScene.h"
+#include "PointOctree.h"
+#include "OctreeReader.h"
+#include "QueryService.h"
+#include "Terrain.h"
+#include "PagedOctree.h"
+#include "StreamingOctree.h"
+#include "TerrainTiles.h"
+#include "QueryServer.h"
+#include "Numa.h"
+#include "LanderBench.h"
+#include <float.h>
+#include <thread>
+#include <random>
+#include <filesystem>
+#ifndef _WIN32
+#include <sys/resource.h>
+#endif
+
+// random point inside box
+//
+static Vector3 randomPoint(const Box& box) {
+	return Vector3(ofRandom(box.parameters[0].x(), box.parameters[1].x()),
+		ofRandom(box.parameters[0].y(), box.parameters[1].y()),
+		ofRandom(box.parameters[0].z(), box.parameters[1].z()));
+}
+
+// makeTestTerrain:  gridSize x gridSize vertex rolling height field, size
+//                   wide, centered on the origin
+//
+ofMesh makeTestTerrain(int gridSize, float size) {
+	ofMesh mesh;
+	for (int z = 0; z < gridSize; z++) {
+		for (int x = 0; x < gridSize; x++) {
+			float fx = x * size / (gridSize - 1) - size / 2;
+			float fz = z * size / (gridSize - 1) - size / 2;
+			float h = sin(fx * .3) * cos(fz * .2) * 2 + sin(fx * 1.7 + fz * 2.3) * .3;
+			mesh.addVertex(glm::vec3(fx, h, fz));
+		}
+	}
+	for (int z = 0; z < gridSize - 1; z++) {
+		for (int x = 0; x < gridSize - 1; x++) {
+			int i = z * gridSize + x;
+			mesh.addIndex(i);
+			mesh.addIndex(i + gridSize);
+			mesh.addIndex(i + 1);
+			mesh.addIndex(i + 1);
+			mesh.addIndex(i + gridSize);
+			mesh.addIndex(i + gridSize + 1);
+		}
+	}
+	return mesh;
+}
+
+// runOctreeBenchmarks:  the quick ones, on the terrain loaded in the app
+//                       ('u').  the rest take a while, see runAllBenchmarks()
+//
+void runOctreeBenchmarks(Octree& octree) {
+	cout << "---- octree benchmarks ----" << endl;
+	benchSegmentQueries(octree, 10000);
+	benchOccupancy(octree, 100000);
+	cout << "---------------------------" << endl;
+}
+
+// runAllBenchmarks:  every benchmark, on a generated terrain (--bench on
+//                    the command line, a minute or so)
+//
+void runAllBenchmarks() {
+	Terrain terrain;
+	terrain.build(vector<ofMesh>(1, makeTestTerrain(256, 100)));
+	cout << "---- all benchmarks ----" << endl;
+	benchSegmentQueries(terrain.octree, 10000);
+	benchPicking(200);
+	benchOccupancy(terrain.octree, 100000);
+	for (int n = 100; n <= 6400; n *= 4) benchBroadPhase(n, 60);
+	benchInstancing(200, 10000);
+	benchPointOctrees(160, 20000);
+	benchTraversal(10000);
+	benchConcurrentQueries(20000);
+	benchQueryService(1000);
+	benchTerrainReload(256);
+	benchPagedOctree(384, 5000);
+	benchStreamingBuild(4000000, 100);
+	benchTerrainTiles(12, 64);
+	benchNumaReplicas(20000);
+	benchLanderSimulation(20000);
+	benchSimulationThread(300, 4000);
+	benchJobScheduler(200);
+	cout << "------------------------" << endl;
+}
+
+// benchSegmentQueries:  any-hit segment queries against the full ray
+//                       traversal (Octree::intersect(Ray...)) on the same
+//                       random segments
+//
+void benchSegmentQueries(Octree& octree, int n) {
+	vector<Vector3> from, to;
+	for (int i = 0; i < n; i++) {
+		from.push_back(randomPoint(octree.root.box));
+		to.push_back(randomPoint(octree.root.box));
+	}
+
+	vector<int> hits;
+	uint64_t t1 = ofGetElapsedTimeMicros();
+	int blocked = octree.intersectSegments(from, to, hits);
+	uint64_t t2 = ofGetElapsedTimeMicros();
+
+	int rayHits = 0;
+	for (int i = 0; i < n; i++) {
+		Vector3 dir = to[i] - from[i];
+		dir.normalize();
+		TreeNode node;
+		if (octree.intersect(Ray(from[i], dir), octree.root, node)) rayHits++;
+	}
+	uint64_t t3 = ofGetElapsedTimeMicros();
+
+	cout << "segment any-hit: " << n << " queries, " << blocked << " blocked, "
+		<< (t2 - t1) << " microsec" << endl;
+	cout << "full ray traversal: " << n << " queries, " << rayHits << " leaf hits, "
+		<< (t3 - t2) << " microsec" << endl;
+}
+
+// benchPicking:  octree cone pick against the brute force scan (project
+//                every vertex, keep the closest within the pixel radius)
+//                for growing terrain sizes.  n picks per size
+//
+void benchPicking(int n) {
+	ofRectangle viewport = ofRectangle(0, 0, 1024, 768);
+	float radius = 4;
+
+	for (int gridSize = 64; gridSize <= 512; gridSize *= 2) {
+		Octree octree;
+		octree.create(makeTestTerrain(gridSize, 100), 20);
+		const ofMesh& mesh = octree.mesh;
+
+		glm::vec3 eye = glm::vec3(0, 40, 60);
+		glm::mat4 viewProjection = glm::perspective(glm::radians(80.0f), viewport.width / viewport.height, .1f, 1000.0f) *
+			glm::lookAt(eye, glm::vec3(0, 0, 0), glm::vec3(0, 1, 0));
+
+		vector<PickCone> cones;
+		for (int i = 0; i < n; i++) {
+			cones.push_back(PickCone(viewProjection, viewport, Vector3(eye.x, eye.y, eye.z),
+				ofRandom(viewport.width), ofRandom(viewport.height), radius));
+		}
+
+		vector<int> octreePicks;
+		uint64_t t1 = ofGetElapsedTimeMicros();
+		for (int i = 0; i < n; i++) {
+			octreePicks.push_back(octree.pickVertex(cones[i]));
+		}
+		uint64_t t2 = ofGetElapsedTimeMicros();
+
+		vector<int> brutePicks;
+		for (int i = 0; i < n; i++) {
+			int best = -1;
+			float bestDist = 0;
+			for (int j = 0; j < mesh.getNumVertices(); j++) {
+				glm::vec3 v = mesh.getVertex(j);
+				Vector3 p = Vector3(v.x, v.y, v.z);
+				if (!cones[i].inside(p)) continue;
+				float d = (p - cones[i].eye).length();
+				if (best == -1 || d < bestDist) {
+					best = j;
+					bestDist = d;
+				}
+			}
+			brutePicks.push_back(best);
+		}
+		uint64_t t3 = ofGetElapsedTimeMicros();
+
+		// compare by distance, two vertices at the same distance are both right
+		//
+		int mismatch = 0;
+		for (int i = 0; i < n; i++) {
+			if (octreePicks[i] == brutePicks[i]) continue;
+			if (octreePicks[i] < 0 || brutePicks[i] < 0) {
+				mismatch++;
+				continue;
+			}
+			glm::vec3 a = mesh.getVertex(octreePicks[i]);
+			glm::vec3 b = mesh.getVertex(brutePicks[i]);
+			if (fabs(glm::length(a - eye) - glm::length(b - eye)) > 1e-4) mismatch++;
+		}
+
+		cout << "pick " << mesh.getNumVertices() << " verts: octree " << (t2 - t1) / (float)n
+			<< " microsec/pick, brute force " << (t3 - t2) / (float)n << " microsec/pick, "
+			<< mismatch << " mismatches" << endl;
+	}
+}
+
+// benchOccupancy:  occupancy grid point / box / ray tests against the
+//                  octree box descent and segment query
+//
+void benchOccupancy(Octree& octree, int n) {
+	Vector3 size = octree.root.box.parameters[1] - octree.root.box.parameters[0];
+	float voxelSize = fmaxf(size.x(), fmaxf(size.y(), size.z())) / 512;
+	OccupancyGrid grid;
+	grid.create(octree, voxelSize);
+
+	vector<Box> boxes;
+	for (int i = 0; i < n; i++) {
+		Vector3 p = randomPoint(octree.root.box);
+		boxes.push_back(Box(p, p + Vector3(voxelSize, voxelSize, voxelSize) * 2));
+	}
+
+	uint64_t t1 = ofGetElapsedTimeMicros();
+	int pointHits = 0;
+	for (int i = 0; i < n; i++) {
+		if (grid.occupied(boxes[i].parameters[0])) pointHits++;
+	}
+	uint64_t t2 = ofGetElapsedTimeMicros();
+	vector<int> hits;
+	int gridHits = grid.overlap(boxes, hits);
+	uint64_t t3 = ofGetElapsedTimeMicros();
+	int treeHits = 0;
+	for (int i = 0; i < n; i++) {
+		vector<Box> boxList;
+		if (octree.intersect(boxes[i], octree.root, boxList)) treeHits++;
+	}
+	uint64_t t4 = ofGetElapsedTimeMicros();
+
+	cout << "occupancy point test: " << n << " queries, " << pointHits << " hits, " << (t2 - t1) << " microsec" << endl;
+	cout << "occupancy box test: " << n << " queries, " << gridHits << " hits, " << (t3 - t2) << " microsec" << endl;
+	cout << "octree box test: " << n << " queries, " << treeHits << " hits, " << (t4 - t3) << " microsec" << endl;
+
+	int m = n / 10;
+	vector<Vector3> from, to;
+	for (int i = 0; i < m; i++) {
+		from.push_back(randomPoint(octree.root.box));
+		to.push_back(randomPoint(octree.root.box));
+	}
+	uint64_t t5 = ofGetElapsedTimeMicros();
+	int marchHits = 0;
+	for (int i = 0; i < m; i++) {
+		float t;
+		if (grid.intersect(Ray(from[i], to[i] - from[i]), 0, 1, t)) marchHits++;
+	}
+	uint64_t t6 = ofGetElapsedTimeMicros();
+	vector<int> segHits;
+	int blocked = octree.intersectSegments(from, to, segHits);
+	uint64_t t7 = ofGetElapsedTimeMicros();
+
+	cout << "occupancy ray march: " << m << " segments, " << marchHits << " blocked, " << (t6 - t5) << " microsec" << endl;
+	cout << "octree segment any-hit: " << m << " segments, " << blocked << " blocked, " << (t7 - t6) << " microsec" << endl;
+}
+
+// benchBroadPhase:  numBodies unit boxes drifting around a box sized so
+//                   about 4 bodies overlap each one.  times the dynamic
+//                   tree (move + pair update) per frame against testing
+//                   every pair, and checks both find the same pair count
+//                   on the last frame (all pairs, brute force on fat boxes)
+//
+void benchBroadPhase(int numBodies, int numFrames) {
+	float size = powf(numBodies * 8.0f, 1.0f / 3);
+	Box world = Box(Vector3(0, 0, 0), Vector3(size, size, size));
+	vector<Vector3> pos, vel;
+	BroadPhase broad;
+	vector<int> proxies;
+	Vector3 half = Vector3(.5, .5, .5);
+	for (int i = 0; i < numBodies; i++) {
+		pos.push_back(randomPoint(world));
+		vel.push_back(Vector3(ofRandom(-1, 1), ofRandom(-1, 1), ofRandom(-1, 1)) * .05);
+		proxies.push_back(broad.addBody(Box(pos[i] - half, pos[i] + half), i));
+	}
+	broad.findPairs();
+	broad.endFrame();
+
+	uint64_t t1 = ofGetElapsedTimeMicros();
+	for (int f = 0; f < numFrames; f++) {
+		for (int i = 0; i < numBodies; i++) {
+			pos[i] = pos[i] + vel[i];
+			for (int k = 0; k < 3; k++) {
+				if (pos[i][k] < 0 || pos[i][k] > size) vel[i] = vel[i] * -1;
+			}
+			broad.moveBody(proxies[i], Box(pos[i] - half, pos[i] + half), vel[i]);
+		}
+		broad.findPairs();
+		broad.endFrame();
+	}
+	uint64_t t2 = ofGetElapsedTimeMicros();
+
+	int brutePairs = 0;
+	uint64_t t3 = ofGetElapsedTimeMicros();
+	if (numBodies <= 1600) {
+		for (int f = 0; f < numFrames; f++) {
+			brutePairs = 0;
+			for (int i = 0; i < numBodies; i++) {
+				Box a = broad.tree.getFatBox(proxies[i]);
+				for (int j = i + 1; j < numBodies; j++) {
+					if (a.overlap(broad.tree.getFatBox(proxies[j]))) brutePairs++;
+				}
+			}
+		}
+	}
+	uint64_t t4 = ofGetElapsedTimeMicros();
+
+	cout << "broad phase: " << numBodies << " bodies, tree height " << broad.tree.getHeight()
+		<< ", " << broad.pairs.size() << " pairs, " << (t2 - t1) / numFrames << " microsec/frame";
+	if (numBodies <= 1600) {
+		cout << " (all pairs: " << brutePairs << " pairs, " << (t4 - t3) / numFrames << " microsec/frame)";
+	}
+	cout << endl;
+}
+
+// benchInstancing:  numInstances copies of a small mesh scattered over the
+//                   ground, as a two level InstancedScene and baked into
+//                   one mesh with one octree.  compares build, n rays
+//                   straight down (hits must agree) and moving a tenth
+//                   of the instances
+//
+void benchInstancing(int numInstances, int n) {
+	ofMesh rock = makeTestTerrain(24, 4);
+	float spread = sqrtf(numInstances) * 6;
+	vector<glm::mat4> transforms;
+	for (int i = 0; i < numInstances; i++) {
+		glm::mat4 m = glm::translate(glm::mat4(1.0), glm::vec3(ofRandom(-spread, spread) / 2, 0, ofRandom(-spread, spread) / 2));
+		m = glm::rotate(m, ofRandom(0, TWO_PI), glm::vec3(0, 1, 0));
+		transforms.push_back(glm::scale(m, glm::vec3(ofRandom(.5, 1.5))));
+	}
+
+	uint64_t t1 = ofGetElapsedTimeMicros();
+	InstancedScene scene;
+	int mesh = scene.addMesh(rock);
+	for (int i = 0; i < numInstances; i++) scene.addInstance(mesh, transforms[i]);
+	uint64_t t2 = ofGetElapsedTimeMicros();
+
+	ofMesh baked;
+	for (int i = 0; i < numInstances; i++) {
+		int base = baked.getNumVertices();
+		for (int v = 0; v < rock.getNumVertices(); v++) {
+			glm::vec4 p = transforms[i] * glm::vec4(rock.getVertex(v), 1);
+			baked.addVertex(glm::vec3(p.x, p.y, p.z));
+		}
+		for (int k = 0; k < rock.getNumIndices(); k++) baked.addIndex(base + rock.getIndex(k));
+	}
+	Octree octree;
+	octree.create(baked, 20);
+	uint64_t t3 = ofGetElapsedTimeMicros();
+
+	vector<Ray> rays;
+	for (int i = 0; i < n; i++) {
+		rays.push_back(makeRay(Vector3(ofRandom(-spread, spread) / 2, 20, ofRandom(-spread, spread) / 2), Vector3(0, -1, 0)));
+	}
+	int sceneHits = 0, bakedHits = 0, mismatches = 0;
+	vector<float> sceneT(n, -1);
+	uint64_t t4 = ofGetElapsedTimeMicros();
+	for (int i = 0; i < n; i++) {
+		InstanceHit hit;
+		if (scene.intersectRay(rays[i], 0, FLT_MAX, hit)) {
+			sceneHits++;
+			sceneT[i] = hit.t;
+		}
+	}
+	uint64_t t5 = ofGetElapsedTimeMicros();
+	for (int i = 0; i < n; i++) {
+		float t;
+		int face;
+		bool hit = octree.intersectClosest(rays[i], 0, FLT_MAX, t, face);
+		if (hit) bakedHits++;
+		if (hit != (sceneT[i] >= 0) || (hit && fabsf(t - sceneT[i]) > 1e-3f)) mismatches++;
+	}
+	uint64_t t6 = ofGetElapsedTimeMicros();
+
+	int numMoved = numInstances / 10;
+	for (int i = 0; i < numMoved; i++) {
+		scene.moveInstance(i, glm::translate(transforms[i], glm::vec3(.5, 0, 0)));
+	}
+	uint64_t t7 = ofGetElapsedTimeMicros();
+
+	cout << "instancing: " << numInstances << " instances, " << baked.getNumIndices() / 3 << " faces baked" << endl;
+	cout << "  build:  two level " << (t2 - t1) / 1000.0 << " ms, baked " << (t3 - t2) / 1000.0 << " ms" << endl;
+	cout << "  rays:   two level " << (t5 - t4) << " microsec (" << sceneHits << " hits), baked "
+		<< (t6 - t5) << " microsec (" << bakedHits << " hits), " << mismatches << " mismatches" << endl;
+	cout << "  move " << numMoved << " instances:  " << (t7 - t6) << " microsec (baked needs a rebuild)" << endl;
+}
+
+// benchPointOctree:  one PointOctree configuration over pts (given in
+//                    double).  times build, nearest and box queries and
+//                    counts nearest answers that differ from brute force
+//                    (truth, computed in double)
+//
+template <class Tree, class Vec>
+static void benchPointOctree(const char* name, const vector<Vector3d>& pts, const vector<Vector3d>& queries,
+	const vector<int>& truth, double radius)
+{
+	vector<Vec> points;
+	for (int i = 0; i < pts.size(); i++) points.push_back(Vec(pts[i]));
+	vector<Vec> q;
+	for (int i = 0; i < queries.size(); i++) q.push_back(Vec(queries[i]));
+
+	Tree tree;
+	uint64_t t1 = ofGetElapsedTimeMicros();
+	tree.create(points);
+	uint64_t t2 = ofGetElapsedTimeMicros();
+	int wrong = 0;
+	for (int i = 0; i < q.size(); i++) {
+		if (tree.nearest(q[i], radius) != truth[i]) wrong++;
+	}
+	uint64_t t3 = ofGetElapsedTimeMicros();
+	Vec h = Vec(radius, radius, radius);
+	decltype(tree.order) found;
+	for (int i = 0; i < q.size(); i++) {
+		found.clear();
+		tree.getPointsInBox(q[i] - h, q[i] + h, found);
+	}
+	uint64_t t4 = ofGetElapsedTimeMicros();
+
+	cout << "  " << name << ":  build " << (t2 - t1) / 1000.0 << " ms, " << tree.getNumNodes() << " nodes, depth "
+		<< tree.getDepth() << ", nearest " << (t3 - t2) << " microsec (" << wrong << " wrong), box "
+		<< (t4 - t3) << " microsec" << endl;
+}
+
+// benchPointOctrees:  the PointOctree configurations on the vertices of
+//                     a gridSize x gridSize terrain, once near the origin
+//                     and once moved far away (offset), where float can no
+//                     longer tell neighbouring vertices apart.  n queries
+//                     near the surface
+//
+void benchPointOctrees(int gridSize, int n) {
+	ofMesh terrain = makeTestTerrain(gridSize, gridSize);
+	double offsets[2] = { 0, 4.0e6 };
+	for (int o = 0; o < 2; o++) {
+		Vector3d offset = Vector3d(offsets[o], 0, offsets[o]);
+		vector<Vector3d> pts;
+		for (int i = 0; i < terrain.getNumVertices(); i++) {
+			glm::vec3 v = terrain.getVertex(i);
+			pts.push_back(Vector3d(v.x, v.y, v.z) + offset);
+		}
+		vector<Vector3d> queries;
+		for (int i = 0; i < n; i++) {
+			queries.push_back(pts[(int)ofRandom(0, pts.size() - 1)] +
+				Vector3d(ofRandom(-.3, .3), ofRandom(-.3, .3), ofRandom(-.3, .3)));
+		}
+
+		double radius = 1;
+		vector<int> truth(n, -1);
+		for (int i = 0; i < n; i++) {
+			double best = radius * radius;
+			for (int j = 0; j < pts.size(); j++) {
+				Vector3d d = pts[j] - queries[i];
+				double d2 = d * d;
+				if (d2 < best) {
+					best = d2;
+					truth[i] = j;
+				}
+			}
+		}
+
+		cout << "point octree: " << pts.size() << " points, offset " << offsets[o] << ", " << n << " queries" << endl;
+		benchPointOctree<PointOctree<float, Vector3, uint32_t, 1>, Vector3>("float  leaf 1 ", pts, queries, truth, radius);
+		benchPointOctree<PointOctreef, Vector3>("float  leaf 8 ", pts, queries, truth, radius);
+		benchPointOctree<PointOctree<float, Vector3, uint32_t, 32>, Vector3>("float  leaf 32", pts, queries, truth, radius);
+		if (pts.size() < 32768) {
+			benchPointOctree<PointOctree<float, Vector3, uint16_t, 8>, Vector3>("float  16 bit ", pts, queries, truth, radius);
+		}
+		benchPointOctree<PointOctreed, Vector3d>("double leaf 8 ", pts, queries, truth, radius);
+		benchPointOctree<PointOctree<double, Vector3d, uint32_t, 32>, Vector3d>("double leaf 32", pts, queries, truth, radius);
+	}
+}
+
+// sameSet:  a and b hold the same indices (ignoring order and duplicates)
+//
+static bool sameSet(vector<int> a, vector<int> b) {
+	sort(a.begin(), a.end());
+	a.erase(unique(a.begin(), a.end()), a.end());
+	sort(b.begin(), b.end());
+	b.erase(unique(b.begin(), b.end()), b.end());
+	return a == b;
+}
+
+// benchTraversal:  the traverseOctree() policies (which Octree's own
+//                  queries wrap) against brute force on a test terrain, n
+//                  queries each (brute force on n / 10).  results must
+//                  agree
+//
+void benchTraversal(int n) {
+	Octree octree;
+	octree.create(makeTestTerrain(128, 100), 20);
+	Box bounds = octree.root.box;
+
+	vector<Ray> rays;
+	vector<Box> boxes;
+	vector<Vector3> centers;
+	for (int i = 0; i < n; i++) {
+		Vector3 dir = randomPoint(bounds) - Vector3(0, 20, 0);
+		dir.normalize();
+		rays.push_back(makeRay(Vector3(ofRandom(-50, 50), 20, ofRandom(-50, 50)), dir));
+		Vector3 c = randomPoint(bounds);
+		boxes.push_back(Box(c - Vector3(3, 3, 3), c + Vector3(3, 3, 3)));
+		centers.push_back(c);
+	}
+	int numFaces = octree.getNumFaces();
+	Vector3 v[3];
+
+	int mismatches = 0;
+	uint64_t t1 = ofGetElapsedTimeMicros();
+	vector<float> policyT(n);
+	for (int i = 0; i < n; i++) {
+		RayClosestQuery q(octree, rays[i], 0, FLT_MAX);
+		traverseOctree(octree.root, q);
+		policyT[i] = q.t;
+	}
+	uint64_t t2 = ofGetElapsedTimeMicros();
+	for (int i = 0; i < n / 10; i++) {
+		float best = FLT_MAX, t;
+		for (int f = 0; f < numFaces; f++) {
+			octree.getFaceVerts(f, v);
+			if (rayTriangle(rays[i].origin, rays[i].direction, v, 0, best, t)) best = t;
+		}
+		if (best != policyT[i]) mismatches++;
+	}
+	uint64_t t3 = ofGetElapsedTimeMicros();
+	cout << "traversal policies: " << n << " queries each" << endl;
+	cout << "  closest ray:  policy " << (t2 - t1) << " microsec, brute force (" << n / 10 << ") " << (t3 - t2)
+		<< " microsec, " << mismatches << " mismatches" << endl;
+
+	mismatches = 0;
+	vector<bool> policyHit(n);
+	t1 = ofGetElapsedTimeMicros();
+	for (int i = 0; i < n; i++) {
+		RayAnyQuery q(octree, rays[i], 0, 30);
+		traverseOctree(octree.root, q);
+		policyHit[i] = q.hit;
+	}
+	t2 = ofGetElapsedTimeMicros();
+	for (int i = 0; i < n / 10; i++) {
+		bool hit = false;
+		float t;
+		for (int f = 0; f < numFaces && !hit; f++) {
+			octree.getFaceVerts(f, v);
+			hit = rayTriangle(rays[i].origin, rays[i].direction, v, 0, 30, t);
+		}
+		if (hit != policyHit[i]) mismatches++;
+	}
+	t3 = ofGetElapsedTimeMicros();
+	cout << "  segment:      policy " << (t2 - t1) << " microsec, brute force (" << n / 10 << ") " << (t3 - t2)
+		<< " microsec, " << mismatches << " mismatches" << endl;
+
+	mismatches = 0;
+	vector<vector<int> > policyPoints(n);
+	t1 = ofGetElapsedTimeMicros();
+	for (int i = 0; i < n; i++) {
+		BoxPointsQuery q(octree, boxes[i], policyPoints[i]);
+		traverseOctree(octree.root, q);
+	}
+	t2 = ofGetElapsedTimeMicros();
+	vector<int> points;
+	for (int i = 0; i < n / 10; i++) {
+		points.clear();
+		for (int j = 0; j < octree.mesh.getNumVertices(); j++) {
+			glm::vec3 p = octree.mesh.getVertex(j);
+			if (boxes[i].inside(Vector3(p.x, p.y, p.z))) points.push_back(j);
+		}
+		if (!sameSet(points, policyPoints[i])) mismatches++;
+	}
+	t3 = ofGetElapsedTimeMicros();
+	cout << "  box points:   policy " << (t2 - t1) << " microsec, brute force (" << n / 10 << ") " << (t3 - t2)
+		<< " microsec, " << mismatches << " mismatches" << endl;
+
+	// sphere:  brute force over the vertices
+	//
+	mismatches = 0;
+	t1 = ofGetElapsedTimeMicros();
+	for (int i = 0; i < n; i++) {
+		points.clear();
+		SpherePointsQuery q(octree, centers[i], 3, points);
+		traverseOctree(octree.root, q);
+		policyPoints[i] = points;
+	}
+	t2 = ofGetElapsedTimeMicros();
+	for (int i = 0; i < n / 10; i++) {
+		points.clear();
+		for (int j = 0; j < octree.mesh.getNumVertices(); j++) {
+			glm::vec3 p = octree.mesh.getVertex(j);
+			Vector3 d = Vector3(p.x, p.y, p.z) - centers[i];
+			if (d * d <= 9) points.push_back(j);
+		}
+		if (!sameSet(points, policyPoints[i])) mismatches++;
+	}
+	t3 = ofGetElapsedTimeMicros();
+	cout << "  sphere:       policy " << (t2 - t1) << " microsec, brute force (" << n / 10 << ") " << (t3 - t2)
+		<< " microsec, " << mismatches << " mismatches" << endl;
+
+	// custom:  leaves that reach below a height, from lambdas
+	//
+	float level = -1.5;
+	int leaves = 0;
+	t1 = ofGetElapsedTimeMicros();
+	auto q = makeOctreeQuery(
+		[level](const TreeNode& node, float& /*key*/) {
+			return node.minHeight < level ? OctreeQuery::Descend : OctreeQuery::Skip;
+		},
+		[&leaves](const TreeNode& /*node*/) { leaves++; });
+	traverseOctree(octree.root, q);
+	t2 = ofGetElapsedTimeMicros();
+	vector<const TreeNode*> all;
+	octree.getLeaves(octree.root, all);
+	int handLeaves = 0;
+	for (int i = 0; i < all.size(); i++) {
+		if (all[i]->minHeight < level) handLeaves++;
+	}
+	t3 = ofGetElapsedTimeMicros();
+	cout << "  custom (leaves below " << level << "):  policy " << leaves << " in " << (t2 - t1)
+		<< " microsec, all leaves " << handLeaves << " in " << (t3 - t2) << " microsec" << endl;
+}
+
+// benchConcurrentQueries:  n closest ray and n box queries on one shared
+//                          octree, split over 1, 2, 4 .. (core count)
+//                          threads (at least 2), each with its own
+//                          OctreeReader.  answers must match the single
+//                          thread run
+//
+void benchConcurrentQueries(int n) {
+	Octree octree;
+	octree.create(makeTestTerrain(256, 100), 20);
+	Box bounds = octree.root.box;
+
+	vector<Ray> rays;
+	vector<Box> boxes;
+	for (int i = 0; i < n; i++) {
+		Vector3 dir = randomPoint(bounds) - Vector3(0, 20, 0);
+		dir.normalize();
+		rays.push_back(makeRay(Vector3(ofRandom(-50, 50), 20, ofRandom(-50, 50)), dir));
+		Vector3 c = randomPoint(bounds);
+		boxes.push_back(Box(c - Vector3(2, 2, 2), c + Vector3(2, 2, 2)));
+	}
+
+	int numCores = std::thread::hardware_concurrency();
+	if (numCores < 1) numCores = 1;
+	cout << "concurrent queries: " << n << " rays + " << n << " boxes, " << numCores << " cores" << endl;
+
+	vector<float> refT(n), hitT(n);
+	vector<int> refCount(n), count(n);
+	double singleTime = 0;
+	int maxThreads = numCores < 2 ? 2 : numCores;
+	for (int numThreads = 1; numThreads <= maxThreads; numThreads *= 2) {
+		vector<QueryStats> stats(numThreads);
+		uint64_t t1 = ofGetElapsedTimeMicros();
+		vector<std::thread> threads;
+		for (int k = 0; k < numThreads; k++) {
+			threads.push_back(std::thread([&, k]() {
+				OctreeReader reader(octree);
+				for (int i = k * n / numThreads; i < (k + 1) * n / numThreads; i++) {
+					int face;
+					hitT[i] = -1;
+					reader.closestHit(rays[i], 0, FLT_MAX, hitT[i], face);
+					count[i] = reader.pointsInBox(boxes[i]).size();
+				}
+				stats[k] = reader.stats;
+			}));
+		}
+		for (int k = 0; k < numThreads; k++) threads[k].join();
+		uint64_t t2 = ofGetElapsedTimeMicros();
+
+		QueryStats total;
+		for (int k = 0; k < numThreads; k++) total.add(stats[k]);
+		if (numThreads == 1) {
+			refT = hitT;
+			refCount = count;
+			singleTime = t2 - t1;
+		}
+		int mismatches = 0;
+		for (int i = 0; i < n; i++) {
+			if (hitT[i] != refT[i] || count[i] != refCount[i]) mismatches++;
+		}
+		cout << "  " << numThreads << " threads:  " << (t2 - t1) / 1000.0 << " ms, speedup "
+			<< singleTime / (t2 - t1) << ", " << total.nodes << " node tests, " << mismatches << " mismatches" << endl;
+	}
+}
+
+// benchQueryService:  n frames of the game's per frame queries (altitude
+//                     ray, line of sight segment, lander box, a pick)
+//                     answered on the calling thread, and submitted to a
+//                     QueryService with results read the next frame.
+//                     the rest of each frame (drawing) is stood in for by
+//                     a short sleep.  reports the calling thread's time
+//                     spent on queries and checks the answers agree
+//
+void benchQueryService(int n) {
+	shared_ptr<Terrain> terrain = make_shared<Terrain>();
+	terrain->build(vector<ofMesh>(1, makeTestTerrain(256, 100)));
+	const Octree& octree = terrain->octree;
+	const SpatialIndex& index = *terrain->index;
+	Box bounds = octree.root.box;
+
+	vector<QueryRequest> requests;
+	for (int i = 0; i < n; i++) {
+		Vector3 p = randomPoint(bounds) + Vector3(0, 5, 0);
+		Vector3 eye = Vector3(ofRandom(-50, 50), 10, ofRandom(-50, 50));
+		requests.push_back(QueryRequest::closest(makeRay(p, Vector3(0, -1, 0))));
+		requests.push_back(QueryRequest::any(makeRay(eye, p - eye), 0, 1));
+		requests.push_back(QueryRequest::leaves(Box(p - Vector3(.5, .5, .5), p + Vector3(.5, .5, .5))));
+		Vector3 dir = p - eye;
+		dir.normalize();
+		requests.push_back(QueryRequest::pick(makeRay(eye, dir), 1));
+	}
+
+	// answered in place, one frame's worth at a time
+	//
+	vector<float> syncT;
+	vector<int> syncIndex;
+	uint64_t t1 = ofGetElapsedTimeMicros();
+	OctreeReader reader(octree);
+	for (int i = 0; i < requests.size(); i++) {
+		const QueryRequest& r = requests[i];
+		RayHit hit;
+		vector<Box> boxes;
+		switch (r.type) {
+		case QueryRequest::Closest:
+			syncT.push_back(index.intersectRay(r.ray, r.t0, r.t1, hit) ? hit.t : -1);
+			break;
+		case QueryRequest::Any:
+			syncT.push_back(index.intersectAny(r.ray, r.t0, r.t1));
+			break;
+		case QueryRequest::Leaves:
+			octree.intersect(r.box, octree.root, boxes);
+			syncT.push_back(boxes.size());
+			break;
+		case QueryRequest::Pick:
+		{
+			int v = -1;
+			if (index.intersectRay(r.ray, r.t0, r.t1, hit)) {
+				v = reader.nearestPoint(r.ray.origin + r.ray.direction * hit.t, r.radius);
+			}
+			syncT.push_back(v);
+			break;
+		}
+		default:
+			break;
+		}
+	}
+	uint64_t t2 = ofGetElapsedTimeMicros();
+
+	// submitted, each frame takes the previous frame's futures
+	//
+	QueryService service;
+	service.start(terrain);
+	vector<float> asyncT(requests.size());
+	vector<std::future<QueryResult> > lastFrame;
+	uint64_t mainTime = 0;
+	uint64_t t3 = ofGetElapsedTimeMicros();
+	for (int frame = 0; frame <= n; frame++) {
+		uint64_t f1 = ofGetElapsedTimeMicros();
+		for (int k = 0; k < lastFrame.size(); k++) {
+			int i = (frame - 1) * 4 + k;
+			QueryResult res = lastFrame[k].get();
+			switch (requests[i].type) {
+			case QueryRequest::Closest: asyncT[i] = res.hit ? res.t : -1; break;
+			case QueryRequest::Any: asyncT[i] = res.hit; break;
+			case QueryRequest::Leaves: asyncT[i] = res.boxes.size(); break;
+			case QueryRequest::Pick: asyncT[i] = res.index; break;
+			default: break;
+			}
+		}
+		lastFrame.clear();
+		if (frame < n) {
+			for (int k = 0; k < 4; k++) lastFrame.push_back(service.submit(requests[frame * 4 + k]));
+			service.flush();
+		}
+		mainTime += ofGetElapsedTimeMicros() - f1;
+		std::this_thread::sleep_for(std::chrono::microseconds(200));
+	}
+	uint64_t t4 = ofGetElapsedTimeMicros();
+
+	int mismatches = 0;
+	for (int i = 0; i < requests.size(); i++) {
+		if (syncT[i] != asyncT[i]) mismatches++;
+	}
+	cout << "query service: " << n << " frames of " << 4 << " queries, " << service.stats.nodes << " node tests" << endl;
+	cout << "  in place:  " << (t2 - t1) / 1000.0 << " ms on the frame thread" << endl;
+	cout << "  service:   " << mainTime / 1000.0 << " ms on the frame thread, " << (t4 - t3) / 1000.0
+		<< " ms total, " << service.numBatches << " batches, " << mismatches << " mismatches" << endl;
+}
+
+// writeObj:  mesh as an OBJ file (positions and triangles)
+//
+static void writeObj(const string& path, const ofMesh& mesh) {
+	ofstream out(ofToDataPath(path));
+	for (int i = 0; i < mesh.getNumVertices(); i++) {
+		glm::vec3 v = mesh.getVertex(i);
+		out << "v " << v.x << " " << v.y << " " << v.z << "\n";
+	}
+	for (int i = 0; i + 2 < mesh.getNumIndices(); i += 3) {
+		out << "f " << mesh.getIndex(i) + 1 << " " << mesh.getIndex(i + 1) + 1 << " " << mesh.getIndex(i + 2) + 1 << "\n";
+	}
+}
+
+// benchTerrainReload:  a gridSize x gridSize terrain written as OBJ and
+//                      rebuilt by a TerrainLoader while a stand in frame
+//                      loop (version check + a few service queries +
+//                      1 ms of "drawing") keeps running.  reports the
+//                      longest frame thread time against a rebuild done
+//                      on the frame thread
+//
+void benchTerrainReload(int gridSize) {
+	string path = "reload_bench.obj";
+	ofMesh mesh = makeTestTerrain(gridSize, 100);
+	writeObj(path, mesh);
+
+	uint64_t t1 = ofGetElapsedTimeMicros();
+	Terrain inPlace;
+	inPlace.load(path);
+	uint64_t t2 = ofGetElapsedTimeMicros();
+
+	TerrainLoader loader;
+	shared_ptr<Terrain> terrain = make_shared<Terrain>();
+	terrain->build(vector<ofMesh>(1, makeTestTerrain(16, 100)));
+	loader.publish(terrain);
+	QueryService service;
+	service.start(terrain);
+
+	loader.reload(path);
+	uint64_t longest = 0;
+	int frames = 0;
+	Ray down = makeRay(Vector3(0, 50, 0), Vector3(0, -1, 0));
+	std::future<QueryResult> altitude;
+	while (frames < 10000) {
+		uint64_t f1 = ofGetElapsedTimeMicros();
+		shared_ptr<Terrain> latest = loader.current();
+		bool swapped = (latest != terrain);
+		if (swapped) {
+			loader.retire(terrain);
+			terrain = latest;
+			service.setTerrain(terrain);
+		}
+		if (altitude.valid()) altitude.get();
+		altitude = service.submit(QueryRequest::closest(down));
+		service.flush();
+		uint64_t f2 = ofGetElapsedTimeMicros();
+		if (f2 - f1 > longest) longest = f2 - f1;
+		frames++;
+		if (swapped) break;
+		std::this_thread::sleep_for(std::chrono::milliseconds(1));
+	}
+	service.drain();
+	remove(ofToDataPath(path).c_str());
+
+	bool same = terrain->octree.mesh.getNumVertices() == mesh.getNumVertices() &&
+		terrain->octree.mesh.getNumIndices() == mesh.getNumIndices();
+	cout << "terrain reload: " << mesh.getNumIndices() / 3 << " faces" << endl;
+	cout << "  on the frame thread:  " << (t2 - t1) / 1000.0 << " ms" << endl;
+	cout << "  background:  " << frames << " frames ran meanwhile, longest " << longest / 1000.0
+		<< " ms, " << (same ? "new terrain in use" : "WRONG terrain") << endl;
+}
+
+// majorFaults:  page faults of this process that had to read from disk
+//
+static int64_t majorFaults() {
+#ifdef _WIN32
+	return 0;
+#else
+	struct rusage usage;
+	getrusage(RUSAGE_SELF, &usage);
+	return usage.ru_majflt;
+#endif
+}
+
+// benchPagedOctree:  a gridSize x gridSize terrain written as a paged
+//                    file and queried along a walk (n steps of a down
+//                    ray, a line of sight segment and a small box, as a
+//                    lander flying over it would) with working sets from
+//                    the whole file down to 1/64 of it, with and without
+//                    prefetch.  each run starts cold (file dropped from
+//                    the OS cache).  reports time, cache faults per page
+//                    request, OS major faults and answers that differ
+//                    from the in memory Octree
+//
+void benchPagedOctree(int gridSize, int n) {
+	Octree octree;
+	octree.create(makeTestTerrain(gridSize, 100), 20);
+	string path = ofToDataPath("paged_bench.oct");
+	uint64_t t1 = ofGetElapsedTimeMicros();
+	PagedOctree::write(octree, path);
+	uint64_t t2 = ofGetElapsedTimeMicros();
+
+	vector<Ray> rays;
+	vector<Vector3> from, to;
+	vector<Box> boxes;
+	for (int i = 0; i < n; i++) {
+		float s = (float)i / n;
+		Vector3 p(s * 90 - 45, 20, sin(s * 12) * 40);
+		p = p + Vector3(ofRandom(-1, 1), 0, ofRandom(-1, 1));
+		rays.push_back(makeRay(p, Vector3(0, -1, 0)));
+		from.push_back(p);
+		to.push_back(p + Vector3(ofRandom(-10, 10), -20, ofRandom(-10, 10)));
+		boxes.push_back(Box(p - Vector3(1, 30, 1), p + Vector3(1, 0, 1)));
+	}
+
+	vector<float> refT(n);
+	vector<int> refFace(n), refBlocked(n), refCount(n);
+	uint64_t t3 = ofGetElapsedTimeMicros();
+	for (int i = 0; i < n; i++) {
+		vector<int> points;
+		octree.intersectClosest(rays[i], 0, FLT_MAX, refT[i], refFace[i]);
+		refBlocked[i] = octree.intersectSegment(from[i], to[i]);
+		refCount[i] = octree.getPointsInBox(boxes[i], points);
+	}
+	uint64_t t4 = ofGetElapsedTimeMicros();
+
+	PagedOctree paged;
+	if (!paged.open(path)) return;
+	int numPages = paged.header.numPages;
+	cout << "paged octree: " << octree.mesh.getNumIndices() / 3 << " faces, " << paged.header.numNodes
+		<< " nodes, " << numPages << " pages of " << paged.header.pageSize / 1024 << " KB, written in "
+		<< (t2 - t1) / 1000.0 << " ms" << endl;
+	cout << "  in memory:  " << (t4 - t3) / 1000.0 << " ms" << endl;
+
+	for (int div = 1; div <= 64; div *= 8) {
+		for (int prefetch = 0; prefetch < 2; prefetch++) {
+			paged.cache.maxPages = max(numPages / div, 8);
+			paged.bPrefetch = prefetch;
+			paged.dropOSCache();
+			paged.cache.clearStats();
+			int64_t faults = majorFaults();
+			int mismatches = 0;
+			uint64_t t5 = ofGetElapsedTimeMicros();
+			for (int i = 0; i < n; i++) {
+				float t;
+				int face;
+				vector<int> points;
+				paged.intersectClosest(rays[i], 0, FLT_MAX, t, face);
+				bool blocked = paged.intersectSegment(from[i], to[i]);
+				int count = paged.getPointsInBox(boxes[i], points);
+				if (t != refT[i] || face != refFace[i] || blocked != refBlocked[i] || count != refCount[i]) mismatches++;
+			}
+			uint64_t t6 = ofGetElapsedTimeMicros();
+			faults = majorFaults() - faults;
+
+			const PageCache& c = paged.cache;
+			cout << "  " << c.maxPages << " pages" << (prefetch ? ", prefetch:  " : ":  ") << (t6 - t5) / 1000.0
+				<< " ms, fault rate " << (double)c.faults / c.requests << " (" << c.faults << " / " << c.requests
+				<< "), " << c.evictions << " evictions, " << c.prefetchHits << " prefetch hits, "
+				<< faults << " OS major faults, " << mismatches << " mismatches" << endl;
+		}
+	}
+	paged.close();
+	remove(path.c_str());
+}
+
+// streamPoint:  point i of the streaming build test set, scattered over a
+//               1000 x 1000 rolling height field.  the same every call so
+//               the set never has to be held
+//
+static Vector3 streamPoint(int64_t i) {
+	uint64_t h = (uint64_t)i * 0x9E3779B97F4A7C15ull;
+	h ^= h >> 29;
+	h *= 0xBF58476D1CE4E5B9ull;
+	h ^= h >> 32;
+	float x = (h & 0xFFFFF) / (float)0xFFFFF * 1000 - 500;
+	float z = ((h >> 20) & 0xFFFFF) / (float)0xFFFFF * 1000 - 500;
+	float y = sin(x * .03) * cos(z * .02) * 20 + sin(x * .17 + z * .23) * 3;
+	return Vector3(x, y, z);
+}
+
+// benchStreamingBuild:  numPoints points written as a raw float file a
+//                       chunk at a time and built into a PagedOctree by
+//                       StreamingOctreeBuilder.  reports time per phase,
+//                       throughput and peak memory, and checks n box
+//                       queries on the result against a scan of the set.
+//                       all its files go in a directory of its own under
+//                       the system temp directory, removed at the end
+//
+void benchStreamingBuild(int64_t numPoints, int n) {
+	std::error_code error;
+	std::filesystem::path dir = std::filesystem::temp_directory_path(error) / "octree_stream_bench";
+	std::filesystem::create_directories(dir, error);
+	if (error) {
+		cout << "streaming build: can't make " << dir.string() << endl;
+		return;
+	}
+	string inPath = (dir / "points.xyz").string();
+	string outPath = (dir / "octree.oct").string();
+	FILE* file = fopen(inPath.c_str(), "wb");
+	if (file == NULL) {
+		std::filesystem::remove_all(dir, error);
+		return;
+	}
+	vector<float> chunk;
+	for (int64_t i = 0; i < numPoints; i++) {
+		Vector3 p = streamPoint(i);
+		chunk.push_back(p.x());
+		chunk.push_back(p.y());
+		chunk.push_back(p.z());
+		if (chunk.size() == 3 << 16 || i == numPoints - 1) {
+			fwrite(chunk.data(), sizeof(float), chunk.size(), file);
+			chunk.clear();
+		}
+	}
+	fclose(file);
+
+	StreamingOctreeBuilder builder;
+	builder.tempDir = dir.string();
+	bool ok = builder.build(inPath, outPath);
+	remove(inPath.c_str());
+	double mb = 1024.0 * 1024.0;
+	cout << "streaming build: " << builder.numPoints << " points (" << builder.numPoints * 12 / mb
+		<< " MB), " << (ok ? "" : "FAILED, ") << builder.numNodes << " nodes, " << builder.numBuckets
+		<< " buckets, largest " << builder.largestBucket << " points" << endl;
+	cout << "  bounds " << builder.boundsTime << " s, binning " << builder.binTime << " s, subtrees "
+		<< builder.subtreeTime << " s, total " << builder.totalTime << " s:  "
+		<< builder.numPoints / builder.totalTime / 1.0e6 << " M points/s" << endl;
+	cout << "  peak memory " << builder.peakMemory / mb << " MB" << endl;
+	if (!ok) {
+		std::filesystem::remove_all(dir, error);
+		return;
+	}
+
+	vector<Box> boxes;
+	vector<vector<int> > found(n);
+	for (int i = 0; i < n; i++) {
+		Vector3 c = streamPoint(numPoints + i);
+		boxes.push_back(Box(c - Vector3(5, 30, 5), c + Vector3(5, 30, 5)));
+	}
+	for (int64_t i = 0; i < numPoints; i++) {
+		Vector3 p = streamPoint(i);
+		for (int k = 0; k < n; k++) {
+			if (boxes[k].inside(p)) found[k].push_back(i);
+		}
+	}
+	PagedOctree paged;
+	paged.open(outPath, 1024);
+	int mismatches = 0;
+	int64_t total = 0;
+	uint64_t t1 = ofGetElapsedTimeMicros();
+	for (int k = 0; k < n; k++) {
+		vector<int> points;
+		paged.getPointsInBox(boxes[k], points);
+		if (points != found[k]) mismatches++;
+		total += points.size();
+	}
+	uint64_t t2 = ofGetElapsedTimeMicros();
+	paged.close();
+	std::filesystem::remove_all(dir, error);
+	cout << "  " << n << " box queries:  " << total << " points in " << (t2 - t1) / 1000.0 << " ms, "
+		<< mismatches << " mismatches" << endl;
+}
+
+// tileHeight:  ground height of the tiled test world, continuous across
+//              tiles
+//
+static float tileHeight(float x, float z) {
+	return sin(x * .05) * cos(z * .04) * 8 + sin(x * .31 + z * .27) * .8;
+}
+
+// makeTestTile:  tile (i, j) of the tiled test world, gridSize x gridSize
+//                vertices over tileSize.  border vertices are computed the
+//                same way by both tiles sharing them
+//
+static ofMesh makeTestTile(int i, int j, int gridSize, float tileSize) {
+	ofMesh mesh;
+	for (int z = 0; z < gridSize; z++) {
+		for (int x = 0; x < gridSize; x++) {
+			float fx = i * tileSize + x * tileSize / (gridSize - 1);
+			float fz = j * tileSize + z * tileSize / (gridSize - 1);
+			mesh.addVertex(glm::vec3(fx, tileHeight(fx, fz), fz));
+		}
+	}
+	for (int z = 0; z < gridSize - 1; z++) {
+		for (int x = 0; x < gridSize - 1; x++) {
+			int k = z * gridSize + x;
+			mesh.addIndex(k);
+			mesh.addIndex(k + gridSize);
+			mesh.addIndex(k + 1);
+			mesh.addIndex(k + 1);
+			mesh.addIndex(k + gridSize);
+			mesh.addIndex(k + gridSize + 1);
+		}
+	}
+	return mesh;
+}
+
+// benchTerrainTiles:  a lander flying across numTiles tiles (gridSize
+//                     vertices a side each) streamed by TerrainTiles.
+//                     every frame:  update(), an altitude ray and the
+//                     lander box query on the snapshot, and 2 ms of
+//                     stand in frame work.  altitudes are checked against
+//                     one octree over the whole strip of tiles.  reports
+//                     the longest update() and frame, tiles built and
+//                     evicted, and frames where the ground under the
+//                     lander wasn't loaded yet
+//
+void benchTerrainTiles(int numTiles, int gridSize) {
+	float tileSize = 50;
+	ofMesh strip;
+	for (int i = 0; i < numTiles; i++) {
+		ofMesh tile = makeTestTile(i, 0, gridSize, tileSize);
+		int base = strip.getNumVertices();
+		for (int k = 0; k < tile.getNumVertices(); k++) strip.addVertex(tile.getVertex(k));
+		for (int k = 0; k < tile.getNumIndices(); k++) strip.addIndex(base + tile.getIndex(k));
+	}
+	Octree whole;
+	whole.create(strip, 20);
+
+	TerrainTiles tiles;
+	tiles.loadRadius = tileSize * 1.2;
+	tiles.evictRadius = tileSize * 2;
+	tiles.start([=](int i, int j, vector<ofMesh>& meshesRtn) {
+		if (i < 0 || i >= numTiles || j != 0) return false;
+		meshesRtn.push_back(makeTestTile(i, j, gridSize, tileSize));
+		return true;
+	}, tileSize);
+
+	// the game would wait for the ground under the lander once, at the start
+	//
+	float speed = .5;		// per frame
+	float z = tileSize * .5;
+	uint64_t t1 = ofGetElapsedTimeMicros();
+	while (tiles.numLoaded() == 0) {
+		tiles.update(Vector3(1, 0, z));
+		std::this_thread::sleep_for(std::chrono::milliseconds(1));
+	}
+	uint64_t t2 = ofGetElapsedTimeMicros();
+
+	int frames = 0, misses = 0, mismatches = 0, touching = 0;
+	uint64_t longest = 0;
+	for (float x = 1; x < numTiles * tileSize - 1; x += speed) {
+		uint64_t f1 = ofGetElapsedTimeMicros();
+		Vector3 lander(x, tileHeight(x, z) + 3, z);
+		tiles.update(lander);
+		shared_ptr<const TileList> snapshot = tiles.snapshot();
+
+		Ray down = makeRay(lander, Vector3(0, -1, 0));
+		TileHit hit;
+		bool bHit = TerrainTiles::intersectRay(*snapshot, down, 0, FLT_MAX, hit);
+		vector<Box> boxes;
+		if (TerrainTiles::intersect(*snapshot, Box(lander - Vector3(1, 4, 1), lander + Vector3(1, 0, 1)), boxes)) touching++;
+		uint64_t f2 = ofGetElapsedTimeMicros();
+		longest = max(longest, f2 - f1);
+
+		float t;
+		int face;
+		whole.intersectClosest(down, 0, FLT_MAX, t, face);
+		if (!bHit) misses++;
+		else if (fabs(hit.t - t) > 1e-4) mismatches++;
+		frames++;
+		std::this_thread::sleep_for(std::chrono::milliseconds(2));
+	}
+	cout << "terrain tiles: " << numTiles << " tiles of " << gridSize << " x " << gridSize << ", " << frames
+		<< " frames flying across, first tile in " << (t2 - t1) / 1000.0 << " ms" << endl;
+	cout << "  " << tiles.numBuilt << " built (longest " << tiles.maxBuildTime << " ms, loader thread), "
+		<< tiles.numEvicted << " evicted, " << tiles.numLoaded() << " loaded at the end" << endl;
+	cout << "  frame thread:  longest update() " << tiles.maxUpdateTime << " ms, longest frame " << longest / 1000.0
+		<< " ms, lander box touched ground in " << touching << " frames" << endl;
+	cout << "  altitude:  " << misses << " frames without ground loaded, " << mismatches
+		<< " differ from one octree over all tiles" << endl;
+}
+
+// benchQueryClient:  numThreads clients of the server at name, each
+//                    making n rounds of a down ray, a line of sight
+//                    segment, a small box and a nearest point query in
+//                    the server's bounds.  reports round trip latency and
+//                    throughput, and answers that differ from reference
+//                    (skipped if NULL)
+//
+void benchQueryClient(const string& name, int numThreads, int n, const Terrain* reference) {
+	typedef std::chrono::steady_clock Clock;
+	vector<vector<float> > latency(numThreads);		// us
+	vector<int> mismatches(numThreads, 0);
+	vector<bool> failed(numThreads, false);
+	Clock::time_point t1 = Clock::now();
+	vector<std::thread> threads;
+	for (int k = 0; k < numThreads; k++) {
+		threads.push_back(std::thread([&, k]() {
+			QueryClient client;
+			if (!client.open(name)) {
+				failed[k] = true;
+				return;
+			}
+			std::unique_ptr<OctreeReader> reader(reference ? new OctreeReader(reference->octree) : NULL);
+			Box b = client.bounds();
+			std::mt19937 random(k + 1);
+			auto uniform = [&](int axis) {
+				return std::uniform_real_distribution<float>(b.parameters[0][axis], b.parameters[1][axis])(random);
+			};
+			for (int i = 0; i < n && !client.bFailed; i++) {
+				Vector3 p(uniform(0), uniform(1) + 5, uniform(2));
+				Vector3 eye(uniform(0), b.parameters[1].y() + 5, uniform(2));
+				Ray down = makeRay(p, Vector3(0, -1, 0));
+				Ray sight = makeRay(eye, p - eye);
+				Box box(p - Vector3(.5, 6, .5), p + Vector3(.5, 0, .5));
+
+				Clock::time_point q1 = Clock::now();
+				float t;
+				int face;
+				bool bHit = client.closest(down, 0, FLT_MAX, t, face);
+				Clock::time_point q2 = Clock::now();
+				bool bBlocked = client.blocked(sight, 0, 1);
+				Clock::time_point q3 = Clock::now();
+				const int* points;
+				int numPoints = client.pointsInBox(box, points);
+				Clock::time_point q4 = Clock::now();
+				int vertex = client.nearest(p - Vector3(0, 5, 0), 2);
+				Clock::time_point q5 = Clock::now();
+				latency[k].push_back(std::chrono::duration<float, std::micro>(q2 - q1).count());
+				latency[k].push_back(std::chrono::duration<float, std::micro>(q3 - q2).count());
+				latency[k].push_back(std::chrono::duration<float, std::micro>(q4 - q3).count());
+				latency[k].push_back(std::chrono::duration<float, std::micro>(q5 - q4).count());
+
+				if (reader == NULL) continue;
+				RayHit hit;
+				bool bRefHit = reference->index->intersectRay(down, 0, FLT_MAX, hit);
+				if (bHit != bRefHit || (bHit && (t != hit.t || face != hit.face))) mismatches[k]++;
+				if (bBlocked != reference->index->intersectAny(sight, 0, 1)) mismatches[k]++;
+				const vector<int>& refPoints = reader->pointsInBox(box);
+				if (client.bTruncated || numPoints != refPoints.size() ||
+					!std::equal(refPoints.begin(), refPoints.end(), points)) mismatches[k]++;
+				if (vertex != reader->nearestPoint(p - Vector3(0, 5, 0), 2)) mismatches[k]++;
+			}
+			if (client.bFailed) failed[k] = true;
+		}));
+	}
+	for (int k = 0; k < threads.size(); k++) threads[k].join();
+	float seconds = std::chrono::duration<float>(Clock::now() - t1).count();
+
+	vector<float> all;
+	int wrong = 0, lost = 0;
+	for (int k = 0; k < numThreads; k++) {
+		all.insert(all.end(), latency[k].begin(), latency[k].end());
+		wrong += mismatches[k];
+		lost += failed[k];
+	}
+	if (all.size() == 0) {
+		cout << "query server client: no server at " << name << endl;
+		return;
+	}
+	sort(all.begin(), all.end());
+	double sum = 0;
+	for (int i = 0; i < all.size(); i++) sum += all[i];
+	cout << "query server client: " << numThreads << " thread(s), " << all.size() << " queries in " << seconds * 1000 << " ms, "
+		<< (int)(all.size() / seconds) << " queries/s" << endl;
+	cout << "  round trip:  mean " << sum / all.size() << " us, median " << all[all.size() / 2] << " us, 99% "
+		<< all[all.size() * 99 / 100] << " us, max " << all.back() << " us" << endl;
+	if (reference) cout << "  " << wrong << " answers differ from the terrain in process";
+	else cout << "  (no reference terrain)";
+	if (lost > 0) cout << ", " << lost << " client(s) lost the server";
+	cout << endl;
+}
+
+// numaQueries:  n rounds of a down ray and a small box on terrain from
+//               numThreads threads pinned to node.  returns queries/s
+//
+static float numaQueries(const Terrain& terrain, int node, int numThreads, int n) {
+	Box bounds = terrain.octree.root.box;
+	uint64_t t1 = ofGetElapsedTimeMicros();
+	vector<std::thread> threads;
+	for (int k = 0; k < numThreads; k++) {
+		threads.push_back(std::thread([&, k]() {
+			pinThreadToNode(node);
+			OctreeReader reader(terrain.octree);
+			std::mt19937 random(k + 1);
+			auto uniform = [&](int axis) {
+				return std::uniform_real_distribution<float>(bounds.parameters[0][axis], bounds.parameters[1][axis])(random);
+			};
+			for (int i = 0; i < n; i++) {
+				Vector3 p(uniform(0), bounds.parameters[1].y() + 1, uniform(2));
+				RayHit hit;
+				terrain.index->intersectRay(makeRay(p, Vector3(0, -1, 0)), 0, FLT_MAX, hit);
+				reader.pointsInBox(Box(p - Vector3(1, 100, 1), p + Vector3(1, 0, 1)));
+			}
+		}));
+	}
+	for (int k = 0; k < threads.size(); k++) threads[k].join();
+	return numThreads * n * 2 / ((ofGetElapsedTimeMicros() - t1) / 1e6);
+}
+
+// benchNumaReplicas:  terrain query throughput from every NUMA node
+//                     against a copy of the terrain on every node (local
+//                     on the diagonal, remote off it), then a
+//                     QueryService with and without per node copies
+//
+void benchNumaReplicas(int n) {
+	const NumaTopology& topology = NumaTopology::get();
+	int numNodes = topology.numNodes();
+	shared_ptr<Terrain> terrain = make_shared<Terrain>();
+	terrain->build(vector<ofMesh>(1, makeTestTerrain(512, 100)));
+
+	cout << "numa replicas: " << numNodes << " node(s)" << (topology.bDetected ? "" : " (no topology, one node assumed)") << ":";
+	for (int node = 0; node < numNodes; node++) cout << " " << topology.nodes[node].size() << " cpus";
+	cout << endl;
+
+	// copies made by a thread pinned to their node (first touch)
+	//
+	vector<shared_ptr<Terrain> > copies(numNodes);
+	for (int node = 0; node < numNodes; node++) {
+		std::thread([&, node]() {
+			pinThreadToNode(node);
+			copies[node] = terrain->replicate();
+		}).join();
+	}
+	float local = 0, remote = 0;
+	for (int memory = 0; memory < numNodes; memory++) {
+		cout << "  memory on node " << memory << ", queries/s from";
+		for (int node = 0; node < numNodes; node++) {
+			int numThreads = min((int)topology.nodes[node].size(), 4);
+			float rate = numaQueries(*copies[memory], node, numThreads, n / numThreads);
+			cout << "  node " << node << ": " << (int)rate;
+			if (node == memory) local += rate / numNodes;
+			else remote += rate / (numNodes * (numNodes - 1));
+		}
+		cout << endl;
+	}
+	if (numNodes > 1) cout << "  remote " << (int)remote << " vs local " << (int)local << " queries/s (" << remote / local << ")" << endl;
+
+	for (int replicate = 0; replicate <= 1; replicate++) {
+		QueryService service;
+		service.bReplicate = replicate;
+		service.batchSize = 64;
+		service.start(terrain);
+		service.submit(QueryRequest::closest(makeRay(Vector3(0, 50, 0), Vector3(0, -1, 0))));
+		service.drain();		// copies made
+		uint64_t t1 = ofGetElapsedTimeMicros();
+		Box bounds = terrain->octree.root.box;
+		for (int i = 0; i < n; i++) {
+			Vector3 p = randomPoint(bounds) + Vector3(0, 5, 0);
+			service.submit(QueryRequest::closest(makeRay(p, Vector3(0, -1, 0))));
+			service.submit(QueryRequest::points(Box(p - Vector3(1, 100, 1), p + Vector3(1, 0, 1))));
+		}
+		service.flush();
+		service.drain();
+		uint64_t t2 = ofGetElapsedTimeMicros();
+		cout << "  query service, " << (replicate ? "a copy per node, pinned workers:  " : "one terrain, unpinned workers:  ")
+			<< (int)(n * 2 / ((t2 - t1) / 1e6)) << " queries/s" << endl;
+	}
+}
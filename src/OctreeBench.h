@@ -0,0 +1,30 @@
+//--------------------------------------------------------------
+//
+//  OctreeBench - timing of octree queries, printed to the console.
+//  The quick ones run from the app with the 'u' key, all of them (and
+//  LanderBench) with --bench on the command line.
+//
+#pragma once
+#include "ofMain.h"
+#include "Octree.h"
+
+void runOctreeBenchmarks(Octree& octree);
+void runAllBenchmarks();
+
+void benchSegmentQueries(Octree& octree, int n);
+void benchPicking(int n);
+void benchOccupancy(Octree& octree, int n);
+void benchBroadPhase(int numBodies, int numFrames);
+void benchInstancing(int numInstances, int n);
+void benchPointOctrees(int gridSize, int n);
+void benchTraversal(int n);
+void benchConcurrentQueries(int n);
+void benchQueryService(int n);
+void benchTerrainReload(int gridSize);
+void benchPagedOctree(int gridSize, int n);
+void benchStreamingBuild(int64_t numPoints, int n);
+void benchTerrainTiles(int numTiles, int gridSize);
+void benchNumaReplicas(int n);
+void benchQueryClient(const string& name, int numThreads, int n, const class Terrain* reference);
+
+ofMesh makeTestTerrain(int gridSize, float size);
@@ -0,0 +1,465 @@
+//--------------------------------------------------------------
+//
+//  OctreeQuery - one octree traversal, many queries
+//
+//  traverseOctree() walks an Octree and leaves all query specific
+//  decisions to a policy class, given as a template parameter so every
+//  call is resolved (and inlined) at compile time:
+//
+//      static const bool ordered;
+//          visit children nearest first (by the key test() returns),
+//          for closest hit queries
+//
+//      OctreeQuery::Result test(const TreeNode& node, float& key);
+//          Skip the subtree, Descend into it, or take it Whole (the
+//          query region contains it).  key orders children
+//
+//      void leaf(const TreeNode& node);
+//          action at a leaf that passed test()
+//
+//      void whole(const TreeNode& node);
+//          action for a subtree test() returned Whole for
+//
+//      float bound() const;
+//          nodes whose key is at or past bound are skipped when they
+//          come off the stack (closest hit so far)
+//
+//      bool done() const;
+//          stop the traversal (any hit found, enough results)
+//
+//  Octree's own queries (closest ray hit, segment blocked, points in a
+//  box or frustum, leaf boxes, picking) are thin wrappers over the
+//  policies below, which also cover sphere and nearest point queries.
+//  CustomQuery makes a policy from two lambdas.
+//
+#pragma once
+#include "ofMain.h"
+#include "Octree.h"
+#include "TraversalStack.h"
+#include <float.h>
+
+class OctreeQuery {
+public:
+	enum Result { Skip, Descend, Whole };
+};
+
+template <class Policy>
+void traverseOctree(const TreeNode& root, Policy& policy) {
+	struct Entry { const TreeNode* node; float key; bool whole; };
+	TraversalStack<Entry, 256> stack;
+
+	float key = 0;
+	OctreeQuery::Result r = policy.test(root, key);
+	if (r == OctreeQuery::Skip) return;
+	stack.push({ &root, key, r == OctreeQuery::Whole });
+
+	while (!stack.empty()) {
+		Entry e = stack.pop();
+		if (e.key >= policy.bound()) continue;
+		const TreeNode& node = *e.node;
+		if (e.whole) {
+			policy.whole(node);
+			if (policy.done()) return;
+			continue;
+		}
+		if (node.children.size() == 0) {
+			policy.leaf(node);
+			if (policy.done()) return;
+			continue;
+		}
+
+		// test the children, then push them furthest first so the
+		// nearest comes off the stack next
+		//
+		const TreeNode* c[8];
+		float k[8];
+		bool w[8];
+		int n = 0;
+		for (int i = 0; i < node.children.size(); i++) {
+			key = 0;
+			r = policy.test(node.children[i], key);
+			if (r == OctreeQuery::Skip) continue;
+			int j = n++;
+			if (Policy::ordered) {
+				while (j > 0 && k[j - 1] < key) {
+					c[j] = c[j - 1];
+					k[j] = k[j - 1];
+					w[j] = w[j - 1];
+					j--;
+				}
+			}
+			c[j] = &node.children[i];
+			k[j] = key;
+			w[j] = (r == OctreeQuery::Whole);
+		}
+		for (int i = 0; i < n; i++) stack.push({ c[i], k[i], w[i] });
+	}
+}
+
+// RayClosestQuery:  closest triangle hit along a ray for t in (t0, t1)
+//
+class RayClosestQuery {
+public:
+	static const bool ordered = true;
+
+	RayClosestQuery(const Octree& octree, const Ray& ray, float t0, float t1) :
+		octree(octree), ray(ray), t0(t0), t(t1) { }
+
+	OctreeQuery::Result test(const TreeNode& node, float& key) const {
+		float tFar;
+		return node.faceBounds.intersect(ray, t0, t, key, tFar) ? OctreeQuery::Descend : OctreeQuery::Skip;
+	}
+	void leaf(const TreeNode& node) {
+		float tHit;
+		Vector3 v[3];
+		for (int i = 0; i < node.faces.size(); i++) {
+			octree.getFaceVerts(node.faces[i], v);
+			if (rayTriangle(ray.origin, ray.direction, v, t0, t, tHit)) {
+				t = tHit;
+				face = node.faces[i];
+			}
+		}
+	}
+	void whole(const TreeNode& /*node*/) { }
+	float bound() const { return t; }
+	bool done() const { return false; }
+
+	const Octree& octree;
+	Ray ray;
+	float t0;
+	float t;			// closest hit (t1 if none)
+	int face = -1;
+};
+
+// RayAnyQuery:  is the segment (t0, t1) of a ray blocked.  a leaf with
+//               points but no faces counts as blocking, as in
+//               Octree::intersectSegment
+//
+class RayAnyQuery {
+public:
+	static const bool ordered = true;
+
+	RayAnyQuery(const Octree& octree, const Ray& ray, float t0, float t1) :
+		octree(octree), ray(ray), t0(t0), t1(t1) { }
+
+	OctreeQuery::Result test(const TreeNode& node, float& key) const {
+		float tFar;
+		return node.faceBounds.intersect(ray, t0, t1, key, tFar) ? OctreeQuery::Descend : OctreeQuery::Skip;
+	}
+	void leaf(const TreeNode& node) {
+		if (node.faces.size() == 0) {
+			hit = true;
+			return;
+		}
+		float t;
+		Vector3 v[3];
+		for (int i = 0; i < node.faces.size() && !hit; i++) {
+			octree.getFaceVerts(node.faces[i], v);
+			if (rayTriangle(ray.origin, ray.direction, v, t0, t1, t)) hit = true;
+		}
+	}
+	void whole(const TreeNode& /*node*/) { }
+	float bound() const { return FLT_MAX; }
+	bool done() const { return hit; }
+
+	const Octree& octree;
+	Ray ray;
+	float t0, t1;
+	bool hit = false;
+};
+
+// BoxPointsQuery:  points (mesh vertex indices) inside a box.  nodes
+//                  inside the box are taken whole
+//
+class BoxPointsQuery {
+public:
+	static const bool ordered = false;
+
+	BoxPointsQuery(const Octree& octree, const Box& box, vector<int>& pointsRtn) :
+		octree(octree), box(box), pointsRtn(pointsRtn) { }
+
+	OctreeQuery::Result test(const TreeNode& node, float& /*key*/) const {
+		if (!box.overlap(node.box)) return OctreeQuery::Skip;
+		if (box.inside(node.box.parameters[0]) && box.inside(node.box.parameters[1])) return OctreeQuery::Whole;
+		return OctreeQuery::Descend;
+	}
+	void leaf(const TreeNode& node) {
+		for (int i = 0; i < node.points.size(); i++) {
+			glm::vec3 p = octree.mesh.getVertex(node.points[i]);
+			if (box.inside(Vector3(p.x, p.y, p.z))) pointsRtn.push_back(node.points[i]);
+		}
+	}
+	void whole(const TreeNode& node) {
+		pointsRtn.insert(pointsRtn.end(), node.points.begin(), node.points.end());
+	}
+	float bound() const { return FLT_MAX; }
+	bool done() const { return false; }
+
+	const Octree& octree;
+	Box box;
+	vector<int>& pointsRtn;
+};
+
+// BoxLeavesQuery:  boxes of the leaves a box overlaps, as Octree's box
+//                  intersect() (the ground query) returns them
+//
+class BoxLeavesQuery {
+public:
+	static const bool ordered = false;
+
+	BoxLeavesQuery(const Box& box, vector<Box>& boxListRtn) : box(box), boxListRtn(boxListRtn) { }
+
+	OctreeQuery::Result test(const TreeNode& node, float& /*key*/) const {
+		return node.box.overlap(box) ? OctreeQuery::Descend : OctreeQuery::Skip;
+	}
+	void leaf(const TreeNode& node) {
+		boxListRtn.push_back(node.box);
+		found++;
+	}
+	void whole(const TreeNode& /*node*/) { }
+	float bound() const { return FLT_MAX; }
+	bool done() const { return false; }
+
+	Box box;
+	vector<Box>& boxListRtn;
+	int found = 0;
+};
+
+// SpherePointsQuery:  points within radius of center
+//
+class SpherePointsQuery {
+public:
+	static const bool ordered = false;
+
+	SpherePointsQuery(const Octree& octree, const Vector3& center, float radius, vector<int>& pointsRtn) :
+		octree(octree), center(center), r2(radius * radius), pointsRtn(pointsRtn) { }
+
+	OctreeQuery::Result test(const TreeNode& node, float& /*key*/) const {
+		const Vector3& lo = node.box.parameters[0];
+		const Vector3& hi = node.box.parameters[1];
+		float near2 = 0, far2 = 0;
+		for (int k = 0; k < 3; k++) {
+			float a = lo[k] - center[k];
+			float b = center[k] - hi[k];
+			float d = a > 0 ? a : (b > 0 ? b : 0);
+			float f = -a > -b ? -a : -b;
+			near2 += d * d;
+			far2 += f * f;
+		}
+		if (near2 > r2) return OctreeQuery::Skip;
+		return far2 <= r2 ? OctreeQuery::Whole : OctreeQuery::Descend;
+	}
+	void leaf(const TreeNode& node) {
+		for (int i = 0; i < node.points.size(); i++) {
+			glm::vec3 p = octree.mesh.getVertex(node.points[i]);
+			Vector3 d = Vector3(p.x, p.y, p.z) - center;
+			if (d * d <= r2) pointsRtn.push_back(node.points[i]);
+		}
+	}
+	void whole(const TreeNode& node) {
+		pointsRtn.insert(pointsRtn.end(), node.points.begin(), node.points.end());
+	}
+	float bound() const { return FLT_MAX; }
+	bool done() const { return false; }
+
+	const Octree& octree;
+	Vector3 center;
+	float r2;
+	vector<int>& pointsRtn;
+};
+
+// FrustumPointsQuery:  points inside a frustum (see Frustum)
+//
+class FrustumPointsQuery {
+public:
+	static const bool ordered = false;
+
+	FrustumPointsQuery(const Octree& octree, const Frustum& frustum, vector<int>& pointsRtn) :
+		octree(octree), frustum(frustum), pointsRtn(pointsRtn) { }
+
+	OctreeQuery::Result test(const TreeNode& node, float& /*key*/) const {
+		Frustum::Classify c = frustum.classify(node.box);
+		if (c == Frustum::Outside) return OctreeQuery::Skip;
+		return c == Frustum::Inside ? OctreeQuery::Whole : OctreeQuery::Descend;
+	}
+	void leaf(const TreeNode& node) {
+		for (int i = 0; i < node.points.size(); i++) {
+			glm::vec3 v = octree.mesh.getVertex(node.points[i]);
+			if (frustum.inside(Vector3(v.x, v.y, v.z))) pointsRtn.push_back(node.points[i]);
+		}
+	}
+	void whole(const TreeNode& node) {
+		pointsRtn.insert(pointsRtn.end(), node.points.begin(), node.points.end());
+	}
+	float bound() const { return FLT_MAX; }
+	bool done() const { return false; }
+
+	const Octree& octree;
+	const Frustum& frustum;
+	vector<int>& pointsRtn;
+};
+
+// NearestPointQuery:  closest point (mesh vertex) to p within maxDist.
+//                     boxes are visited nearest first and skipped once
+//                     they are further than the best point
+//
+class NearestPointQuery {
+public:
+	static const bool ordered = true;
+
+	NearestPointQuery(const Octree& octree, const Vector3& p, float maxDist) :
+		octree(octree), p(p), best(maxDist * maxDist) { }
+
+	OctreeQuery::Result test(const TreeNode& node, float& key) const {
+		key = 0;
+		for (int k = 0; k < 3; k++) {
+			float a = node.box.parameters[0][k] - p[k];
+			float b = p[k] - node.box.parameters[1][k];
+			float d = a > 0 ? a : (b > 0 ? b : 0);
+			key += d * d;
+		}
+		return key <= best ? OctreeQuery::Descend : OctreeQuery::Skip;
+	}
+	void leaf(const TreeNode& node) {
+		for (int i = 0; i < node.points.size(); i++) {
+			glm::vec3 v = octree.mesh.getVertex(node.points[i]);
+			Vector3 d = Vector3(v.x, v.y, v.z) - p;
+			float d2 = d * d;
+			if (d2 < best || (d2 == best && index == -1)) {
+				best = d2;
+				index = node.points[i];
+			}
+		}
+	}
+	void whole(const TreeNode& /*node*/) { }
+	float bound() const { return index == -1 ? FLT_MAX : best; }
+	bool done() const { return false; }
+
+	const Octree& octree;
+	Vector3 p;
+	float best;			// squared distance of index
+	int index = -1;
+};
+
+// PickQuery:  closest vertex to the eye inside a pick cone (see PickCone).
+//             boxes are visited nearest first and skipped once they are
+//             further than the best vertex
+//
+class PickQuery {
+public:
+	static const bool ordered = true;
+
+	PickQuery(const Octree& octree, const PickCone& cone) : octree(octree), cone(cone) { }
+
+	OctreeQuery::Result test(const TreeNode& node, float& key) const {
+		if (!cone.mayContain(node.box)) return OctreeQuery::Skip;
+		float d2 = 0;
+		for (int k = 0; k < 3; k++) {
+			float a = node.box.parameters[0][k] - cone.eye[k];
+			float b = cone.eye[k] - node.box.parameters[1][k];
+			float d = a > 0 ? a : (b > 0 ? b : 0);
+			d2 += d * d;
+		}
+		key = sqrtf(d2);
+		return key < dist ? OctreeQuery::Descend : OctreeQuery::Skip;
+	}
+	void leaf(const TreeNode& node) {
+		for (int i = 0; i < node.points.size(); i++) {
+			glm::vec3 v = octree.mesh.getVertex(node.points[i]);
+			Vector3 p = Vector3(v.x, v.y, v.z);
+			float d = (p - cone.eye).length();
+			if (d < dist && cone.inside(p)) {
+				dist = d;
+				index = node.points[i];
+			}
+		}
+	}
+	void whole(const TreeNode& /*node*/) { }
+	float bound() const { return dist; }
+	bool done() const { return false; }
+
+	const Octree& octree;
+	const PickCone& cone;
+	float dist = FLT_MAX;	// eye to index
+	int index = -1;
+};
+
+// CustomQuery:  policy from a node test (same signature as test() above)
+//               and a leaf action, usually lambdas:
+//
+//      auto q = makeOctreeQuery(
+//          [&](const TreeNode& n, float& key) { ... },
+//          [&](const TreeNode& n) { ... });
+//      traverseOctree(octree.root, q);
+//
+//  unordered, no whole subtrees (Whole is treated as Descend), never done
+//
+template <class NodeTest, class LeafAction>
+class CustomQuery {
+public:
+	static const bool ordered = false;
+
+	CustomQuery(NodeTest nodeTest, LeafAction leafAction) : nodeTest(nodeTest), leafAction(leafAction) { }
+
+	OctreeQuery::Result test(const TreeNode& node, float& key) {
+		return nodeTest(node, key) == OctreeQuery::Skip ? OctreeQuery::Skip : OctreeQuery::Descend;
+	}
+	void leaf(const TreeNode& node) { leafAction(node); }
+	void whole(const TreeNode& /*node*/) { }
+	float bound() const { return FLT_MAX; }
+	bool done() const { return false; }
+
+	NodeTest nodeTest;
+	LeafAction leafAction;
+};
+
+template <class NodeTest, class LeafAction>
+CustomQuery<NodeTest, LeafAction> makeOctreeQuery(NodeTest nodeTest, LeafAction leafAction) {
+	return CustomQuery<NodeTest, LeafAction>(nodeTest, leafAction);
+}
+
+// QueryStats:  counters for one thread's queries.  add() the threads'
+//              stats together once they are done
+//
+class QueryStats {
+public:
+	void clear() { queries = nodes = leaves = 0; }
+	void add(const QueryStats& s) {
+		queries += s.queries;
+		nodes += s.nodes;
+		leaves += s.leaves;
+	}
+
+	int64_t queries = 0;
+	int64_t nodes = 0;		// node tests
+	int64_t leaves = 0;		// leaves (and whole subtrees) visited
+};
+
+// CountedQuery:  policy wrapper that counts the work another policy does
+//                into a QueryStats
+//
+template <class Policy>
+class CountedQuery {
+public:
+	static const bool ordered = Policy::ordered;
+
+	CountedQuery(Policy& policy, QueryStats& stats) : policy(policy), stats(stats) { stats.queries++; }
+
+	OctreeQuery::Result test(const TreeNode& node, float& key) {
+		stats.nodes++;
+		return policy.test(node, key);
+	}
+	void leaf(const TreeNode& node) {
+		stats.leaves++;
+		policy.leaf(node);
+	}
+	void whole(const TreeNode& node) {
+		stats.leaves++;
+		policy.whole(node);
+	}
+	float bound() const { return policy.bound(); }
+	bool done() const { return policy.done(); }
+
+	Policy& policy;
+	QueryStats& stats;
+};
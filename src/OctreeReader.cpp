@@ -0,0 +1,56 @@
+//--------------------------------------------------------------
+//
+//  OctreeReader - one thread's read only view of a shared Octree
+//
+
+#include "OctreeReader.h"
+
+bool OctreeReader::closestHit(const Ray& ray, float t0, float t1, float& tRtn, int& faceRtn) {
+	RayClosestQuery q(octree, ray, t0, t1);
+	CountedQuery<RayClosestQuery> counted(q, stats);
+	traverseOctree(octree.root, counted);
+	if (q.face == -1) return false;
+	tRtn = q.t;
+	faceRtn = q.face;
+	return true;
+}
+
+bool OctreeReader::segmentBlocked(const Ray& ray, float t0, float t1) {
+	RayAnyQuery q(octree, ray, t0, t1);
+	CountedQuery<RayAnyQuery> counted(q, stats);
+	traverseOctree(octree.root, counted);
+	return q.hit;
+}
+
+const vector<int>& OctreeReader::pointsInBox(const Box& box) {
+	points.clear();
+	BoxPointsQuery q(octree, box, points);
+	CountedQuery<BoxPointsQuery> counted(q, stats);
+	traverseOctree(octree.root, counted);
+	return points;
+}
+
+const vector<int>& OctreeReader::pointsInSphere(const Vector3& center, float radius) {
+	points.clear();
+	SpherePointsQuery q(octree, center, radius, points);
+	CountedQuery<SpherePointsQuery> counted(q, stats);
+	traverseOctree(octree.root, counted);
+	return points;
+}
+
+const vector<int>& OctreeReader::pointsInFrustum(const Frustum& frustum) {
+	points.clear();
+	FrustumPointsQuery q(octree, frustum, points);
+	CountedQuery<FrustumPointsQuery> counted(q, stats);
+	traverseOctree(octree.root, counted);
+	return points;
+}
+
+// nearestPoint:  closest mesh vertex to p within maxDist, -1 if none
+//
+int OctreeReader::nearestPoint(const Vector3& p, float maxDist) {
+	NearestPointQuery q(octree, p, maxDist);
+	CountedQuery<NearestPointQuery> counted(q, stats);
+	traverseOctree(octree.root, counted);
+	return q.index;
+}
@@ -0,0 +1,34 @@
+//--------------------------------------------------------------
+//
+//  OctreeReader - one thread's read only view of a shared Octree
+//
+//  The Octree itself is only read (const), so any number of readers can
+//  query it at once (see the note on Octree).  What a query writes (the
+//  result list it builds and the work counters) lives in the reader, and
+//  every thread owns its own reader:
+//
+//      OctreeReader reader(octree);        // one per thread
+//      const vector<int>& pts = reader.pointsInBox(box);
+//
+//  Result references stay valid until the reader's next query.
+//
+#pragma once
+#include "ofMain.h"
+#include "Octree.h"
+#include "OctreeQuery.h"
+
+class OctreeReader {
+public:
+	OctreeReader(const Octree& octree) : octree(octree) { }
+
+	bool closestHit(const Ray& ray, float t0, float t1, float& tRtn, int& faceRtn);
+	bool segmentBlocked(const Ray& ray, float t0, float t1);
+	const vector<int>& pointsInBox(const Box& box);
+	const vector<int>& pointsInSphere(const Vector3& center, float radius);
+	const vector<int>& pointsInFrustum(const Frustum& frustum);
+	int nearestPoint(const Vector3& p, float maxDist);
+
+	const Octree& octree;
+	vector<int> points;		// scratch for point results
+	QueryStats stats;
+};
@@ -0,0 +1,564 @@
+//--------------------------------------------------------------
+//
+//  PagedOctree - out of core octree in a paged file
+//
+
+#include "PagedOctree.h"
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <sys/mman.h>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+static const uint32_t pagedVersion = 2;		// 2:  header.rootNode
+
+// leafBytes:  size of a leaf's data block
+//
+static size_t leafBytes(uint32_t numPoints, uint32_t numFaces) {
+	return numPoints * sizeof(PagedPoint) + numFaces * sizeof(PagedFace);
+}
+
+//--------------------------------------------------------------
+// PageCache
+//
+
+PageCache::~PageCache() {
+	close();
+}
+
+bool PageCache::open(const string& path, int pageSize, int maxPages) {
+	close();
+	this->pageSize = pageSize;
+	this->maxPages = maxPages;
+#ifdef _WIN32
+	file = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING,
+		FILE_ATTRIBUTE_NORMAL, NULL);
+	if (file == INVALID_HANDLE_VALUE) {
+		file = NULL;
+		return false;
+	}
+	mapping = CreateFileMappingA(file, NULL, PAGE_READONLY, 0, 0, NULL);
+	if (mapping == NULL) {
+		CloseHandle(file);
+		file = NULL;
+		return false;
+	}
+#else
+	fd = ::open(path.c_str(), O_RDONLY);
+	if (fd < 0) return false;
+#endif
+	clearStats();
+	return true;
+}
+
+void PageCache::close() {
+	for (auto& e : entries) unmap(e.second);
+	entries.clear();
+	lru.clear();
+	numMapped = 0;
+#ifdef _WIN32
+	if (mapping) CloseHandle(mapping);
+	if (file) CloseHandle(file);
+	mapping = NULL;
+	file = NULL;
+#else
+	if (fd >= 0) ::close(fd);
+	fd = -1;
+#endif
+}
+
+// get:  the first byte of pages page .. page + numPages - 1, mapping them
+//       if needed.  a run is always asked for by its first page with the
+//       same numPages.  the pointer is good until the next get() or
+//       prefetch(), which may unmap it
+//
+const char* PageCache::get(uint32_t page, uint32_t numPages) {
+	requests++;
+	auto it = entries.find(page);
+	if (it != entries.end()) {
+		Entry& e = it->second;
+		lru.splice(lru.begin(), lru, e.lru);
+		if (e.bPrefetched) {
+			prefetchHits++;
+			e.bPrefetched = false;
+		}
+		return e.data;
+	}
+	faults++;
+	Entry* e = map(page, numPages);
+	evict();
+	return e ? e->data : NULL;
+}
+
+// prefetch:  map the pages and ask the OS to start reading them, so a
+//            get() soon after finds them mapped and (with luck) in memory
+//
+void PageCache::prefetch(uint32_t page, uint32_t numPages) {
+	if (entries.find(page) != entries.end()) return;
+	Entry* e = map(page, numPages);
+	if (e == NULL) return;
+	e->bPrefetched = true;
+	prefetches += numPages;
+#ifndef _WIN32
+	madvise(e->data, (size_t)numPages * pageSize, MADV_WILLNEED);
+#endif
+	evict();
+}
+
+// dropOSCache:  unmap everything and have the OS drop the file from its
+//               page cache, so the next queries start cold (Linux only,
+//               used by the benchmark)
+//
+void PageCache::dropOSCache() {
+	for (auto& e : entries) unmap(e.second);
+	entries.clear();
+	lru.clear();
+	numMapped = 0;
+#ifndef _WIN32
+	if (fd < 0) return;
+	fdatasync(fd);
+	posix_fadvise(fd, 0, 0, POSIX_FADV_DONTNEED);
+#endif
+}
+
+void PageCache::clearStats() {
+	requests = 0;
+	faults = 0;
+	prefetches = 0;
+	prefetchHits = 0;
+	evictions = 0;
+}
+
+PageCache::Entry* PageCache::map(uint32_t page, uint32_t numPages) {
+	size_t bytes = (size_t)numPages * pageSize;
+	uint64_t offset = (uint64_t)page * pageSize;
+#ifdef _WIN32
+	void* data = MapViewOfFile(mapping, FILE_MAP_READ, (DWORD)(offset >> 32), (DWORD)offset, bytes);
+	if (data == NULL) return NULL;
+#else
+	void* data = mmap(NULL, bytes, PROT_READ, MAP_SHARED, fd, (off_t)offset);
+	if (data == MAP_FAILED) return NULL;
+#endif
+	lru.push_front(page);
+	Entry& e = entries[page];
+	e.data = (char*)data;
+	e.numPages = numPages;
+	e.bPrefetched = false;
+	e.lru = lru.begin();
+	numMapped += numPages;
+	return &e;
+}
+
+void PageCache::unmap(Entry& e) {
+#ifdef _WIN32
+	UnmapViewOfFile(e.data);
+#else
+	munmap(e.data, (size_t)e.numPages * pageSize);
+#endif
+	numMapped -= e.numPages;
+}
+
+// evict:  unmap least recently used runs until at most maxPages are
+//         mapped.  the most recent one stays even if it alone is bigger
+//
+void PageCache::evict() {
+	while (numMapped > maxPages && lru.size() > 1) {
+		auto it = entries.find(lru.back());
+		lru.pop_back();
+		unmap(it->second);
+		entries.erase(it);
+		evictions++;
+	}
+}
+
+//--------------------------------------------------------------
+// PagedOctreeWriter
+//
+
+bool PagedOctreeWriter::open(const string& path, int pageSize) {
+	file = fopen(path.c_str(), "wb");
+	if (file == NULL) return false;
+	memset(&header, 0, sizeof(header));
+	memcpy(header.magic, "PGOCTREE", 8);
+	header.version = pagedVersion;
+	header.pageSize = pageSize;
+	header.nodesPerPage = pageSize / sizeof(PagedNode);
+
+	// page 0 is filled in by close()
+	//
+	page.assign(pageSize, 0);
+	fwrite(page.data(), 1, pageSize, file);
+	nodeFile = tmpfile();
+	if (nodeFile == NULL) {
+		fclose(file);
+		file = NULL;
+		return false;
+	}
+	used = 0;
+	pageNumber = 1;
+	return true;
+}
+
+// addLeafData:  append a leaf's points and faces, set where they went in
+//               node (dataPage, dataOffset, numPoints, numFaces)
+//
+void PagedOctreeWriter::addLeafData(PagedNode& node, const vector<PagedPoint>& points,
+	const vector<PagedFace>& faces)
+{
+	int pageSize = header.pageSize;
+	node.numPoints = points.size();
+	node.numFaces = faces.size();
+	header.numPoints += points.size();
+	header.numFaces += faces.size();
+	size_t bytes = leafBytes(node.numPoints, node.numFaces);
+	if (bytes == 0) {
+		node.dataPage = 0;
+		node.dataOffset = 0;
+		return;
+	}
+	if (used + bytes > pageSize) flushPage();
+
+	if (bytes <= pageSize) {
+		node.dataPage = pageNumber;
+		node.dataOffset = used;
+		memcpy(&page[used], points.data(), points.size() * sizeof(PagedPoint));
+		memcpy(&page[used + points.size() * sizeof(PagedPoint)], faces.data(), faces.size() * sizeof(PagedFace));
+		used += bytes;
+		return;
+	}
+
+	// bigger than a page:  a run of its own pages
+	//
+	uint32_t numPages = (bytes + pageSize - 1) / pageSize;
+	node.dataPage = pageNumber;
+	node.dataOffset = 0;
+	fwrite(points.data(), sizeof(PagedPoint), points.size(), file);
+	fwrite(faces.data(), sizeof(PagedFace), faces.size(), file);
+	vector<char> pad(numPages * pageSize - bytes, 0);
+	fwrite(pad.data(), 1, pad.size(), file);
+	pageNumber += numPages;
+}
+
+void PagedOctreeWriter::flushPage() {
+	if (used == 0) return;
+	memset(&page[used], 0, page.size() - used);
+	fwrite(page.data(), 1, page.size(), file);
+	pageNumber++;
+	used = 0;
+}
+
+// addNodes:  append node records, numbered in the order they are added.
+//            returns the number of the first one
+//
+uint32_t PagedOctreeWriter::addNodes(const PagedNode* nodes, int numNodes) {
+	uint32_t first = header.numNodes;
+	fwrite(nodes, sizeof(PagedNode), numNodes, nodeFile);
+	header.numNodes += numNodes;
+	return first;
+}
+
+// close:  copy the node pages after the data and write the header in
+//         page 0
+//
+bool PagedOctreeWriter::close(const Box& bounds, uint32_t rootNode) {
+	if (file == NULL) return false;
+	flushPage();
+	header.firstNodePage = pageNumber;
+	header.rootNode = rootNode;
+	rewind(nodeFile);
+	for (uint32_t i = 0; i < header.numNodes; i += header.nodesPerPage) {
+		int n = min(header.nodesPerPage, header.numNodes - i);
+		memset(page.data(), 0, page.size());
+		if (fread(page.data(), sizeof(PagedNode), n, nodeFile) != n) break;
+		fwrite(page.data(), 1, page.size(), file);
+		pageNumber++;
+	}
+	fclose(nodeFile);
+	nodeFile = NULL;
+	header.numPages = pageNumber;
+	for (int k = 0; k < 3; k++) {
+		header.bounds[k] = bounds.parameters[0][k];
+		header.bounds[k + 3] = bounds.parameters[1][k];
+	}
+	fseek(file, 0, SEEK_SET);
+	fwrite(&header, sizeof(header), 1, file);
+	bool ok = !ferror(file) && pageNumber == header.firstNodePage +
+		(header.numNodes + header.nodesPerPage - 1) / header.nodesPerPage;
+	fclose(file);
+	file = NULL;
+	return ok;
+}
+
+// close:  with all the nodes at once, node 0 the root
+//
+bool PagedOctreeWriter::close(const vector<PagedNode>& nodes, const Box& bounds) {
+	if (file == NULL) return false;
+	addNodes(nodes.data(), nodes.size());
+	return close(bounds, 0);
+}
+
+//--------------------------------------------------------------
+// PagedOctree
+//
+
+static void setBox(float b[6], const Box& box) {
+	for (int k = 0; k < 3; k++) {
+		b[k] = box.parameters[0][k];
+		b[k + 3] = box.parameters[1][k];
+	}
+}
+
+// write:  octree (after create()) as a paged file.  nodes are stored
+//         breadth first so the children of a node are contiguous
+//
+bool PagedOctree::write(const Octree& octree, const string& path, int pageSize) {
+	PagedOctreeWriter writer;
+	if (!writer.open(path, pageSize)) return false;
+
+	vector<PagedNode> nodes(1);
+	vector<const TreeNode*> tree(1, &octree.root);
+	vector<PagedPoint> points;
+	vector<PagedFace> faces;
+	Vector3 v[3];
+	for (int n = 0; n < tree.size(); n++) {
+		const TreeNode& node = *tree[n];
+		PagedNode& rec = nodes[n];
+		memset(&rec, 0, sizeof(rec));
+		setBox(rec.box, node.box);
+		setBox(rec.faceBounds, node.faceBounds);
+		if (node.children.size() > 0) {
+			rec.firstChild = nodes.size();
+			rec.numChildren = node.children.size();
+			for (int i = 0; i < node.children.size(); i++) tree.push_back(&node.children[i]);
+			nodes.resize(nodes.size() + node.children.size());
+			continue;
+		}
+
+		points.resize(node.points.size());
+		for (int i = 0; i < node.points.size(); i++) {
+			glm::vec3 p = octree.mesh.getVertex(node.points[i]);
+			points[i].index = node.points[i];
+			points[i].p[0] = p.x;
+			points[i].p[1] = p.y;
+			points[i].p[2] = p.z;
+		}
+		faces.resize(node.faces.size());
+		for (int i = 0; i < node.faces.size(); i++) {
+			octree.getFaceVerts(node.faces[i], v);
+			faces[i].face = node.faces[i];
+			for (int k = 0; k < 3; k++) {
+				for (int j = 0; j < 3; j++) faces[i].v[k * 3 + j] = v[k][j];
+			}
+		}
+		writer.addLeafData(nodes[n], points, faces);
+	}
+	return writer.close(nodes, octree.root.box);
+}
+
+// open:  maxPages is the size of the working set, in pages
+//
+bool PagedOctree::open(const string& path, int maxPages) {
+	FILE* file = fopen(path.c_str(), "rb");
+	if (file == NULL) return false;
+	bool ok = fread(&header, sizeof(header), 1, file) == 1;
+	fclose(file);
+	if (!ok || memcmp(header.magic, "PGOCTREE", 8) != 0 || header.version != pagedVersion) {
+		cout << "PagedOctree: " << path << " is not a paged octree" << endl;
+		return false;
+	}
+	return cache.open(path, header.pageSize, maxPages);
+}
+
+void PagedOctree::getNode(uint32_t n, PagedNode& nodeRtn) {
+	uint32_t page = header.firstNodePage + n / header.nodesPerPage;
+	const char* data = cache.get(page);
+	memcpy(&nodeRtn, data + (n % header.nodesPerPage) * sizeof(PagedNode), sizeof(PagedNode));
+}
+
+// getChildren:  copy out the records of node's children, one page access
+//               per node page they are on
+//
+void PagedOctree::getChildren(const PagedNode& node, PagedNode childrenRtn[8]) {
+	uint32_t i = 0;
+	while (i < node.numChildren) {
+		uint32_t n = node.firstChild + i;
+		uint32_t slot = n % header.nodesPerPage;
+		uint32_t count = min(node.numChildren - i, header.nodesPerPage - slot);
+		const char* data = cache.get(header.firstNodePage + n / header.nodesPerPage);
+		memcpy(&childrenRtn[i], data + slot * sizeof(PagedNode), count * sizeof(PagedNode));
+		i += count;
+	}
+}
+
+static uint32_t leafPages(const PagedNode& node, uint32_t pageSize) {
+	size_t bytes = node.dataOffset + leafBytes(node.numPoints, node.numFaces);
+	return (bytes + pageSize - 1) / pageSize;
+}
+
+// getLeafData:  the leaf's points, followed by its faces.  good until the
+//               next page access
+//
+const char* PagedOctree::getLeafData(const PagedNode& node) {
+	return cache.get(node.dataPage, leafPages(node, header.pageSize)) + node.dataOffset;
+}
+
+// prefetch:  the page a query needs next if it goes into node:  its data
+//            for a leaf, else the page(s) holding its children
+//
+void PagedOctree::prefetch(const PagedNode& node) {
+	if (node.numChildren == 0) {
+		if (node.numPoints + node.numFaces > 0) cache.prefetch(node.dataPage, leafPages(node, header.pageSize));
+		return;
+	}
+	uint32_t first = node.firstChild / header.nodesPerPage;
+	uint32_t last = (node.firstChild + node.numChildren - 1) / header.nodesPerPage;
+	for (uint32_t p = first; p <= last; p++) cache.prefetch(header.firstNodePage + p);
+}
+
+// intersectClosest:  same as Octree::intersectClosest()
+//
+bool PagedOctree::intersectClosest(const Ray& ray, float t0, float t1, float& tRtn, int& faceRtn) {
+	tRtn = t1;
+	faceRtn = -1;
+	PagedNode root;
+	getNode(header.rootNode, root);
+	if (!root.getFaceBounds().intersect(ray, t0, t1)) return false;
+	intersectClosest(ray, t0, root, tRtn, faceRtn);
+	return faceRtn >= 0;
+}
+
+void PagedOctree::intersectClosest(const Ray& ray, float t0, const PagedNode& node, float& tRtn, int& faceRtn) {
+	if (node.numChildren == 0) {
+		const char* data = getLeafData(node);
+		const char* faceData = data + node.numPoints * sizeof(PagedPoint);
+		PagedFace f;
+		Vector3 v[3];
+		float t;
+		for (int i = 0; i < node.numFaces; i++) {
+			memcpy(&f, faceData + i * sizeof(PagedFace), sizeof(PagedFace));
+			for (int k = 0; k < 3; k++) v[k] = Vector3(f.v[k * 3], f.v[k * 3 + 1], f.v[k * 3 + 2]);
+			if (rayTriangle(ray.origin, ray.direction, v, t0, tRtn, t)) {
+				tRtn = t;
+				faceRtn = f.face;
+			}
+		}
+		return;
+	}
+
+	PagedNode children[8];
+	int order[8];
+	float tEnter[8];
+	int n = 0;
+	getChildren(node, children);
+	for (int i = 0; i < node.numChildren; i++) {
+		float tNear, tFar;
+		if (!children[i].getFaceBounds().intersect(ray, t0, tRtn, tNear, tFar)) continue;
+		int j = n++;
+		while (j > 0 && tEnter[j - 1] > tNear) {
+			tEnter[j] = tEnter[j - 1];
+			order[j] = order[j - 1];
+			j--;
+		}
+		tEnter[j] = tNear;
+		order[j] = i;
+	}
+	if (bPrefetch) {
+		for (int k = 0; k < n; k++) prefetch(children[order[k]]);
+	}
+	for (int k = 0; k < n; k++) {
+		if (tEnter[k] >= tRtn) break;
+		intersectClosest(ray, t0, children[order[k]], tRtn, faceRtn);
+	}
+}
+
+// intersectSegment:  same as Octree::intersectSegment(), true if the
+//                    segment a -> b is blocked
+//
+bool PagedOctree::intersectSegment(const Vector3& a, const Vector3& b) {
+	Ray ray = makeRay(a, b - a);
+	PagedNode root;
+	getNode(header.rootNode, root);
+	if (!root.getFaceBounds().intersect(ray, 0, 1)) return false;
+	return intersectSegment(ray, 0, 1, root);
+}
+
+bool PagedOctree::intersectSegment(const Ray& ray, float t0, float t1, const PagedNode& node) {
+	if (node.numChildren == 0) {
+		if (node.numFaces == 0) return true;
+
+		const char* data = getLeafData(node);
+		const char* faceData = data + node.numPoints * sizeof(PagedPoint);
+		PagedFace f;
+		Vector3 v[3];
+		float t;
+		for (int i = 0; i < node.numFaces; i++) {
+			memcpy(&f, faceData + i * sizeof(PagedFace), sizeof(PagedFace));
+			for (int k = 0; k < 3; k++) v[k] = Vector3(f.v[k * 3], f.v[k * 3 + 1], f.v[k * 3 + 2]);
+			if (rayTriangle(ray.origin, ray.direction, v, t0, t1, t)) return true;
+		}
+		return false;
+	}
+
+	PagedNode children[8];
+	int order[8];
+	float tEnter[8];
+	int n = 0;
+	getChildren(node, children);
+	for (int i = 0; i < node.numChildren; i++) {
+		float tNear, tFar;
+		if (!children[i].getFaceBounds().intersect(ray, t0, t1, tNear, tFar)) continue;
+		int j = n++;
+		while (j > 0 && tEnter[j - 1] > tNear) {
+			tEnter[j] = tEnter[j - 1];
+			order[j] = order[j - 1];
+			j--;
+		}
+		tEnter[j] = tNear;
+		order[j] = i;
+	}
+	if (bPrefetch) {
+		for (int k = 0; k < n; k++) prefetch(children[order[k]]);
+	}
+	for (int k = 0; k < n; k++) {
+		if (intersectSegment(ray, t0, t1, children[order[k]])) return true;
+	}
+	return false;
+}
+
+// getPointsInBox:  same as Octree::getPointsInBox(), sorted, each once
+//
+int PagedOctree::getPointsInBox(const Box& box, vector<int>& pointsRtn) {
+	int count = pointsRtn.size();
+	PagedNode root;
+	getNode(header.rootNode, root);
+	getPointsInBox(box, root, pointsRtn);
+	sort(pointsRtn.begin() + count, pointsRtn.end());
+	pointsRtn.erase(unique(pointsRtn.begin() + count, pointsRtn.end()), pointsRtn.end());
+	return pointsRtn.size() - count;
+}
+
+void PagedOctree::getPointsInBox(const Box& box, const PagedNode& node, vector<int>& pointsRtn) {
+	if (!node.getBox().overlap(box)) return;
+	if (node.numChildren == 0) {
+		const char* data = getLeafData(node);
+		PagedPoint p;
+		for (int i = 0; i < node.numPoints; i++) {
+			memcpy(&p, data + i * sizeof(PagedPoint), sizeof(PagedPoint));
+			if (box.inside(Vector3(p.p[0], p.p[1], p.p[2]))) pointsRtn.push_back(p.index);
+		}
+		return;
+	}
+
+	PagedNode children[8];
+	int n = 0;
+	getChildren(node, children);
+	for (int i = 0; i < node.numChildren; i++) {
+		if (children[i].getBox().overlap(box)) children[n++] = children[i];
+	}
+	if (bPrefetch) {
+		for (int k = 0; k < n; k++) prefetch(children[k]);
+	}
+	for (int k = 0; k < n; k++) getPointsInBox(box, children[k], pointsRtn);
+}
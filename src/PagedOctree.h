@@ -0,0 +1,180 @@
+//--------------------------------------------------------------
+//
+//  PagedOctree - out of core octree in a paged file
+//
+//  For terrains too big for Octree (which keeps the whole tree, the
+//  point lists and a copy of the mesh in memory).  The tree lives in a
+//  file of fixed size pages:
+//
+//      page 0          header (PagedHeader)
+//      data pages      per leaf:  its points (index + position) then its
+//                      faces (index + 3 vertices).  a leaf's data never
+//                      straddles a page unless it is bigger than a page,
+//                      then it gets a run of whole pages
+//      node pages      PagedNode records, children of a node stored
+//                      together, nodesPerPage to a page.  the root is
+//                      header.rootNode (0 from write(), last from a
+//                      bottom up build like StreamingOctreeBuilder)
+//
+//  Queries pull pages through a PageCache:  each page (or run) is
+//  mapped on first use (mmap, MapViewOfFile on Windows) and unmapped
+//  when the cache is over maxPages, least recently used first.  When a
+//  node is expanded the pages of its children are prefetched (mapped
+//  and the OS asked to read them ahead), since those are the ones a
+//  query visits next.
+//
+//  Queries give the same answers as the Octree the file was written
+//  from (PagedOctree::write()); node records are copied out of the
+//  pages, so nothing points into a page that may be unmapped.  Not
+//  thread safe (the cache changes on every query), open the file once
+//  per thread instead.
+//
+//  pageSize must be a multiple of the OS mapping granularity (4 KB on
+//  Linux, 64 KB on Windows); the default 64 KB works everywhere.
+//
+#pragma once
+#include "ofMain.h"
+#include "Octree.h"
+#include <list>
+#include <unordered_map>
+
+class PagedHeader {
+public:
+	char magic[8];			// "PGOCTREE"
+	uint32_t version;
+	uint32_t pageSize;
+	uint32_t numNodes;
+	uint32_t rootNode;
+	uint32_t nodesPerPage;
+	uint32_t firstNodePage;
+	uint32_t numPages;
+	uint64_t numPoints;		// leaf point records (boundary points are in more than one leaf)
+	uint64_t numFaces;		// leaf face records
+	float bounds[6];
+};
+
+class PagedNode {
+public:
+	float box[6];			// lo, hi:  the node's box (point queries)
+	float faceBounds[6];	// lo, hi:  around all faces below (ray queries)
+	uint32_t firstChild;	// node number, 0 for a leaf
+	uint32_t numChildren;
+	uint32_t numPoints;		// leaf data
+	uint32_t numFaces;
+	uint32_t dataPage;
+	uint32_t dataOffset;
+
+	Box getBox() const { return Box(Vector3(box[0], box[1], box[2]), Vector3(box[3], box[4], box[5])); }
+	Box getFaceBounds() const {
+		return Box(Vector3(faceBounds[0], faceBounds[1], faceBounds[2]), Vector3(faceBounds[3], faceBounds[4], faceBounds[5]));
+	}
+};
+
+class PagedPoint {
+public:
+	uint32_t index;
+	float p[3];
+};
+
+class PagedFace {
+public:
+	uint32_t face;
+	float v[9];
+};
+
+// PageCache:  bounded LRU set of mapped pages of one file
+//
+class PageCache {
+public:
+	~PageCache();
+
+	bool open(const string& path, int pageSize, int maxPages);
+	void close();
+	const char* get(uint32_t page, uint32_t numPages = 1);
+	void prefetch(uint32_t page, uint32_t numPages = 1);
+	void dropOSCache();
+	void clearStats();
+
+	int pageSize = 0;
+	int maxPages = 0;
+	int numMapped = 0;			// pages mapped now
+
+	int64_t requests = 0;		// get() calls
+	int64_t faults = 0;			// get() of a page that was not mapped
+	int64_t prefetches = 0;		// pages mapped by prefetch()
+	int64_t prefetchHits = 0;	// get() of a page prefetch() mapped
+	int64_t evictions = 0;
+
+private:
+	class Entry {
+	public:
+		char* data;
+		uint32_t numPages;
+		bool bPrefetched;
+		std::list<uint32_t>::iterator lru;
+	};
+
+	Entry* map(uint32_t page, uint32_t numPages);
+	void unmap(Entry& e);
+	void evict();
+
+	std::unordered_map<uint32_t, Entry> entries;
+	std::list<uint32_t> lru;		// most recently used first
+#ifdef _WIN32
+	void* file = NULL;
+	void* mapping = NULL;
+#else
+	int fd = -1;
+#endif
+};
+
+// PagedOctreeWriter:  leaf data is written as it comes, node records are
+// spooled to a temporary file and copied after the data by close(), so
+// neither has to be held in memory
+//
+class PagedOctreeWriter {
+public:
+	bool open(const string& path, int pageSize = 65536);
+	void addLeafData(PagedNode& node, const vector<PagedPoint>& points, const vector<PagedFace>& faces);
+	uint32_t addNodes(const PagedNode* nodes, int numNodes);
+	bool close(const Box& bounds, uint32_t rootNode);
+	bool close(const vector<PagedNode>& nodes, const Box& bounds);
+
+	PagedHeader header;
+
+private:
+	void flushPage();
+
+	FILE* file = NULL;
+	FILE* nodeFile = NULL;
+	vector<char> page;			// data page being filled
+	int used = 0;
+	uint32_t pageNumber = 1;	// page the buffer will be written to
+};
+
+class PagedOctree {
+public:
+	static bool write(const Octree& octree, const string& path, int pageSize = 65536);
+
+	bool open(const string& path, int maxPages = 256);
+	void close() { cache.close(); }
+
+	bool intersectClosest(const Ray& ray, float t0, float t1, float& tRtn, int& faceRtn);
+	bool intersectSegment(const Vector3& a, const Vector3& b);
+	int getPointsInBox(const Box& box, vector<int>& pointsRtn);
+
+	void getNode(uint32_t n, PagedNode& nodeRtn);
+	void getChildren(const PagedNode& node, PagedNode childrenRtn[8]);
+	void dropOSCache() { cache.dropOSCache(); }
+
+	PagedHeader header;
+	PageCache cache;
+	bool bPrefetch = true;
+
+private:
+	void intersectClosest(const Ray& ray, float t0, const PagedNode& node, float& tRtn, int& faceRtn);
+	bool intersectSegment(const Ray& ray, float t0, float t1, const PagedNode& node);
+	void getPointsInBox(const Box& box, const PagedNode& node, vector<int>& pointsRtn);
+	void prefetch(const PagedNode& node);
+	const char* getLeafData(const PagedNode& node);
+};
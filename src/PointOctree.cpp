@@ -0,0 +1,294 @@
+//--------------------------------------------------------------
+//
+//  PointOctree - compile time configurable point octree
+//
+
+#include "PointOctree.h"
+#include "TraversalStack.h"
+#include <algorithm>
+#include <limits>
+
+// create:  build over points.  a node is split while it has more than
+//          MaxLeaf points and is less than maxDepth deep
+//
+template <class Scalar, class Vec, class Index, int MaxLeaf>
+void PointOctree<Scalar, Vec, Index, MaxLeaf>::create(const vector<Vec>& pts, int maxDepth) {
+	if (pts.size() == 0) {
+		create(pts, Vec(0, 0, 0), Vec(0, 0, 0), maxDepth);
+		return;
+	}
+	Scalar lo[3], hi[3];
+	for (int k = 0; k < 3; k++) lo[k] = hi[k] = pts[0][k];
+	for (size_t i = 0; i < pts.size(); i++) {
+		for (int k = 0; k < 3; k++) {
+			lo[k] = std::min(lo[k], (Scalar)pts[i][k]);
+			hi[k] = std::max(hi[k], (Scalar)pts[i][k]);
+		}
+	}
+
+	// cube root box, so octants stay cubes
+	//
+	Scalar size = std::max(hi[0] - lo[0], std::max(hi[1] - lo[1], hi[2] - lo[2]));
+	create(pts, Vec(lo[0], lo[1], lo[2]), Vec(lo[0] + size, lo[1] + size, lo[2] + size), maxDepth);
+}
+
+// create:  build in the root box lo - hi, which has to hold the points
+//          (a cell of a bigger tree)
+//
+template <class Scalar, class Vec, class Index, int MaxLeaf>
+void PointOctree<Scalar, Vec, Index, MaxLeaf>::create(const vector<Vec>& pts, const Vec& lo, const Vec& hi, int maxDepth) {
+	nodes.clear();
+	order.resize(pts.size());
+	points.clear();
+	depth = 0;
+	if (pts.size() == 0) return;
+	for (size_t i = 0; i < pts.size(); i++) order[i] = (Index)i;
+
+	Node root;
+	root.lo = lo;
+	root.hi = hi;
+	root.begin = 0;
+	root.end = (Index)pts.size();
+	root.child = 0;
+	root.numChildren = 0;
+	nodes.push_back(root);
+
+	points = pts;
+	vector<Index> scratch(pts.size());
+	subdivide(0, 1, maxDepth, scratch);
+
+	for (size_t i = 0; i < order.size(); i++) points[i] = pts[order[i]];
+}
+
+// subdivide:  counting sort the node's points by octant, then make a child
+//             for every non empty octant
+//
+template <class Scalar, class Vec, class Index, int MaxLeaf>
+void PointOctree<Scalar, Vec, Index, MaxLeaf>::subdivide(int n, int level, int maxDepth, vector<Index>& scratch) {
+	if (level > depth) depth = level;
+	Index begin = nodes[n].begin;
+	Index end = nodes[n].end;
+	if (end - begin <= MaxLeaf || level >= maxDepth) return;
+
+	Vec lo = nodes[n].lo;
+	Vec hi = nodes[n].hi;
+	Scalar c[3];
+	for (int k = 0; k < 3; k++) c[k] = (lo[k] + hi[k]) / 2;
+
+	int count[8] = { 0 };
+	for (Index i = begin; i < end; i++) {
+		const Vec& p = points[order[i]];
+		int oct = (p[0] >= c[0]) | ((p[1] >= c[1]) << 1) | ((p[2] >= c[2]) << 2);
+		count[oct]++;
+	}
+	int start[8];
+	start[0] = begin;
+	for (int o = 1; o < 8; o++) start[o] = start[o - 1] + count[o - 1];
+	int fill[8];
+	for (int o = 0; o < 8; o++) fill[o] = start[o];
+	for (Index i = begin; i < end; i++) {
+		const Vec& p = points[order[i]];
+		int oct = (p[0] >= c[0]) | ((p[1] >= c[1]) << 1) | ((p[2] >= c[2]) << 2);
+		scratch[fill[oct]++] = order[i];
+	}
+	std::copy(scratch.begin() + begin, scratch.begin() + end, order.begin() + begin);
+
+	int first = nodes.size();
+	int numChildren = 0;
+	for (int o = 0; o < 8; o++) {
+		if (count[o] == 0) continue;
+		Node child;
+		child.lo = Vec((o & 1) ? c[0] : lo[0], (o & 2) ? c[1] : lo[1], (o & 4) ? c[2] : lo[2]);
+		child.hi = Vec((o & 1) ? hi[0] : c[0], (o & 2) ? hi[1] : c[1], (o & 4) ? hi[2] : c[2]);
+		child.begin = (Index)start[o];
+		child.end = (Index)(start[o] + count[o]);
+		child.child = 0;
+		child.numChildren = 0;
+		nodes.push_back(child);
+		numChildren++;
+	}
+	nodes[n].child = (Index)first;
+	nodes[n].numChildren = numChildren;
+	for (int i = 0; i < numChildren; i++) subdivide(first + i, level + 1, maxDepth, scratch);
+}
+
+template <class Scalar, class Vec, class Index, int MaxLeaf>
+int PointOctree<Scalar, Vec, Index, MaxLeaf>::getPointsInBox(const Vec& lo, const Vec& hi, vector<Index>& pointsRtn) const {
+	if (nodes.size() == 0) return 0;
+	int count = pointsRtn.size();
+	TraversalStack<int, 256> stack;
+	stack.push(0);
+	while (!stack.empty()) {
+		const Node& node = nodes[stack.pop()];
+		bool overlap = true, inside = true;
+		for (int k = 0; k < 3; k++) {
+			if (node.lo[k] > hi[k] || node.hi[k] < lo[k]) overlap = false;
+			if (node.lo[k] < lo[k] || node.hi[k] > hi[k]) inside = false;
+		}
+		if (!overlap) continue;
+		if (inside) {
+			pointsRtn.insert(pointsRtn.end(), order.begin() + node.begin, order.begin() + node.end);
+			continue;
+		}
+		if (node.numChildren == 0) {
+			for (Index i = node.begin; i < node.end; i++) {
+				const Vec& p = points[i];
+				if (p[0] >= lo[0] && p[0] <= hi[0] && p[1] >= lo[1] && p[1] <= hi[1] &&
+					p[2] >= lo[2] && p[2] <= hi[2]) pointsRtn.push_back(order[i]);
+			}
+			continue;
+		}
+		for (int i = 0; i < node.numChildren; i++) stack.push(node.child + i);
+	}
+	return pointsRtn.size() - count;
+}
+
+template <class Scalar, class Vec, class Index, int MaxLeaf>
+Scalar PointOctree<Scalar, Vec, Index, MaxLeaf>::boxDistance2(const Node& node, const Vec& p) {
+	Scalar d2 = 0;
+	for (int k = 0; k < 3; k++) {
+		Scalar d = std::max(std::max(node.lo[k] - p[k], p[k] - node.hi[k]), (Scalar)0);
+		d2 += d * d;
+	}
+	return d2;
+}
+
+// nearest:  closest point to p within maxDist, -1 if none.  children are
+//           visited nearest box first and skipped once their box is
+//           further than the best point
+//
+template <class Scalar, class Vec, class Index, int MaxLeaf>
+int PointOctree<Scalar, Vec, Index, MaxLeaf>::nearest(const Vec& p, Scalar maxDist) const {
+	if (nodes.size() == 0) return -1;
+	Scalar best = maxDist * maxDist;
+	int bestIndex = -1;
+	struct Entry { int node; Scalar d; };
+	TraversalStack<Entry, 256> stack;
+	stack.push({ 0, boxDistance2(nodes[0], p) });
+	while (!stack.empty()) {
+		Entry e = stack.pop();
+		if (e.d > best) continue;
+		const Node& node = nodes[e.node];
+		if (node.numChildren == 0) {
+			for (Index i = node.begin; i < node.end; i++) {
+				Scalar d2 = 0;
+				for (int k = 0; k < 3; k++) {
+					Scalar d = points[i][k] - p[k];
+					d2 += d * d;
+				}
+				if (d2 <= best) {
+					best = d2;
+					bestIndex = order[i];
+				}
+			}
+			continue;
+		}
+
+		// push furthest first so the nearest child is popped next
+		//
+		int c[8];
+		Scalar d[8];
+		int n = node.numChildren;
+		for (int i = 0; i < n; i++) {
+			c[i] = node.child + i;
+			d[i] = boxDistance2(nodes[c[i]], p);
+			for (int j = i; j > 0 && d[j] > d[j - 1]; j--) {
+				std::swap(d[j], d[j - 1]);
+				std::swap(c[j], c[j - 1]);
+			}
+		}
+		for (int i = 0; i < n; i++) {
+			if (d[i] > best) continue;
+			stack.push({ c[i], d[i] });
+		}
+	}
+	return bestIndex;
+}
+
+// rayBox:  slab test of the node box grown by pad against a ray
+//
+template <class Scalar, class Vec, class Index, int MaxLeaf>
+bool PointOctree<Scalar, Vec, Index, MaxLeaf>::rayBox(const Node& node, Scalar pad, const Vec& origin,
+	const Vec& invDir, Scalar tMax, Scalar& tNear)
+{
+	Scalar t0 = 0, t1 = tMax;
+	for (int k = 0; k < 3; k++) {
+		Scalar a = (node.lo[k] - pad - origin[k]) * invDir[k];
+		Scalar b = (node.hi[k] + pad - origin[k]) * invDir[k];
+		if (a > b) std::swap(a, b);
+		if (a > t0) t0 = a;
+		if (b < t1) t1 = b;
+		if (t0 > t1) return false;
+	}
+	tNear = t0;
+	return true;
+}
+
+// pick:  point closest to the origin along the ray (dir unit length) that
+//        is within radius of it.  returns point index or -1, distance along
+//        the ray in tRtn
+//
+template <class Scalar, class Vec, class Index, int MaxLeaf>
+int PointOctree<Scalar, Vec, Index, MaxLeaf>::pick(const Vec& origin, const Vec& dir, Scalar radius, Scalar& tRtn) const {
+	if (nodes.size() == 0) return -1;
+	const Scalar tiny = (Scalar)1e-30;
+	Vec invDir = Vec(1 / (dir[0] == 0 ? tiny : dir[0]), 1 / (dir[1] == 0 ? tiny : dir[1]),
+		1 / (dir[2] == 0 ? tiny : dir[2]));
+	Scalar best = std::numeric_limits<Scalar>::max();
+	int bestIndex = -1;
+	Scalar r2 = radius * radius;
+
+	struct Entry { int node; Scalar t; };
+	TraversalStack<Entry, 256> stack;
+	Scalar tNear;
+	if (!rayBox(nodes[0], radius, origin, invDir, best, tNear)) return -1;
+	stack.push({ 0, tNear });
+	while (!stack.empty()) {
+		Entry e = stack.pop();
+		if (e.t > best) continue;
+		const Node& node = nodes[e.node];
+		if (node.numChildren == 0) {
+			for (Index i = node.begin; i < node.end; i++) {
+				Scalar v[3];
+				Scalar t = 0, len2 = 0;
+				for (int k = 0; k < 3; k++) {
+					v[k] = points[i][k] - origin[k];
+					t += v[k] * dir[k];
+					len2 += v[k] * v[k];
+				}
+				if (t < 0 || t >= best) continue;
+				if (len2 - t * t <= r2) {
+					best = t;
+					bestIndex = order[i];
+				}
+			}
+			continue;
+		}
+		int c[8];
+		Scalar ct[8];
+		int n = 0;
+		for (int i = 0; i < node.numChildren; i++) {
+			if (!rayBox(nodes[node.child + i], radius, origin, invDir, best, tNear)) continue;
+			c[n] = node.child + i;
+			ct[n] = tNear;
+			for (int j = n; j > 0 && ct[j] > ct[j - 1]; j--) {
+				std::swap(ct[j], ct[j - 1]);
+				std::swap(c[j], c[j - 1]);
+			}
+			n++;
+		}
+		for (int i = 0; i < n; i++) stack.push({ c[i], ct[i] });
+	}
+	tRtn = best;
+	return bestIndex;
+}
+
+// configurations used by the benchmarks (OctreeBench) and the streaming
+// build (StreamingOctreeBuilder::BucketTree)
+//
+template class PointOctree<float, Vector3, uint32_t, 8>;
+template class PointOctree<double, Vector3d, uint32_t, 8>;
+template class PointOctree<float, Vector3, uint32_t, 1>;
+template class PointOctree<float, Vector3, uint16_t, 8>;
+template class PointOctree<float, Vector3, uint32_t, 32>;
+template class PointOctree<double, Vector3d, uint32_t, 32>;
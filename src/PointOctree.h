@@ -0,0 +1,69 @@
+//--------------------------------------------------------------
+//
+//  PointOctree - compile time configurable point octree
+//
+//  The same kind of point octree as Octree, without openFrameworks,
+//  templated on:
+//
+//      Scalar   - float or double.  double keeps precision for terrain
+//                 far from the origin (planet scale coordinates)
+//      Vec      - point type, needs Vec(x, y, z) and operator[] (const)
+//      Index    - integer type of point and node indices (uint16_t for
+//                 small sets halves the index memory, it must hold the
+//                 number of points and of nodes)
+//      MaxLeaf  - points a leaf may hold before it is split
+//
+//  Nodes live in one array, children of a node are stored together and
+//  the points of every subtree are contiguous in the point order, so a
+//  node fully inside a query box is taken as one range.
+//
+//  StreamingOctreeBuilder builds each bucket's subtree with one, in the
+//  bucket's cell (the create() that takes the root box).
+//
+//  Member templates are defined in PointOctree.cpp and instantiated
+//  there for the configurations below; add a line there for new ones.
+//
+#pragma once
+#include <vector>
+#include <stdint.h>
+#include "vector3.h"
+
+using std::vector;
+
+template <class Scalar, class Vec, class Index, int MaxLeaf>
+class PointOctree {
+public:
+	class Node {
+	public:
+		Vec lo, hi;			// box
+		Index begin, end;	// points of the subtree: order[begin .. end-1]
+		Index child;		// first child node, children are contiguous
+		unsigned char numChildren;
+	};
+
+	void create(const vector<Vec>& points, int maxDepth = 20);
+	void create(const vector<Vec>& points, const Vec& lo, const Vec& hi, int maxDepth = 20);
+
+	// queries return indices into the points given to create()
+	//
+	int getPointsInBox(const Vec& lo, const Vec& hi, vector<Index>& pointsRtn) const;
+	int nearest(const Vec& p, Scalar maxDist) const;
+	int pick(const Vec& origin, const Vec& dir, Scalar radius, Scalar& tRtn) const;
+
+	int getNumNodes() const { return nodes.size(); }
+	int getDepth() const { return depth; }
+
+	vector<Node> nodes;
+	vector<Index> order;		// point indices, grouped by node
+	vector<Vec> points;			// copy of the points, in order
+	int depth = 0;
+
+private:
+	void subdivide(int node, int level, int maxDepth, vector<Index>& scratch);
+	static Scalar boxDistance2(const Node& node, const Vec& p);
+	static bool rayBox(const Node& node, Scalar pad, const Vec& origin, const Vec& invDir,
+		Scalar tMax, Scalar& tNear);
+};
+
+typedef PointOctree<float, Vector3, uint32_t, 8> PointOctreef;
+typedef PointOctree<double, Vector3d, uint32_t, 8> PointOctreed;
@@ -0,0 +1,368 @@
+//--------------------------------------------------------------
+//
+//  QueryServer - terrain queries for other processes, over shared memory
+//
+
+#include "QueryServer.h"
+#include "OctreeReader.h"
+#ifdef __linux__
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include <linux/futex.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <climits>
+#endif
+
+static const uint32_t serverMagic = 0x4c514d53;		// "SMQL"
+static const uint32_t serverVersion = 1;
+static const int spinCount = (std::thread::hardware_concurrency() > 1) ? 4000 : 0;	// spinning on one core only delays the other side
+
+#ifdef __linux__
+
+// futexWait:  sleep while *word == value (or until timeoutMs passes)
+//
+static void futexWait(std::atomic<uint32_t>* word, uint32_t value, int timeoutMs) {
+	struct timespec timeout;
+	timeout.tv_sec = timeoutMs / 1000;
+	timeout.tv_nsec = (timeoutMs % 1000) * 1000000L;
+	syscall(SYS_futex, (uint32_t*)word, FUTEX_WAIT, value, &timeout, NULL, 0);
+}
+
+static void futexWake(std::atomic<uint32_t>* word, int count) {
+	syscall(SYS_futex, (uint32_t*)word, FUTEX_WAKE, count, NULL, NULL, 0);
+}
+
+static size_t serverSize(int numSlots) {
+	return sizeof(ServerHeader) + numSlots * sizeof(ServerSlot);
+}
+
+static inline void spinPause() {
+#if defined(__x86_64__) || defined(__i386__)
+	__builtin_ia32_pause();
+#endif
+}
+
+//--------------------------------------------------------------
+// QueryServer
+//
+
+QueryServer::~QueryServer() {
+	stop();
+}
+
+// start:  create the shared block (replacing one left by a server that
+//         died) and answer from a thread of its own
+//
+bool QueryServer::start(shared_ptr<Terrain> terrain, const string& name, int numSlots) {
+	stop();
+	int n = 1;
+	while (n < numSlots && n < ServerHeader::maxSlots) n *= 2;
+	numSlots = n;
+
+	int fd = shm_open(name.c_str(), O_CREAT | O_RDWR, 0600);
+	if (fd < 0) {
+		cout << "QueryServer: can't create " << name << endl;
+		return false;
+	}
+	size = serverSize(numSlots);
+	bool ok = ftruncate(fd, 0) == 0 && ftruncate(fd, size) == 0;
+	void* data = ok ? mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0) : MAP_FAILED;
+	::close(fd);
+	if (data == MAP_FAILED) {
+		cout << "QueryServer: can't map " << name << endl;
+		shm_unlink(name.c_str());
+		return false;
+	}
+
+	this->terrain = terrain;
+	this->name = name;
+	memset(data, 0, size);
+	header = new (data) ServerHeader();
+	slots = (ServerSlot*)((char*)data + sizeof(ServerHeader));
+	for (int i = 0; i < numSlots; i++) new (&slots[i]) ServerSlot();
+	header->magic = serverMagic;
+	header->version = serverVersion;
+	header->numSlots = numSlots;
+	header->numVertices = terrain->octree.mesh.getNumVertices();
+	for (int k = 0; k < 3; k++) {
+		header->bounds[k] = terrain->octree.root.box.parameters[0][k];
+		header->bounds[k + 3] = terrain->octree.root.box.parameters[1][k];
+	}
+	header->running = 1;
+
+	bStop = false;
+	numRequests = numSleeps = 0;
+	thread = std::thread(&QueryServer::run, this);
+	return true;
+}
+
+// stop:  clients waiting on an answer get a failure
+//
+void QueryServer::stop() {
+	if (header == NULL) return;
+	bStop = true;
+	thread.join();
+	header->running = 0;
+	for (int i = 0; i < header->numSlots; i++) futexWake(&slots[i].state, INT_MAX);
+	munmap(header, size);
+	shm_unlink(name.c_str());
+	header = NULL;
+	slots = NULL;
+	terrain.reset();
+}
+
+// run:  server thread.  takes the ring in order, sleeping on the next
+//       entry when there is nothing to do
+//
+void QueryServer::run() {
+	OctreeReader reader(terrain->octree);
+	uint32_t mask = header->numSlots - 1;
+	while (!bStop) {
+		uint32_t pos = header->tail.load(std::memory_order_relaxed);
+		std::atomic<uint32_t>& entry = header->ring[pos & mask];
+		uint32_t v = entry.load(std::memory_order_acquire);
+		for (int spin = 0; v == 0 && spin < spinCount; spin++) {
+			spinPause();
+			v = entry.load(std::memory_order_acquire);
+		}
+		if (v == 0) {
+			header->sleeping = 1;
+			if (entry.load() == 0) {
+				numSleeps++;
+				futexWait(&entry, 0, 100);
+			}
+			header->sleeping = 0;
+			continue;
+		}
+		entry.store(0, std::memory_order_relaxed);
+		header->tail.store(pos + 1, std::memory_order_relaxed);
+
+		ServerSlot& slot = slots[v - 1];
+		execute(slot, reader);
+		numRequests++;
+		slot.state.store(ServerSlot::Done);
+		if (slot.waiting.load()) futexWake(&slot.state, 1);
+	}
+}
+
+void QueryServer::execute(ServerSlot& slot, OctreeReader& reader) {
+	const float* a = slot.args;
+	slot.hit = 0;
+	slot.numPoints = 0;
+	slot.truncated = 0;
+	switch (slot.type) {
+	case ServerSlot::Closest:
+	case ServerSlot::Any:
+	{
+		Ray ray = makeRay(Vector3(a[0], a[1], a[2]), Vector3(a[3], a[4], a[5]));
+		if (slot.type == ServerSlot::Any) {
+			slot.hit = terrain->index->intersectAny(ray, a[6], a[7]);
+			break;
+		}
+		RayHit hit;
+		slot.hit = terrain->index->intersectRay(ray, a[6], a[7], hit);
+		slot.t = hit.t;
+		slot.face = hit.face;
+		break;
+	}
+	case ServerSlot::Points:
+	{
+		const vector<int>& points = reader.pointsInBox(Box(Vector3(a[0], a[1], a[2]), Vector3(a[3], a[4], a[5])));
+		int n = min((int)points.size(), ServerSlot::maxPoints);
+		memcpy(slot.points, points.data(), n * sizeof(int32_t));
+		slot.numPoints = n;
+		slot.truncated = points.size() > n;
+		slot.hit = n > 0;
+		break;
+	}
+	case ServerSlot::Nearest:
+		slot.face = reader.nearestPoint(Vector3(a[0], a[1], a[2]), a[3]);
+		slot.hit = slot.face != -1;
+		break;
+	}
+}
+
+//--------------------------------------------------------------
+// QueryClient
+//
+
+// open:  map the server's block and take a free slot
+//
+bool QueryClient::open(const string& name) {
+	close();
+	int fd = shm_open(name.c_str(), O_RDWR, 0600);
+	if (fd < 0) return false;
+	struct stat st;
+	void* data = MAP_FAILED;
+	if (fstat(fd, &st) == 0 && st.st_size >= sizeof(ServerHeader)) {
+		data = mmap(NULL, st.st_size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+	}
+	::close(fd);
+	if (data == MAP_FAILED) return false;
+	header = (ServerHeader*)data;
+	size = st.st_size;
+	if (header->magic != serverMagic || header->version != serverVersion || !header->running ||
+		size < serverSize(header->numSlots))
+	{
+		close();
+		return false;
+	}
+
+	ServerSlot* slots = (ServerSlot*)((char*)data + sizeof(ServerHeader));
+	for (int i = 0; i < header->numSlots; i++) {
+		uint32_t expected = ServerSlot::Free;
+		if (slots[i].state.compare_exchange_strong(expected, ServerSlot::Idle)) {
+			slot = &slots[i];
+			slotNumber = i;
+			break;
+		}
+	}
+	if (slot == NULL) {
+		cout << "QueryClient: all " << header->numSlots << " server slots are taken" << endl;
+		close();
+		return false;
+	}
+	bFailed = false;
+	return true;
+}
+
+void QueryClient::close() {
+	if (slot) slot->state = ServerSlot::Free;
+	if (header) munmap(header, size);
+	header = NULL;
+	slot = NULL;
+	slotNumber = -1;
+}
+
+// call:  submit the request in the slot and wait for the answer.  false
+//        if the server stopped
+//
+bool QueryClient::call() {
+	if (slot == NULL || bFailed) return false;
+	slot->state.store(ServerSlot::Request);
+	uint32_t pos = header->head.fetch_add(1);
+	std::atomic<uint32_t>& entry = header->ring[pos & (header->numSlots - 1)];
+	entry.store(slotNumber + 1);
+	if (header->sleeping.load()) futexWake(&entry, 1);
+
+	for (int spin = 0; spin < spinCount; spin++) {
+		if (slot->state.load(std::memory_order_acquire) == ServerSlot::Done) break;
+		spinPause();
+	}
+	while (slot->state.load(std::memory_order_acquire) != ServerSlot::Done) {
+		if (!header->running) {
+			bFailed = true;
+			return false;
+		}
+		slot->waiting = 1;
+		if (slot->state.load() != ServerSlot::Done) futexWait(&slot->state, ServerSlot::Request, 100);
+		slot->waiting = 0;
+	}
+	slot->state.store(ServerSlot::Idle, std::memory_order_relaxed);
+	return true;
+}
+
+static void setArgs(float* args, const Vector3& a, const Vector3& b) {
+	for (int k = 0; k < 3; k++) {
+		args[k] = a[k];
+		args[k + 3] = b[k];
+	}
+}
+
+bool QueryClient::closest(const Ray& ray, float t0, float t1, float& tRtn, int& faceRtn) {
+	if (slot == NULL) return false;
+	slot->type = ServerSlot::Closest;
+	setArgs(slot->args, ray.origin, ray.direction);
+	slot->args[6] = t0;
+	slot->args[7] = t1;
+	if (!call() || !slot->hit) return false;
+	tRtn = slot->t;
+	faceRtn = slot->face;
+	return true;
+}
+
+bool QueryClient::blocked(const Ray& ray, float t0, float t1) {
+	if (slot == NULL) return false;
+	slot->type = ServerSlot::Any;
+	setArgs(slot->args, ray.origin, ray.direction);
+	slot->args[6] = t0;
+	slot->args[7] = t1;
+	return call() && slot->hit;
+}
+
+// pointsInBox:  pointsRtn points into the shared block, good until the
+//               next query
+//
+int QueryClient::pointsInBox(const Box& box, const int*& pointsRtn) {
+	pointsRtn = NULL;
+	if (slot == NULL) return 0;
+	slot->type = ServerSlot::Points;
+	setArgs(slot->args, box.min(), box.max());
+	if (!call()) return 0;
+	bTruncated = slot->truncated;
+	pointsRtn = slot->points;
+	return slot->numPoints;
+}
+
+int QueryClient::nearest(const Vector3& p, float radius) {
+	if (slot == NULL) return -1;
+	slot->type = ServerSlot::Nearest;
+	setArgs(slot->args, p, Vector3(radius, 0, 0));
+	if (!call()) return -1;
+	return slot->face;
+}
+
+Box QueryClient::bounds() const {
+	if (header == NULL) return Box();
+	const float* b = header->bounds;
+	return Box(Vector3(b[0], b[1], b[2]), Vector3(b[3], b[4], b[5]));
+}
+
+#else
+
+// shared memory and futexes are Linux only here
+
+QueryServer::~QueryServer() { }
+
+bool QueryServer::start(shared_ptr<Terrain> terrain, const string& name, int numSlots) {
+	cout << "QueryServer: only available on Linux" << endl;
+	return false;
+}
+
+void QueryServer::stop() { }
+void QueryServer::run() { }
+void QueryServer::execute(ServerSlot& slot, OctreeReader& reader) { }
+
+bool QueryClient::open(const string& name) { return false; }
+void QueryClient::close() { }
+bool QueryClient::call() { return false; }
+bool QueryClient::closest(const Ray& ray, float t0, float t1, float& tRtn, int& faceRtn) { return false; }
+bool QueryClient::blocked(const Ray& ray, float t0, float t1) { return false; }
+int QueryClient::pointsInBox(const Box& box, const int*& pointsRtn) { pointsRtn = NULL; return 0; }
+int QueryClient::nearest(const Vector3& p, float radius) { return -1; }
+Box QueryClient::bounds() const { return Box(); }
+
+#endif
+
+// runQueryServer:  server mode (no window):  build the terrain at
+//                  terrainPath (data path relative OBJ) and answer until
+//                  enter is pressed or stdin closes
+//
+int runQueryServer(const string& terrainPath) {
+	shared_ptr<Terrain> terrain = make_shared<Terrain>();
+	if (!terrain->load(terrainPath)) {
+		cout << "query server: can't load " << terrainPath << endl;
+		return 1;
+	}
+	QueryServer server;
+	if (!server.start(terrain)) return 1;
+	cout << "query server: " << terrainPath << " (" << terrain->octree.mesh.getNumVertices() << " vertices, built in "
+		<< terrain->buildTime << " ms) at " << defaultQueryServerName << ", enter to stop" << endl;
+	string line;
+	getline(cin, line);
+	server.stop();
+	cout << "query server: " << server.numRequests << " requests answered" << endl;
+	return 0;
+}
@@ -0,0 +1,118 @@
+//--------------------------------------------------------------
+//
+//  QueryServer - terrain queries for other processes, over shared memory
+//
+//  The autopilot and analysis tools run as processes of their own.  A
+//  QueryServer builds the terrain once and answers their ray, segment,
+//  box and nearest point queries through a shared memory block (Linux,
+//  POSIX shm), so a client neither loads the terrain nor copies results
+//  through a socket:
+//
+//      header      ring of submitted slot numbers, counters
+//      slots       one per client:  request arguments in, results out
+//                  (point lists are written straight into the slot)
+//
+//  A client owns a slot for as long as it is open.  To ask, it fills in
+//  the slot, appends the slot number to the ring and waits for the slot
+//  state to become Done; the server thread takes ring entries in order.
+//  Both sides spin briefly and then sleep on a futex on the word they
+//  wait for, and only make the wake up call when the other side is
+//  asleep, so a busy server answers without a system call.  (eventfd
+//  would need its descriptors passed over a socket, futexes work on the
+//  shared mapping directly.)
+//
+//  Run a server with "--query-server [terrain.obj]" on the command line
+//  (see main.cpp), and time it with "--query-client".  Each client
+//  thread needs its own QueryClient.
+//
+#pragma once
+#include "ofMain.h"
+#include "Terrain.h"
+#include <atomic>
+#include <thread>
+
+static const char* const defaultQueryServerName = "/lander_terrain_queries";
+
+class ServerSlot {
+public:
+	enum State { Free, Idle, Request, Done };
+	enum Type { Closest, Any, Points, Nearest };
+	static const int maxPoints = 4096;
+
+	std::atomic<uint32_t> state;
+	std::atomic<uint32_t> waiting;		// client is asleep on state
+	uint32_t type;
+	float args[8];						// ray (origin, direction, t0, t1), box (lo, hi), point + radius
+	int32_t hit;
+	float t;
+	int32_t face;						// Closest:  face, Nearest:  vertex
+	uint32_t numPoints;
+	uint32_t truncated;					// more than maxPoints in the box
+	int32_t points[maxPoints];
+};
+
+class ServerHeader {
+public:
+	static const int maxSlots = 256;
+
+	uint32_t magic;
+	uint32_t version;
+	uint32_t numSlots;					// a power of 2
+	uint32_t numVertices;
+	float bounds[6];
+	std::atomic<uint32_t> running;
+	std::atomic<uint32_t> sleeping;		// server is asleep on ring[tail]
+	std::atomic<uint32_t> head;			// next ring entry to fill
+	std::atomic<uint32_t> tail;			// next ring entry the server takes
+	std::atomic<uint32_t> ring[maxSlots];	// slot + 1, 0 for empty
+};
+
+class QueryServer {
+public:
+	~QueryServer();
+
+	bool start(shared_ptr<Terrain> terrain, const string& name = defaultQueryServerName, int numSlots = 64);
+	void stop();
+
+	int64_t numRequests = 0;
+	int64_t numSleeps = 0;		// times the server went to sleep waiting for work
+
+private:
+	void run();
+	void execute(ServerSlot& slot, class OctreeReader& reader);
+
+	shared_ptr<Terrain> terrain;
+	string name;
+	ServerHeader* header = NULL;
+	ServerSlot* slots = NULL;
+	size_t size = 0;
+	std::thread thread;
+	std::atomic<bool> bStop;
+};
+
+class QueryClient {
+public:
+	~QueryClient() { close(); }
+
+	bool open(const string& name = defaultQueryServerName);
+	void close();
+
+	bool closest(const Ray& ray, float t0, float t1, float& tRtn, int& faceRtn);
+	bool blocked(const Ray& ray, float t0, float t1);
+	int pointsInBox(const Box& box, const int*& pointsRtn);
+	int nearest(const Vector3& p, float radius);
+	Box bounds() const;			// the server's terrain
+
+	bool bTruncated = false;	// last pointsInBox() had more than ServerSlot::maxPoints
+	bool bFailed = false;		// the server went away
+
+private:
+	bool call();
+
+	ServerHeader* header = NULL;
+	ServerSlot* slot = NULL;
+	int slotNumber = -1;
+	size_t size = 0;
+};
+
+int runQueryServer(const string& terrainPath);
@@ -0,0 +1,267 @@
+//--------------------------------------------------------------
+//
+//  QueryService - terrain queries answered on worker threads
+//
+
+#include "QueryService.h"
+
+QueryRequest QueryRequest::closest(const Ray& ray, float t0, float t1) {
+	QueryRequest r;
+	r.type = Closest;
+	r.ray = ray;
+	r.t0 = t0;
+	r.t1 = t1;
+	return r;
+}
+
+QueryRequest QueryRequest::any(const Ray& ray, float t0, float t1) {
+	QueryRequest r = closest(ray, t0, t1);
+	r.type = Any;
+	return r;
+}
+
+QueryRequest QueryRequest::leaves(const Box& box) {
+	QueryRequest r;
+	r.type = Leaves;
+	r.box = box;
+	return r;
+}
+
+QueryRequest QueryRequest::points(const Box& box) {
+	QueryRequest r = leaves(box);
+	r.type = Points;
+	return r;
+}
+
+QueryRequest QueryRequest::nearest(const Vector3& point, float radius) {
+	QueryRequest r;
+	r.type = Nearest;
+	r.point = point;
+	r.radius = radius;
+	return r;
+}
+
+QueryRequest QueryRequest::pick(const Ray& ray, float radius) {
+	QueryRequest r = closest(ray);
+	r.type = Pick;
+	r.radius = radius;
+	return r;
+}
+
+QueryService::~QueryService() {
+	stop();
+}
+
+void QueryService::start(shared_ptr<Terrain> terrain, int numThreads) {
+	stop();
+	setTerrain(terrain);
+	if (numThreads <= 0) numThreads = (int)std::thread::hardware_concurrency() - 1;
+	if (numThreads < 1) numThreads = 1;
+	bStop = false;
+	int numNodes = bReplicate ? NumaTopology::get().numNodes() : 0;
+	for (int i = 0; i < numThreads; i++) {
+		workers.push_back(std::thread(&QueryService::work, this, (numNodes > 0) ? i % numNodes : -1));
+	}
+}
+
+// stop:  answer everything submitted, then end the workers
+//
+void QueryService::stop() {
+	if (workers.size() == 0) return;
+	drain();
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		bStop = true;
+	}
+	workReady.notify_all();
+	for (int i = 0; i < workers.size(); i++) workers[i].join();
+	workers.clear();
+	replicas.clear();
+}
+
+// setTerrain:  the version batches started from now on query.  batches
+//              already running finish on the version they started with
+//
+void QueryService::setTerrain(shared_ptr<Terrain> terrain) {
+	std::atomic_store(&this->terrain, terrain);
+}
+
+// setTiles:  streamed tiles the batches started from now on also query
+//
+void QueryService::setTiles(shared_ptr<const TileList> tiles) {
+	std::atomic_store(&this->tiles, tiles);
+}
+
+std::future<QueryResult> QueryService::submit(const QueryRequest& request) {
+	Job* job = new Job();
+	job->request = request;
+	std::future<QueryResult> future = job->promise.get_future();
+	add(job);
+	return future;
+}
+
+// submit:  callback is run by deliver(), on the thread that calls it
+//
+void QueryService::submit(const QueryRequest& request, std::function<void(const QueryResult&)> callback) {
+	Job* job = new Job();
+	job->request = request;
+	job->callback = callback;
+	add(job);
+}
+
+void QueryService::add(Job* job) {
+	std::lock_guard<std::mutex> lock(mutex);
+	pending.push_back(job);
+	inFlight++;
+	numSubmitted++;
+	if (pending.size() >= batchSize) flushLocked();
+}
+
+// flush:  hand the pending requests to the workers now, rather than
+//         waiting for a full batch
+//
+void QueryService::flush() {
+	std::lock_guard<std::mutex> lock(mutex);
+	flushLocked();
+}
+
+void QueryService::flushLocked() {
+	if (pending.size() == 0) return;
+	batches.push_back(pending);
+	pending.clear();
+	numBatches++;
+	workReady.notify_one();
+}
+
+// deliver:  run the callbacks of finished requests.  returns how many
+//
+int QueryService::deliver() {
+	vector<Done> done;
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		done.swap(finished);
+	}
+	for (int i = 0; i < done.size(); i++) done[i].callback(done[i].result);
+	return done.size();
+}
+
+// drain:  flush and wait until every submitted request is answered.
+//         callbacks still need deliver().  node copies of the terrain
+//         are dropped, so an edit made next is copied again
+//
+void QueryService::drain() {
+	std::unique_lock<std::mutex> lock(mutex);
+	flushLocked();
+	allDone.wait(lock, [this]() { return inFlight == 0; });
+	if (bReplicate) replicas.clear();
+}
+
+void QueryService::resetStats() {
+	std::lock_guard<std::mutex> lock(mutex);
+	numSubmitted = 0;
+	numBatches = 0;
+	stats.clear();
+}
+
+// work:  worker thread.  takes a batch at a time and answers it.  node
+//       -1:  not pinned, queries the terrain itself
+//
+void QueryService::work(int node) {
+	if (node != -1) pinThreadToNode(node);
+	while (true) {
+		vector<Job*> batch;
+		{
+			std::unique_lock<std::mutex> lock(mutex);
+			workReady.wait(lock, [this]() { return bStop || batches.size() > 0; });
+			if (batches.size() == 0) break;
+			batch.swap(batches.front());
+			batches.pop_front();
+		}
+
+		shared_ptr<Terrain> version = std::atomic_load(&terrain);
+		if (node != -1) version = replicas.local(version, node);
+		shared_ptr<const TileList> tileList = std::atomic_load(&tiles);
+		OctreeReader reader(version->octree);
+		vector<Done> done;
+		for (int i = 0; i < batch.size(); i++) {
+			QueryResult result;
+			execute(*version, tileList.get(), reader, batch[i]->request, result);
+			if (batch[i]->callback) {
+				Done d;
+				d.callback = batch[i]->callback;
+				d.result = result;
+				done.push_back(d);
+			}
+			else batch[i]->promise.set_value(result);
+			delete batch[i];
+		}
+
+		std::lock_guard<std::mutex> lock(mutex);
+		finished.insert(finished.end(), done.begin(), done.end());
+		stats.add(reader.stats);
+		inFlight -= batch.size();
+		if (inFlight == 0) allDone.notify_all();
+	}
+}
+
+void QueryService::execute(const Terrain& terrain, const TileList* tiles, OctreeReader& reader,
+	const QueryRequest& request, QueryResult& result)
+{
+	const SpatialIndex* index = terrain.index;
+	const InstancedScene* props = &terrain.props;
+	const Octree* octree = &terrain.octree;
+	switch (request.type) {
+	case QueryRequest::Closest:
+	case QueryRequest::Pick:
+	{
+		RayHit hit;
+		float t1 = request.t1;
+		if (index->intersectRay(request.ray, request.t0, t1, hit)) {
+			result.hit = true;
+			result.t = t1 = hit.t;
+			result.face = hit.face;
+		}
+		if (request.type == QueryRequest::Pick) {
+			if (!result.hit) break;
+			Vector3 p = request.ray.origin + request.ray.direction * result.t;
+			result.index = reader.nearestPoint(p, request.radius);
+			result.hit = (result.index != -1);
+			break;
+		}
+		InstanceHit prop;
+		if (props->intersectRay(request.ray, request.t0, t1, prop)) {
+			result.hit = true;
+			result.t = prop.t;
+			result.face = -1;
+			result.instance = prop.instance;
+			t1 = prop.t;
+		}
+		TileHit tileHit;
+		if (tiles && TerrainTiles::intersectRay(*tiles, request.ray, request.t0, t1, tileHit)) {
+			result.hit = true;
+			result.t = tileHit.t;
+			result.face = tileHit.face;
+			result.instance = -1;
+			result.tile = (*tiles)[tileHit.tile];
+		}
+		break;
+	}
+	case QueryRequest::Any:
+		result.hit = index->intersectAny(request.ray, request.t0, request.t1) ||
+			props->intersectAny(request.ray, request.t0, request.t1) ||
+			(tiles && TerrainTiles::intersectAny(*tiles, request.ray, request.t0, request.t1));
+		break;
+	case QueryRequest::Leaves:
+		result.hit = octree->intersect(request.box, octree->root, result.boxes);
+		if (tiles && TerrainTiles::intersect(*tiles, request.box, result.boxes)) result.hit = true;
+		break;
+	case QueryRequest::Points:
+		result.points = reader.pointsInBox(request.box);
+		result.hit = result.points.size() > 0;
+		break;
+	case QueryRequest::Nearest:
+		result.index = reader.nearestPoint(request.point, request.radius);
+		result.hit = (result.index != -1);
+		break;
+	}
+}
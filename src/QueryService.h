@@ -0,0 +1,143 @@
+//--------------------------------------------------------------
+//
+//  QueryService - terrain queries answered on worker threads
+//
+//  Any thread submits a QueryRequest and gets a future for the result,
+//  or gives a callback that deliver() runs later on the main thread
+//  (once a frame, from update()).  Requests collect in a pending batch;
+//  a full batch, or flush(), hands it to a pool of worker threads that
+//  each query the terrain through their own OctreeReader.
+//
+//  The usual frame:  take last frame's results, submit this frame's
+//  requests, flush(), and read the futures next frame (or later in this
+//  one, after other work).
+//
+//  Workers take the current Terrain version at the start of each batch
+//  and hold it to the end, so setTerrain() to a new version never waits
+//  and never pulls a version out from under a running query.  Editing a
+//  version in place (craters, switching its index) is different:  call
+//  drain() first so no request is still reading it.
+//
+//  With streamed tiles (TerrainTiles), setTiles() each frame with the
+//  current snapshot and Closest, Any and Leaves requests cover the
+//  tiles as well; the other requests stay on the main terrain.
+//
+//  On multi-socket machines set bReplicate before start():  workers are
+//  pinned to NUMA nodes in turn, and each answers from its node's copy
+//  of the terrain (TerrainReplicas, made by the first worker of the node
+//  to see a new version), so no query reads the other socket's memory.
+//
+#pragma once
+#include "ofMain.h"
+#include "Terrain.h"
+#include "TerrainTiles.h"
+#include "OctreeReader.h"
+#include "Numa.h"
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <future>
+#include <deque>
+#include <float.h>
+
+class QueryRequest {
+public:
+	enum Type {
+		Closest,	// closest hit along ray for t in (t0, t1), terrain and props
+		Any,		// is the segment (t0, t1) of ray blocked, terrain and props
+		Leaves,		// octree leaf boxes overlapping box (as Octree::intersect)
+		Points,		// terrain vertices in box
+		Nearest,	// terrain vertex closest to point within radius
+		Pick		// closest hit along ray, then the vertex nearest the hit within radius
+	};
+
+	static QueryRequest closest(const Ray& ray, float t0 = 0, float t1 = FLT_MAX);
+	static QueryRequest any(const Ray& ray, float t0, float t1);
+	static QueryRequest leaves(const Box& box);
+	static QueryRequest points(const Box& box);
+	static QueryRequest nearest(const Vector3& point, float radius);
+	static QueryRequest pick(const Ray& ray, float radius);
+
+	Type type = Closest;
+	Ray ray;
+	float t0 = 0, t1 = FLT_MAX;
+	Box box;
+	Vector3 point;
+	float radius = 0;
+};
+
+class QueryResult {
+public:
+	bool hit = false;
+	float t = 0;			// Closest, Pick
+	int face = -1;			// Closest, Pick (terrain face, -1 for a prop)
+	int instance = -1;		// Closest:  prop instance hit, -1 for terrain
+	shared_ptr<const TerrainTile> tile;	// Closest:  streamed tile hit (face is its face), NULL for the main terrain
+	int index = -1;			// Nearest, Pick:  vertex
+	vector<int> points;		// Points
+	vector<Box> boxes;		// Leaves
+};
+
+class QueryService {
+public:
+	~QueryService();
+
+	// numThreads 0:  one less than the number of cores (at least 1)
+	//
+	void start(shared_ptr<Terrain> terrain, int numThreads = 0);
+	void stop();
+	void setTerrain(shared_ptr<Terrain> terrain);
+	void setTiles(shared_ptr<const TileList> tiles);
+
+	std::future<QueryResult> submit(const QueryRequest& request);
+	void submit(const QueryRequest& request, std::function<void(const QueryResult&)> callback);
+	void flush();
+	int deliver();
+	void drain();
+
+	// answer a request on the calling thread, as a worker would
+	//
+	static void execute(const Terrain& terrain, const TileList* tiles, OctreeReader& reader,
+		const QueryRequest& request, QueryResult& result);
+
+	int batchSize = 16;
+	bool bReplicate = false;	// per NUMA node terrain copies, set before start()
+
+	// counts since the last resetStats()
+	//
+	void resetStats();
+	int64_t numSubmitted = 0;
+	int64_t numBatches = 0;
+	QueryStats stats;		// octree work, added up over the workers
+
+private:
+	class Job {
+	public:
+		QueryRequest request;
+		std::promise<QueryResult> promise;
+		std::function<void(const QueryResult&)> callback;	// empty:  use the promise
+	};
+	class Done {
+	public:
+		std::function<void(const QueryResult&)> callback;
+		QueryResult result;
+	};
+
+	void add(Job* job);
+	void flushLocked();
+	void work(int node);
+
+	shared_ptr<Terrain> terrain;	// only through atomic_load / atomic_store
+	shared_ptr<const TileList> tiles;	// the same, NULL without tiles
+	TerrainReplicas replicas;		// bReplicate only
+
+	vector<std::thread> workers;
+	std::mutex mutex;
+	std::condition_variable workReady;
+	std::condition_variable allDone;
+	vector<Job*> pending;
+	std::deque<vector<Job*> > batches;
+	vector<Done> finished;			// callbacks waiting for deliver()
+	int inFlight = 0;				// submitted, not yet answered
+	bool bStop = false;
+};
@@ -13,28 +13,42 @@
  *
  */
 
-class Ray {
+template <class T>
+class TRay {
 public:
-    Ray() { }
-    Ray(Vector3 o, Vector3 d) {
+    TRay() { }
+    TRay(TVector3<T> o, TVector3<T> d) {
         origin = o;
         direction = d;
-        inv_direction = Vector3(1 / d.x(), 1 / d.y(), 1 / d.z());
+        inv_direction = TVector3<T>(1 / d.x(), 1 / d.y(), 1 / d.z());
         sign[0] = (inv_direction.x() < 0);
         sign[1] = (inv_direction.y() < 0);
         sign[2] = (inv_direction.z() < 0);
     }
-    Ray(const Ray& r) {
+    TRay(const TRay& r) {
         origin = r.origin;
         direction = r.direction;
         inv_direction = r.inv_direction;
         sign[0] = r.sign[0]; sign[1] = r.sign[1]; sign[2] = r.sign[2];
     }
 
-    Vector3 origin;
-    Vector3 direction;
-    Vector3 inv_direction;
+    TVector3<T> origin;
+    TVector3<T> direction;
+    TVector3<T> inv_direction;
     int sign[3];
 };
 
+typedef TRay<float> Ray;
+typedef TRay<double> Rayd;
+
+// a zero direction component gives 0 * inf = NaN in the box test when the
+// origin lies exactly on a box face (e.g. straight down from x = 0), so
+// build such rays with a tiny component instead
+//
+template <class T>
+inline TRay<T> makeRay(const TVector3<T>& o, const TVector3<T>& d) {
+    const T tiny = (T)1e-30;
+    return TRay<T>(o, TVector3<T>(d.x() == 0 ? tiny : d.x(), d.y() == 0 ? tiny : d.y(), d.z() == 0 ? tiny : d.z()));
+}
+
 #endif // _RAY_H_
@@ -0,0 +1,114 @@
+//--------------------------------------------------------------
+//
+//  SimulationThread - the lander simulation on a thread of its own
+//
+
+#include "SimulationThread.h"
+#include <chrono>
+
+// renderPosition:  the lander between the snapshot's last two steps, by
+//                  the sim time at publishing plus the time since
+//
+glm::vec3 LanderSnapshot::renderPosition(uint64_t now) const {
+	float alpha = ofClamp((accumulator + (now - time) / 1e6) / dt, 0, 1);
+	return previousPosition + (position - previousPosition) * alpha;
+}
+
+float LanderSnapshot::renderRotation(uint64_t now) const {
+	float alpha = ofClamp((accumulator + (now - time) / 1e6) / dt, 0, 1);
+	return ofLerp(previousRotation, rotation, alpha);
+}
+
+// start:  run sim on the thread from now on.  the first snapshot is
+//         published here, so latest() has one right away
+//
+void SimulationThread::start(LanderSimulation* sim) {
+	stop();
+	this->sim = sim;
+	sim->bMakeCraters = false;
+	sim->accumulator = 0;
+	publish(LanderEvents());
+	bRunning = true;
+	thread = std::thread(&SimulationThread::run, this);
+}
+
+void SimulationThread::stop() {
+	if (!thread.joinable()) return;
+	bRunning = false;
+	thread.join();
+}
+
+void SimulationThread::setInput(const LanderControls& controls, shared_ptr<const TileList> tiles) {
+	std::lock_guard<std::mutex> lock(inputMutex);
+	this->controls = controls;
+	this->tiles = tiles;
+}
+
+const LanderSnapshot& SimulationThread::latest() {
+	snapshots.update();
+	return snapshots.front();
+}
+
+// run:  advance by the real time since the last advance, publish, and
+//       sleep until the next step is due
+//
+void SimulationThread::run() {
+	uint64_t last = ofGetElapsedTimeMicros();
+	while (bRunning) {
+		uint64_t now = ofGetElapsedTimeMicros();
+		LanderControls input;
+		shared_ptr<const TileList> inputTiles;
+		{
+			std::lock_guard<std::mutex> lock(inputMutex);
+			input = controls;
+			inputTiles = tiles;
+		}
+		float wait = 0;
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+			sim->tiles = inputTiles;
+			LanderEvents events = sim->advance((now - last) / 1e6, input);
+			publish(events);
+			wait = sim->dt - sim->accumulator;
+		}
+		uint64_t end = ofGetElapsedTimeMicros();
+		numAdvances++;
+		advanceMicros += end - now;
+		last = now;
+		std::this_thread::sleep_for(std::chrono::microseconds((int64_t)(wait * 1e6) - (int64_t)(end - now)));
+	}
+}
+
+// publish:  sim's state into the back slot, then hand the slot over.
+//           called with mutex held (or before the thread starts)
+//
+void SimulationThread::publish(const LanderEvents& events) {
+	if (events.bMainEngine) numMainEngine++;
+	if (events.bCrash) {
+		numCrashes++;
+		crashPoint = events.crashPoint;
+		bCrashOnTerrain = events.crashTerrain == sim->terrain.get();
+	}
+
+	LanderSnapshot& snapshot = snapshots.back();
+	snapshot.step = sim->numSteps;
+	snapshot.time = ofGetElapsedTimeMicros();
+	snapshot.dt = sim->dt;
+	snapshot.accumulator = sim->accumulator;
+	snapshot.position = sim->position;
+	snapshot.previousPosition = sim->previousPosition;
+	snapshot.rotation = sim->rotation;
+	snapshot.previousRotation = sim->previousRotation;
+	snapshot.velocity = sim->velocity;
+	snapshot.altitude = sim->altitude;
+	snapshot.fuel = (int)sim->fuel;
+	snapshot.gameplay = sim->gameplay;
+	snapshot.bGrounded = sim->bGrounded;
+	snapshot.groundBoxes = sim->groundBoxes;
+	snapshot.bThrust = events.bThrust;
+	snapshot.numMainEngine = numMainEngine;
+	snapshot.numCrashes = numCrashes;
+	snapshot.crashPoint = crashPoint;
+	snapshot.bCrashOnTerrain = bCrashOnTerrain;
+	snapshots.publish();
+}
@@ -0,0 +1,130 @@
+//--------------------------------------------------------------
+//
+//  SimulationThread - the lander simulation on a thread of its own
+//
+//  The thread advances a LanderSimulation in real time at its tick rate
+//  and, after every advance, publishes a LanderSnapshot:  everything the
+//  view needs to draw a frame (lander pose, the last two steps for
+//  interpolation, HUD values, ground boxes, what happened).  Snapshots
+//  go through a TripleBuffer, so neither side ever waits for the other:
+//  the simulation always has a slot to write, and the view takes the
+//  newest finished one.  A slow draw no longer holds back physics and a
+//  slow step no longer holds back drawing; a frame costs the longer of
+//  the two instead of both.
+//
+//  The view sends controls and the current tiles with setInput().  The
+//  simulation itself is only touched by the thread, so anything else
+//  that changes it (start, placing the lander, a new terrain or lander)
+//  locks mutex first.  The main thread stays the only writer of the
+//  terrain (it draws the mesh without a lock):  a crash only reports
+//  crashPoint, and the view makes the crater under the lock (when the
+//  crash was on the terrain; streamed tiles are never edited).
+//
+//  Cameras, particle emitters and the lander model are not in the
+//  snapshot.  They follow the lander's pose interpolated to the moment
+//  the frame is drawn (renderPosition()/renderRotation()), which only
+//  the view knows, and the tracking camera also moves on the view's
+//  sight queries; state the simulation kept for them would be a step
+//  behind.  update() moves them from the snapshot in its frame jobs
+//  (ofApp::buildFrameJobs()), on the job threads.  That is only CPU
+//  state (matrices, particle lists); the GL work is in draw(), which
+//  runs after the jobs are done.
+//
+#pragma once
+#include "ofMain.h"
+#include "LanderSimulation.h"
+#include <thread>
+#include <mutex>
+#include <atomic>
+
+// TripleBuffer:  one writer, one reader, no locks.  the writer fills
+//                back() and publish()es it; the reader calls update()
+//                and reads front(), which stays put until its next
+//                update()
+//
+template <class T>
+class TripleBuffer {
+public:
+	T& back() { return slots[backSlot]; }
+	void publish() { backSlot = middle.exchange(backSlot | Fresh) & Slot; }
+
+	// update:  true if a newer slot was published since the last update()
+	//
+	bool update() {
+		if ((middle.load() & Fresh) == 0) return false;
+		frontSlot = middle.exchange(frontSlot) & Slot;
+		return true;
+	}
+	const T& front() const { return slots[frontSlot]; }
+
+private:
+	enum { Slot = 3, Fresh = 4 };
+	T slots[3];
+	int backSlot = 0;				// writer's
+	std::atomic<int> middle{ 1 };	// last published (Fresh:  not yet taken)
+	int frontSlot = 2;				// reader's
+};
+
+class LanderSnapshot {
+public:
+	glm::vec3 renderPosition(uint64_t now) const;
+	float renderRotation(uint64_t now) const;
+
+	int64_t step = 0;				// sim.numSteps
+	uint64_t time = 0;				// published at (ofGetElapsedTimeMicros())
+	float dt = 1.0 / 60;
+	float accumulator = 0;			// sim time past the last step when published
+	glm::vec3 position = glm::vec3(0, 0, 0);
+	glm::vec3 previousPosition = glm::vec3(0, 0, 0);
+	float rotation = 0;
+	float previousRotation = 0;
+	glm::vec3 velocity = glm::vec3(0, 0, 0);
+	float altitude = 0;
+	int fuel = 0;
+	int gameplay = LanderSimulation::Waiting;
+	bool bGrounded = false;
+	vector<Box> groundBoxes;
+
+	// events:  flags for the steps of the last advance, counts since start
+	// (the view can miss a snapshot, compare counts with the last one seen)
+	//
+	bool bThrust = false;
+	int numMainEngine = 0;
+	int numCrashes = 0;
+	Vector3 crashPoint = Vector3(0, 0, 0);	// last crash
+	bool bCrashOnTerrain = false;	// last crash hit the terrain, not a tile (tiles get no crater)
+};
+
+class SimulationThread {
+public:
+	~SimulationThread() { stop(); }
+
+	void start(LanderSimulation* sim);
+	void stop();
+	void setInput(const LanderControls& controls, shared_ptr<const TileList> tiles);
+	const LanderSnapshot& latest();		// newest published snapshot (main thread)
+	const LanderSnapshot& current() const { return snapshots.front(); }	// the one latest() returned
+
+	LanderSimulation* sim = NULL;
+	std::mutex mutex;				// held by the thread while it advances
+
+	// thread timing since start()
+	//
+	std::atomic<int64_t> numAdvances{ 0 };
+	std::atomic<uint64_t> advanceMicros{ 0 };
+
+private:
+	void run();
+	void publish(const LanderEvents& events);
+
+	TripleBuffer<LanderSnapshot> snapshots;
+	std::thread thread;
+	std::atomic<bool> bRunning{ false };
+	std::mutex inputMutex;			// input only, so setInput() never waits for a step
+	LanderControls controls;
+	shared_ptr<const TileList> tiles;
+	int numMainEngine = 0;			// thread's counts
+	int numCrashes = 0;
+	Vector3 crashPoint = Vector3(0, 0, 0);
+	bool bCrashOnTerrain = false;
+};
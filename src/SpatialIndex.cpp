@@ -0,0 +1,204 @@
+//--------------------------------------------------------------
+//
+//  SpatialIndex - octree and BVH backends, backend selection
+//
+
+#include "SpatialIndex.h"
+#include "KdTree.h"
+#include "UniformGrid.h"
+#include "Triangle.h"
+#include <float.h>
+
+int SpatialIndex::numFaces(const ofMesh& mesh) {
+	if (mesh.getNumIndices() > 0) return mesh.getNumIndices() / 3;
+	return mesh.getNumVertices() / 3;
+}
+
+void SpatialIndex::faceVerts(const ofMesh& mesh, int face, Vector3 v[3]) {
+	for (int i = 0; i < 3; i++) {
+		int index = (mesh.getNumIndices() > 0) ? mesh.getIndex(face * 3 + i) : face * 3 + i;
+		glm::vec3 p = mesh.getVertex(index);
+		v[i] = Vector3(p.x, p.y, p.z);
+	}
+}
+
+Box SpatialIndex::faceBox(const Vector3 v[3]) {
+	Box box = Box(v[0], v[0]);
+	box.expand(v[1]);
+	box.expand(v[2]);
+	return box;
+}
+
+//--------------------------------------------------------------
+// OctreeIndex
+//
+
+void OctreeIndex::build(const ofMesh& mesh) {
+	ownOctree.create(mesh, numLevels);
+	octree = &ownOctree;
+}
+
+bool OctreeIndex::intersectRay(const Ray& ray, float t0, float t1, RayHit& hitRtn) const {
+	return octree->intersectClosest(ray, t0, t1, hitRtn.t, hitRtn.face);
+}
+
+bool OctreeIndex::intersectAny(const Ray& ray, float t0, float t1) const {
+	return octree->intersectSegment(ray, t0, t1);
+}
+
+// leaves share faces along their borders, so the result is sorted and
+// made unique at the end
+//
+int OctreeIndex::overlap(const Box& box, vector<int>& facesRtn) const {
+	int count = facesRtn.size();
+	overlap(box, octree->root, facesRtn);
+	sort(facesRtn.begin() + count, facesRtn.end());
+	facesRtn.erase(unique(facesRtn.begin() + count, facesRtn.end()), facesRtn.end());
+	return facesRtn.size() - count;
+}
+
+void OctreeIndex::overlap(const Box& box, const TreeNode& node, vector<int>& facesRtn) const {
+	Box bounds = node.faceBounds;
+	if (!bounds.overlap(box)) return;
+	if (node.children.size() == 0) {
+		Vector3 v[3];
+		for (int i = 0; i < node.faces.size(); i++) {
+			octree->getFaceVerts(node.faces[i], v);
+			if (faceBox(v).overlap(box)) facesRtn.push_back(node.faces[i]);
+		}
+		return;
+	}
+	for (int i = 0; i < node.children.size(); i++) {
+		overlap(box, node.children[i], facesRtn);
+	}
+}
+
+//--------------------------------------------------------------
+// BVHIndex
+//
+
+void BVHIndex::build(const ofMesh& mesh) {
+	vector<ofMesh> meshes;
+	meshes.push_back(mesh);
+	bvh.create(meshes);
+}
+
+bool BVHIndex::intersectRay(const Ray& ray, float t0, float t1, RayHit& hitRtn) const {
+	int tri;
+	if (!bvh.intersect(ray, t0, t1, hitRtn.t, tri)) return false;
+	hitRtn.face = bvh.tris[tri].face;
+	return true;
+}
+
+bool BVHIndex::intersectAny(const Ray& ray, float t0, float t1) const {
+	return bvh.intersectAny(ray, t0, t1);
+}
+
+int BVHIndex::overlap(const Box& box, vector<int>& facesRtn) const {
+	int count = facesRtn.size();
+	bvh.overlap(box, facesRtn);
+	for (int i = count; i < facesRtn.size(); i++) {
+		facesRtn[i] = bvh.tris[facesRtn[i]].face;
+	}
+	return facesRtn.size() - count;
+}
+
+//--------------------------------------------------------------
+// backend selection
+//
+
+SpatialIndex* makeSpatialIndex(const string& name) {
+	if (name == "octree") return new OctreeIndex();
+	if (name == "bvh") return new BVHIndex();
+	if (name == "kd-tree") return new KdTreeIndex();
+	if (name == "uniform grid") return new UniformGridIndex();
+	return NULL;
+}
+
+static float randomIn(float lo, float hi) {
+	return ofRandom(lo, hi);
+}
+
+// chooseSpatialIndex:  build every backend on mesh, run the same query mix
+//                      on each, print a table and return the fastest (the
+//                      others are deleted).  also checks the closest hits
+//                      agree with the first backend
+//
+SpatialIndex* chooseSpatialIndex(const ofMesh& mesh, const QueryMix& mix) {
+	const char* names[] = { "octree", "bvh", "kd-tree", "uniform grid" };
+	const int numBackends = 4;
+
+	Box bounds = Octree::meshBounds(mesh);
+	Vector3 lo = bounds.parameters[0];
+	Vector3 hi = bounds.parameters[1];
+	float height = hi.y() - lo.y();
+
+	// altitude like rays straight down, line of sight like segments
+	// between points above the terrain, lander sized boxes on the surface
+	//
+	vector<Ray> down;
+	vector<Vector3> from, to;
+	vector<Box> boxes;
+	for (int i = 0; i < mix.closestRays; i++) {
+		Vector3 o = Vector3(randomIn(lo.x(), hi.x()), hi.y() + 10, randomIn(lo.z(), hi.z()));
+		down.push_back(makeRay(o, Vector3(0, -1, 0)));
+	}
+	for (int i = 0; i < mix.anyRays; i++) {
+		from.push_back(Vector3(randomIn(lo.x(), hi.x()), randomIn(lo.y(), hi.y() + height), randomIn(lo.z(), hi.z())));
+		to.push_back(Vector3(randomIn(lo.x(), hi.x()), randomIn(lo.y(), hi.y() + height), randomIn(lo.z(), hi.z())));
+	}
+	Vector3 half = Vector3(mix.boxSize, mix.boxSize, mix.boxSize) * .5;
+	for (int i = 0; i < mix.boxes; i++) {
+		Vector3 c = Vector3(randomIn(lo.x(), hi.x()), randomIn(lo.y(), hi.y()), randomIn(lo.z(), hi.z()));
+		boxes.push_back(Box(c - half, c + half));
+	}
+
+	cout << "---- spatial index selection: " << SpatialIndex::numFaces(mesh) << " faces ----" << endl;
+	cout << "backend          build(ms)  closest(us)  any(us)  box(us)  total(us)  mismatches" << endl;
+
+	SpatialIndex* best = NULL;
+	uint64_t bestTime = 0;
+	vector<RayHit> reference;
+	for (int b = 0; b < numBackends; b++) {
+		SpatialIndex* index = makeSpatialIndex(names[b]);
+
+		uint64_t t0 = ofGetElapsedTimeMicros();
+		index->build(mesh);
+		uint64_t t1 = ofGetElapsedTimeMicros();
+
+		int mismatches = 0;
+		RayHit hit;
+		for (int i = 0; i < down.size(); i++) {
+			hit = RayHit();
+			index->intersectRay(down[i], 0, FLT_MAX, hit);
+			if (b == 0) reference.push_back(hit);
+			else if (hit.face != reference[i].face && fabsf(hit.t - reference[i].t) > 1e-3f) mismatches++;
+		}
+		uint64_t t2 = ofGetElapsedTimeMicros();
+		int blocked = 0;
+		for (int i = 0; i < from.size(); i++) {
+			if (index->intersectAny(makeRay(from[i], to[i] - from[i]), 0, 1)) blocked++;
+		}
+		uint64_t t3 = ofGetElapsedTimeMicros();
+		vector<int> faces;
+		for (int i = 0; i < boxes.size(); i++) {
+			faces.clear();
+			index->overlap(boxes[i], faces);
+		}
+		uint64_t t4 = ofGetElapsedTimeMicros();
+
+		uint64_t total = t4 - t1;
+		printf("%-16s %9.1f  %11llu  %7llu  %7llu  %9llu  %10d\n", index->name().c_str(),
+			(t1 - t0) / 1000.0, (unsigned long long)(t2 - t1), (unsigned long long)(t3 - t2),
+			(unsigned long long)(t4 - t3), (unsigned long long)total, mismatches);
+
+		if (best == NULL || total < bestTime) {
+			delete best;
+			best = index;
+			bestTime = total;
+		}
+		else delete index;
+	}
+	cout << "using " << best->name() << endl;
+	return best;
+}
@@ -0,0 +1,105 @@
+//--------------------------------------------------------------
+//
+//  SpatialIndex - common interface for terrain triangle indexes
+//
+//  The game asks the terrain three kinds of questions:  closest hit
+//  along a ray (altitude, picking), any hit along a segment (line of
+//  sight) and which faces are near a box (collision broad phase).
+//  Each backend answers them in its own way:
+//
+//      OctreeIndex       - the point octree with leaf faces (Octree)
+//      BVHIndex          - binned SAH bounding volume hierarchy (MeshBVH)
+//      KdTreeIndex       - kd-tree, faces straddling a split go both sides
+//      UniformGridIndex  - one level grid, rays walked with a 3D DDA
+//
+//  Face indices are always the face number in the source mesh, so
+//  results can be compared across backends.
+//
+//  chooseSpatialIndex() builds every backend on the same mesh, times
+//  a query mix like the one the game runs and returns the fastest.
+//
+#pragma once
+#include "ofMain.h"
+#include "box.h"
+#include "ray.h"
+#include "Octree.h"
+#include "MeshBVH.h"
+
+class RayHit {
+public:
+	float t = 0;
+	int face = -1;
+};
+
+class SpatialIndex {
+public:
+	virtual ~SpatialIndex() { }
+
+	virtual string name() const = 0;
+	virtual void build(const ofMesh& mesh) = 0;
+
+	// closest face hit for t in (t0, t1)
+	//
+	virtual bool intersectRay(const Ray& ray, float t0, float t1, RayHit& hitRtn) const = 0;
+
+	// true if any face is hit for t in (t0, t1)
+	//
+	virtual bool intersectAny(const Ray& ray, float t0, float t1) const = 0;
+
+	// faces whose bounding box overlaps box, each face once.  returns count
+	//
+	virtual int overlap(const Box& box, vector<int>& facesRtn) const = 0;
+
+	// face access on a mesh, indexed or not
+	//
+	static int numFaces(const ofMesh& mesh);
+	static void faceVerts(const ofMesh& mesh, int face, Vector3 v[3]);
+	static Box faceBox(const Vector3 v[3]);
+};
+
+// octree backend.  either owns its octree (build) or wraps one that
+// already exists, like the game's terrain octree
+//
+class OctreeIndex : public SpatialIndex {
+public:
+	OctreeIndex() { }
+	OctreeIndex(Octree* octree) : octree(octree) { }
+
+	string name() const { return "octree"; }
+	void build(const ofMesh& mesh);
+	bool intersectRay(const Ray& ray, float t0, float t1, RayHit& hitRtn) const;
+	bool intersectAny(const Ray& ray, float t0, float t1) const;
+	int overlap(const Box& box, vector<int>& facesRtn) const;
+
+	Octree* octree = NULL;
+	Octree ownOctree;
+	int numLevels = 20;
+
+private:
+	void overlap(const Box& box, const TreeNode& node, vector<int>& facesRtn) const;
+};
+
+class BVHIndex : public SpatialIndex {
+public:
+	string name() const { return "bvh"; }
+	void build(const ofMesh& mesh);
+	bool intersectRay(const Ray& ray, float t0, float t1, RayHit& hitRtn) const;
+	bool intersectAny(const Ray& ray, float t0, float t1) const;
+	int overlap(const Box& box, vector<int>& facesRtn) const;
+
+	MeshBVH bvh;
+};
+
+// query mix used to pick a backend.  rays are cast from above the
+// terrain, boxes are lander sized and sit on the surface
+//
+class QueryMix {
+public:
+	int closestRays = 2000;
+	int anyRays = 2000;
+	int boxes = 2000;
+	float boxSize = 4;
+};
+
+SpatialIndex* makeSpatialIndex(const string& name);
+SpatialIndex* chooseSpatialIndex(const ofMesh& mesh, const QueryMix& mix);
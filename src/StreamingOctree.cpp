@@ -0,0 +1,369 @@
+//--------------------------------------------------------------
+//
+//  StreamingOctree - external memory octree build for huge point sets
+//
+
+#include "StreamingOctree.h"
+#include <thread>
+#include <atomic>
+#include <float.h>
+#ifndef _WIN32
+#include <sys/resource.h>
+#endif
+
+//--------------------------------------------------------------
+// PointStream
+//
+
+bool PointStream::open(const string& path) {
+	close();
+	file = fopen(path.c_str(), "rb");
+	if (file == NULL) return false;
+	string ext = ofToLower(ofFilePath::getFileExt(path));
+	bObj = (ext == "obj");
+	return true;
+}
+
+void PointStream::close() {
+	if (file) fclose(file);
+	file = NULL;
+}
+
+// read:  up to maxPoints more points, 0 at the end of the file
+//
+int PointStream::read(vector<Vector3>& pointsRtn, int maxPoints) {
+	pointsRtn.clear();
+	if (file == NULL) return 0;
+	if (!bObj) {
+		vector<float> xyz(maxPoints * 3);
+		int n = fread(xyz.data(), sizeof(float) * 3, maxPoints, file);
+		for (int i = 0; i < n; i++) pointsRtn.push_back(Vector3(xyz[i * 3], xyz[i * 3 + 1], xyz[i * 3 + 2]));
+		return n;
+	}
+	char line[256];
+	while (pointsRtn.size() < maxPoints && fgets(line, sizeof(line), file)) {
+		float x, y, z;
+		if (line[0] == 'v' && line[1] == ' ' && sscanf(line + 2, "%f %f %f", &x, &y, &z) == 3) {
+			pointsRtn.push_back(Vector3(x, y, z));
+		}
+	}
+	return pointsRtn.size();
+}
+
+void PointStream::rewind() {
+	if (file) fseek(file, 0, SEEK_SET);
+}
+
+//--------------------------------------------------------------
+// StreamingOctreeBuilder
+//
+
+static int64_t peakResident() {
+#ifdef _WIN32
+	return 0;
+#else
+	struct rusage usage;
+	getrusage(RUSAGE_SELF, &usage);
+	return (int64_t)usage.ru_maxrss * 1024;
+#endif
+}
+
+// octantBox:  child box of octant (bit 0 x, 1 y, 2 z:  set for the high
+//             half), split at the center
+//
+Box StreamingOctreeBuilder::octantBox(const Box& box, int octant) {
+	Vector3 c = (box.min() + box.max()) * .5;
+	float lo[3], hi[3];
+	for (int k = 0; k < 3; k++) {
+		lo[k] = (octant & (1 << k)) ? c[k] : box.min()[k];
+		hi[k] = (octant & (1 << k)) ? box.max()[k] : c[k];
+	}
+	return Box(Vector3(lo[0], lo[1], lo[2]), Vector3(hi[0], hi[1], hi[2]));
+}
+
+// octantOf:  the octant of box holding p, points on the center plane go
+//            low.  p is in octantBox(box, octantOf(box, p)) exactly
+//
+int StreamingOctreeBuilder::octantOf(const Box& box, const Vector3& p) {
+	Vector3 c = (box.min() + box.max()) * .5;
+	int octant = 0;
+	for (int k = 0; k < 3; k++) {
+		if (p[k] > c[k]) octant |= (1 << k);
+	}
+	return octant;
+}
+
+// cellOf:  Morton code of the cell prefixLevels below the root holding p
+//
+uint32_t StreamingOctreeBuilder::cellOf(const Vector3& p) const {
+	Box box = bounds;
+	uint32_t code = 0;
+	for (int level = 0; level < prefixLevels; level++) {
+		int octant = octantOf(box, p);
+		code = code * 8 + octant;
+		box = octantBox(box, octant);
+	}
+	return code;
+}
+
+string StreamingOctreeBuilder::bucketPath(int bucket) const {
+	return tempDir + "/octree_bucket_" + ofToString(bucket) + ".tmp";
+}
+
+// bucketFile:  bucket's file, open for appending.  at most maxOpenFiles
+//              are open at once, the one opened longest ago is closed to
+//              make room (chunks are written in cell order, so that is
+//              the one least likely to be needed again soon)
+//
+FILE* StreamingOctreeBuilder::bucketFile(int bucket) {
+	Bucket& b = buckets[bucket];
+	if (b.file) return b.file;
+	if (openBuckets.size() >= max(maxOpenFiles, 1)) {
+		Bucket& oldest = buckets[openBuckets.front()];
+		fclose(oldest.file);
+		oldest.file = NULL;
+		openBuckets.pop_front();
+	}
+	b.file = fopen(bucketPath(bucket).c_str(), b.count == 0 ? "wb" : "ab");
+	if (b.file) openBuckets.push_back(bucket);
+	return b.file;
+}
+
+void StreamingOctreeBuilder::closeBuckets() {
+	for (int i = 0; i < openBuckets.size(); i++) {
+		fclose(buckets[openBuckets[i]].file);
+		buckets[openBuckets[i]].file = NULL;
+	}
+	openBuckets.clear();
+}
+
+// build:  the octree of the points in inPath (see PointStream) as a
+//         PagedOctree file at outPath.  point indices are the order of
+//         the points in the input
+//
+bool StreamingOctreeBuilder::build(const string& inPath, const string& outPath) {
+	uint64_t t0 = ofGetElapsedTimeMicros();
+	PointStream in;
+	if (!in.open(inPath)) return false;
+
+	// 1) bounds
+	//
+	vector<Vector3> chunk;
+	numPoints = 0;
+	float lo[3] = { FLT_MAX, FLT_MAX, FLT_MAX };
+	float hi[3] = { -FLT_MAX, -FLT_MAX, -FLT_MAX };
+	while (in.read(chunk, chunkPoints) > 0) {
+		for (int i = 0; i < chunk.size(); i++) {
+			for (int k = 0; k < 3; k++) {
+				lo[k] = min(lo[k], chunk[i][k]);
+				hi[k] = max(hi[k], chunk[i][k]);
+			}
+		}
+		numPoints += chunk.size();
+	}
+	if (numPoints == 0) return false;
+	bounds = Box(Vector3(lo[0], lo[1], lo[2]), Vector3(hi[0], hi[1], hi[2]));
+	uint64_t t1 = ofGetElapsedTimeMicros();
+
+	// 2) binning, each chunk counting sorted by cell
+	//
+	int numCells = 1 << (3 * prefixLevels);
+	buckets.clear();
+	buckets.resize(numCells);
+	vector<uint32_t> cells;
+	vector<int64_t> start(numCells + 1);
+	vector<PagedPoint> sorted;
+	uint32_t index = 0;
+	bool ok = true;
+	in.rewind();
+	while (ok && in.read(chunk, chunkPoints) > 0) {
+		cells.resize(chunk.size());
+		std::fill(start.begin(), start.end(), 0);
+		for (int i = 0; i < chunk.size(); i++) {
+			cells[i] = cellOf(chunk[i]);
+			start[cells[i] + 1]++;
+		}
+		for (int c = 0; c < numCells; c++) start[c + 1] += start[c];
+		sorted.resize(chunk.size());
+		for (int i = 0; i < chunk.size(); i++) {
+			PagedPoint& p = sorted[start[cells[i]]++];
+			p.index = index++;
+			for (int k = 0; k < 3; k++) p.p[k] = chunk[i][k];
+		}
+
+		// start[c] is now the end of cell c's run
+		//
+		int64_t begin = 0;
+		for (int c = 0; c < numCells; c++) {
+			int64_t n = start[c] - begin;
+			if (n == 0) continue;
+			FILE* file = bucketFile(c);
+			if (file == NULL || fwrite(&sorted[begin], sizeof(PagedPoint), n, file) != n) {
+				cout << "StreamingOctreeBuilder: can't write " << bucketPath(c) << endl;
+				ok = false;
+				break;
+			}
+			buckets[c].count += n;
+			begin = start[c];
+		}
+	}
+	in.close();
+	closeBuckets();
+	chunk = vector<Vector3>();
+	sorted = vector<PagedPoint>();
+	uint64_t t2 = ofGetElapsedTimeMicros();
+
+	// 3) subtrees, a bucket at a time per worker (each opens its own to
+	//    read it)
+	//
+	PagedOctreeWriter writer;
+	ok = ok && writer.open(outPath);
+	vector<int> todo;
+	largestBucket = 0;
+	for (int c = 0; c < numCells; c++) {
+		if (buckets[c].count == 0) continue;
+		todo.push_back(c);
+		largestBucket = max(largestBucket, buckets[c].count);
+	}
+	numBuckets = todo.size();
+
+	if (ok) {
+		int threads = numThreads > 0 ? numThreads : (int)std::thread::hardware_concurrency();
+		threads = max(1, min(threads, numBuckets));
+		std::mutex mutex;
+		std::atomic<int> next(0);
+		std::atomic<bool> failed(false);
+		vector<std::thread> workers;
+		for (int t = 0; t < threads; t++) {
+			workers.push_back(std::thread([&]() {
+				int i;
+				while (!failed && (i = next++) < todo.size()) {
+					if (!buildBucket(todo[i], writer, mutex)) failed = true;
+				}
+			}));
+		}
+		for (int t = 0; t < threads; t++) workers[t].join();
+		ok = !failed;
+	}
+	for (int c = 0; c < numCells; c++) {
+		if (buckets[c].count > 0) remove(bucketPath(c).c_str());
+	}
+	uint64_t t3 = ofGetElapsedTimeMicros();
+
+	// 4) the top, bucket roots up
+	//
+	if (ok) {
+		PagedNode root;
+		buildTop(writer, bounds, 0, 0, root);
+		uint32_t rootNode = writer.addNodes(&root, 1);
+		numNodes = writer.header.numNodes;
+		ok = writer.close(bounds, rootNode);
+	}
+	buckets.clear();
+	uint64_t t4 = ofGetElapsedTimeMicros();
+
+	boundsTime = (t1 - t0) / 1.0e6;
+	binTime = (t2 - t1) / 1.0e6;
+	subtreeTime = (t3 - t2) / 1.0e6;
+	totalTime = (t4 - t0) / 1.0e6;
+	peakMemory = peakResident();
+	return ok;
+}
+
+static void setBox(float b[6], const Box& box) {
+	for (int k = 0; k < 3; k++) {
+		b[k] = box.parameters[0][k];
+		b[k + 3] = box.parameters[1][k];
+	}
+}
+
+// buildBucket:  load a bucket and build its subtree, a BucketTree in the
+//               bucket's cell (children of a node are contiguous, as the
+//               paged file needs).  the subtree's leaf data and nodes (all
+//               but its root) go to the writer together,
+//               buckets[bucket].root is set for buildTop().  false if the
+//               bucket can't be read back whole
+//
+bool StreamingOctreeBuilder::buildBucket(int bucket, PagedOctreeWriter& writer, std::mutex& mutex) {
+	Bucket& b = buckets[bucket];
+	vector<PagedPoint> points(b.count);
+	FILE* file = fopen(bucketPath(bucket).c_str(), "rb");
+	size_t numRead = 0;
+	if (file) {
+		numRead = fread(points.data(), sizeof(PagedPoint), b.count, file);
+		fclose(file);
+	}
+	if (numRead != b.count) {
+		cout << "StreamingOctreeBuilder: can't read " << bucketPath(bucket) << endl;
+		return false;
+	}
+
+	// cell box:  the same descent as cellOf()
+	//
+	Box box = bounds;
+	for (int level = prefixLevels - 1; level >= 0; level--) {
+		box = octantBox(box, (bucket >> (3 * level)) & 7);
+	}
+
+	// the cell's root is at level prefixLevels + 1
+	//
+	BucketTree tree;
+	{
+		vector<Vector3> p(points.size());
+		for (int64_t i = 0; i < points.size(); i++) p[i] = Vector3(points[i].p[0], points[i].p[1], points[i].p[2]);
+		tree.create(p, box.min(), box.max(), numLevels - prefixLevels);
+	}
+	vector<PagedNode> nodes(tree.nodes.size());
+	for (int n = 0; n < nodes.size(); n++) {
+		const BucketTree::Node& node = tree.nodes[n];
+		memset(&nodes[n], 0, sizeof(PagedNode));
+		setBox(nodes[n].box, Box(node.lo, node.hi));
+		setBox(nodes[n].faceBounds, Box(node.lo, node.hi));
+		nodes[n].firstChild = node.child;
+		nodes[n].numChildren = node.numChildren;
+	}
+
+	// local node i (i >= 1) becomes base + i - 1
+	//
+	vector<PagedPoint> leafPoints;
+	std::lock_guard<std::mutex> lock(mutex);
+	uint32_t base = writer.header.numNodes;
+	for (int n = 0; n < nodes.size(); n++) {
+		if (nodes[n].numChildren > 0) {
+			nodes[n].firstChild += base - 1;
+			continue;
+		}
+		leafPoints.clear();
+		const BucketTree::Node& node = tree.nodes[n];
+		for (uint32_t i = node.begin; i < node.end; i++) leafPoints.push_back(points[tree.order[i]]);
+		writer.addLeafData(nodes[n], leafPoints, vector<PagedFace>());
+	}
+	if (nodes.size() > 1) writer.addNodes(&nodes[1], nodes.size() - 1);
+	b.root = nodes[0];
+	return true;
+}
+
+// buildTop:  record of the node for cell (Morton prefix of level levels),
+//            writing its children first.  false if no points below it
+//
+bool StreamingOctreeBuilder::buildTop(PagedOctreeWriter& writer, const Box& box, uint32_t cell, int level,
+	PagedNode& nodeRtn)
+{
+	if (level == prefixLevels) {
+		if (buckets[cell].count == 0) return false;
+		nodeRtn = buckets[cell].root;
+		return true;
+	}
+	PagedNode children[8];
+	int n = 0;
+	for (int o = 0; o < 8; o++) {
+		if (buildTop(writer, octantBox(box, o), cell * 8 + o, level + 1, children[n])) n++;
+	}
+	if (n == 0) return false;
+	memset(&nodeRtn, 0, sizeof(PagedNode));
+	setBox(nodeRtn.box, box);
+	setBox(nodeRtn.faceBounds, box);
+	nodeRtn.firstChild = writer.addNodes(children, n);
+	nodeRtn.numChildren = n;
+	return true;
+}
@@ -0,0 +1,98 @@
+//--------------------------------------------------------------
+//
+//  StreamingOctree - external memory octree build for huge point sets
+//
+//  Builds a PagedOctree file from points read off disk in chunks, for
+//  sets far too big for Octree::create() (which needs the whole ofMesh
+//  plus index lists per level in memory):
+//
+//      1) bounds:  one pass over the input
+//      2) binning:  a second pass sorts every chunk by the Morton code
+//         of its points' cell prefixLevels levels below the root and
+//         appends each run to that cell's temporary bucket file
+//      3) subtrees:  worker threads take a bucket at a time, load it and
+//         build its subtree in memory, then hand leaf data and nodes to
+//         the PagedOctreeWriter
+//      4) top:  the nodes above the buckets are written last, their
+//         lowest level being the bucket roots
+//
+//  Memory is a chunk of points plus, per worker, the largest bucket and
+//  its nodes.  The tree splits a node at the center of its box like
+//  Octree, a point goes to exactly one child.  A bucket's subtree is a
+//  BucketTree (PointOctree) built in the bucket's cell, so leaves hold up
+//  to its MaxLeaf, 32 points (Octree stops at 1, too many nodes at this
+//  size).  Points only, no faces:  ray queries on the result treat the
+//  leaf boxes as solid, as Octree does for leaves without faces.
+//
+#pragma once
+#include "ofMain.h"
+#include "PagedOctree.h"
+#include "PointOctree.h"
+#include <mutex>
+#include <deque>
+
+// PointStream:  points from a file a chunk at a time.  ".obj" files give
+//               their "v" lines, anything else is read as raw float
+//               x y z triples
+//
+class PointStream {
+public:
+	~PointStream() { close(); }
+
+	bool open(const string& path);
+	void close();
+	int read(vector<Vector3>& pointsRtn, int maxPoints);
+	void rewind();
+
+private:
+	FILE* file = NULL;
+	bool bObj = false;
+};
+
+class StreamingOctreeBuilder {
+public:
+	typedef PointOctree<float, Vector3, uint32_t, 32> BucketTree;
+
+	bool build(const string& inPath, const string& outPath);
+
+	int prefixLevels = 3;		// 8^prefixLevels buckets
+	int maxOpenFiles = 64;		// bucket files open at once while binning (C runtimes
+								// limit open FILEs, to 512 on Windows)
+	int numLevels = 20;			// as Octree::create(), root is level 1
+	int chunkPoints = 1 << 20;
+	int numThreads = 0;			// 0:  one per core
+	string tempDir = ".";
+
+	// results of the last build()
+	//
+	int64_t numPoints = 0;
+	int64_t numNodes = 0;
+	int64_t largestBucket = 0;		// points
+	int numBuckets = 0;				// not empty
+	float boundsTime = 0;			// seconds
+	float binTime = 0;
+	float subtreeTime = 0;
+	float totalTime = 0;
+	int64_t peakMemory = 0;			// bytes, process high water mark (0 if unknown)
+
+private:
+	class Bucket {
+	public:
+		FILE* file = NULL;		// while binning, if open
+		int64_t count = 0;
+		PagedNode root;			// filled in by buildBucket()
+	};
+
+	uint32_t cellOf(const Vector3& p) const;
+	static Box octantBox(const Box& box, int octant);
+	static int octantOf(const Box& box, const Vector3& p);
+	bool buildBucket(int bucket, PagedOctreeWriter& writer, std::mutex& mutex);
+	bool buildTop(PagedOctreeWriter& writer, const Box& box, uint32_t cell, int level, PagedNode& nodeRtn);
+	string bucketPath(int bucket) const;
+	FILE* bucketFile(int bucket);
+	void closeBuckets();
+
+	Box bounds;
+	vector<Bucket> buckets;
+	std::deque<int> openBuckets;	// buckets with a file open, oldest first
+};
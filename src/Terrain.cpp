@@ -0,0 +1,158 @@
+//--------------------------------------------------------------
+//
+//  Terrain - one version of the terrain and everything built from it
+//
+
+#include "Terrain.h"
+#include "ObjLoader.h"
+
+Terrain::~Terrain() {
+	delete index;
+}
+
+// build:  meshes[0] is the terrain, the rest become props (indexed once
+//         each, placed with an identity transform)
+//
+void Terrain::build(const vector<ofMesh>& meshes, int numLevels) {
+	uint64_t start = ofGetElapsedTimeMicros();
+	octree.create(meshes[0], numLevels);
+	countLeaves();
+
+	// coarse occupancy voxels (512 across the terrain) for quick "is anything
+	// here" tests before going to the octree
+	//
+	Vector3 size = octree.root.box.parameters[1] - octree.root.box.parameters[0];
+	occupancy.create(octree, fmaxf(size.x(), fmaxf(size.y(), size.z())) / 512);
+
+	delete index;
+	index = new OctreeIndex(&octree);
+
+	props.clear();
+	for (int i = 1; i < meshes.size(); i++) {
+		props.addInstance(props.addMesh(meshes[i]), glm::mat4(1.0));
+	}
+	buildTime = (ofGetElapsedTimeMicros() - start) / 1000.0;
+}
+
+// countLeaves:  numLeaves from the octree.  after a build and after every
+//               edit:  a crater can empty leaves (they are removed) and
+//               grow the root
+//
+void Terrain::countLeaves() {
+	vector<const TreeNode*> leaves;
+	octree.getLeaves(octree.root, leaves);
+	numLeaves = leaves.size();
+}
+
+bool Terrain::load(const string& path, int numLevels) {
+	vector<ofMesh> meshes;
+	if (!loadObjMeshes(path, meshes)) return false;
+	build(meshes, numLevels);
+	return true;
+}
+
+// replicate:  a copy of this version made entirely by the calling thread
+//             (see TerrainReplicas).  the ray index is the same kind,
+//             and prop instance numbers stay the same
+//
+shared_ptr<Terrain> Terrain::replicate() const {
+	shared_ptr<Terrain> copy = make_shared<Terrain>();
+	copy->octree = octree;
+	copy->occupancy = occupancy;
+	const OctreeIndex* octreeIndex = dynamic_cast<const OctreeIndex*>(index);
+	if (octreeIndex && octreeIndex->octree == &octree) copy->index = new OctreeIndex(&copy->octree);
+	else if (index) {
+		copy->index = makeSpatialIndex(index->name());
+		copy->index->build(copy->octree.mesh);
+	}
+	for (int i = 0; i < props.meshes.size(); i++) copy->props.addMesh(props.meshes[i]->octree->mesh);
+	for (int i = 0; i < props.instances.size(); i++) {
+		const MeshInstance& inst = props.instances[i];
+		if (inst.mesh >= 0) copy->props.addInstance(inst.mesh, inst.transform);
+		else copy->props.instances.push_back(inst);		// removed
+	}
+	copy->version = version;
+	copy->buildTime = buildTime;
+	copy->numLeaves = numLeaves;
+	return copy;
+}
+
+TerrainLoader::TerrainLoader() {
+	bLoading = false;
+	thread = std::thread(&TerrainLoader::run, this);
+}
+
+TerrainLoader::~TerrainLoader() {
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		bStop = true;
+	}
+	wake.notify_all();
+	thread.join();
+}
+
+// current:  the newest published version (any thread)
+//
+shared_ptr<Terrain> TerrainLoader::current() const {
+	return std::atomic_load(&latest);
+}
+
+void TerrainLoader::publish(shared_ptr<Terrain> terrain) {
+	std::atomic_store(&latest, terrain);
+}
+
+// reload:  build a new version from an OBJ file on the loader thread and
+//          publish it when done.  a reload asked for while another is
+//          waiting replaces it
+//
+void TerrainLoader::reload(const string& path) {
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		pendingPath = path;
+		bLoading = true;
+	}
+	wake.notify_all();
+}
+
+// retire:  a version the frame loop no longer uses.  freed on the loader
+//          thread once no one else holds it
+//
+void TerrainLoader::retire(shared_ptr<Terrain> terrain) {
+	if (!terrain) return;
+	std::lock_guard<std::mutex> lock(mutex);
+	retired.push_back(terrain);
+}
+
+void TerrainLoader::run() {
+	while (true) {
+		string path;
+		vector<shared_ptr<Terrain> > unused;
+		{
+			std::unique_lock<std::mutex> lock(mutex);
+			wake.wait_for(lock, std::chrono::milliseconds(100), [this]() { return bStop || pendingPath != ""; });
+			if (bStop) break;
+			path = pendingPath;
+			pendingPath = "";
+			vector<shared_ptr<Terrain> > inUse;
+			for (int i = 0; i < retired.size(); i++) {
+				if (retired[i].use_count() == 1) unused.push_back(retired[i]);
+				else inUse.push_back(retired[i]);
+			}
+			retired.swap(inUse);
+		}
+		unused.clear();		// frees them, outside the lock
+
+		if (path == "") continue;
+		shared_ptr<Terrain> terrain = make_shared<Terrain>();
+		if (terrain->load(path)) {
+			terrain->version = nextVersion++;
+			publish(terrain);
+			cout << "terrain: " << path << " rebuilt in " << terrain->buildTime << " ms (version "
+				<< terrain->version << ")" << endl;
+		}
+		else cout << "terrain: can't load " << path << endl;
+
+		std::lock_guard<std::mutex> lock(mutex);
+		if (pendingPath == "") bLoading = false;
+	}
+}
@@ -0,0 +1,73 @@
+//--------------------------------------------------------------
+//
+//  Terrain - one version of the terrain and everything built from it
+//
+//  The terrain mesh (first mesh of the model) with its octree, occupancy
+//  grid and ray query index, plus the model's other meshes as instanced
+//  props.  A version is built once and then shared read only through a
+//  shared_ptr; in place edits (craters) need the QueryService drained.
+//
+//  TerrainLoader rebuilds terrain from an OBJ file on a background
+//  thread and publishes the new version with an atomic pointer store.
+//  The frame loop picks it up with an atomic load and swaps its own
+//  pointer, it never waits for a build.  Readers that still hold the
+//  old version (query batches in flight) keep it alive; once the frame
+//  loop has retired it and the last reader lets go, the loader thread
+//  frees it, so that never lands on the frame either.
+//
+#pragma once
+#include "ofMain.h"
+#include "Octree.h"
+#include "OccupancyGrid.h"
+#include "SpatialIndex.h"
+#include "InstancedScene.h"
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+
+class Terrain {
+public:
+	Terrain() { }
+	Terrain(const Terrain&) = delete;				// owns index, see replicate()
+	Terrain& operator=(const Terrain&) = delete;
+	~Terrain();
+
+	void build(const vector<ofMesh>& meshes, int numLevels = 20);
+	bool load(const string& path, int numLevels = 20);
+	shared_ptr<Terrain> replicate() const;
+	void countLeaves();
+
+	Octree octree;
+	OccupancyGrid occupancy;
+	SpatialIndex* index = NULL;		// terrain ray queries, owned
+	InstancedScene props;
+	int version = 0;
+	float buildTime = 0;			// ms
+	int numLeaves = 0;				// octree leaves, see countLeaves()
+};
+
+class TerrainLoader {
+public:
+	TerrainLoader();
+	~TerrainLoader();
+
+	shared_ptr<Terrain> current() const;
+	void publish(shared_ptr<Terrain> terrain);
+	void reload(const string& path);
+	void retire(shared_ptr<Terrain> terrain);
+	bool isLoading() const { return bLoading; }
+
+private:
+	void run();
+
+	shared_ptr<Terrain> latest;		// only through atomic_load / atomic_store
+	std::thread thread;
+	std::mutex mutex;
+	std::condition_variable wake;
+	string pendingPath;				// newest reload() not started yet, "" if none
+	vector<shared_ptr<Terrain> > retired;
+	std::atomic<bool> bLoading;
+	bool bStop = false;
+	int nextVersion = 1;
+};
@@ -0,0 +1,311 @@
+//--------------------------------------------------------------
+//
+//  TerrainTiles - terrain streamed in tiles around the lander
+//
+
+#include "TerrainTiles.h"
+#include "ObjLoader.h"
+#include <fstream>
+#include <unordered_map>
+
+TerrainTiles::~TerrainTiles() {
+	stop();
+}
+
+// open:  tiles from OBJ files dir/tile_<i>_<j>.obj (data path relative)
+//
+bool TerrainTiles::open(const string& dir, float tileSize, int numLoaders) {
+	if (!ofDirectory::doesDirectoryExist(dir)) return false;
+	start([dir](int i, int j, vector<ofMesh>& meshesRtn) {
+		return loadObjMeshes(dir + "/tile_" + ofToString(i) + "_" + ofToString(j) + ".obj", meshesRtn);
+	}, tileSize, numLoaders);
+	return true;
+}
+
+// start:  source(i, j, meshes) gives the meshes of tile (i, j) (the first
+//         is the ground, the rest props, as Terrain::build()), false if
+//         there is no such tile.  it runs on the loader threads
+//
+void TerrainTiles::start(Source source, float tileSize, int numLoaders) {
+	stop();
+	this->source = source;
+	this->tileSize = tileSize;
+	numBuilt = numEvicted = numMissing = 0;
+	maxBuildTime = maxUpdateTime = 0;
+	bStop = false;
+	std::atomic_store(&current, shared_ptr<const TileList>(new TileList()));
+	for (int i = 0; i < max(numLoaders, 1); i++) loaders.push_back(std::thread(&TerrainTiles::run, this));
+}
+
+// stop:  end the loaders (after the tiles they are building) and drop
+//        every tile
+//
+void TerrainTiles::stop() {
+	if (loaders.size() == 0) return;
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		bStop = true;
+	}
+	wake.notify_all();
+	for (int i = 0; i < loaders.size(); i++) loaders[i].join();
+	loaders.clear();
+	pending.clear();
+	ready.clear();
+	retired.clear();
+	loaded.clear();
+	requested.clear();
+	std::atomic_store(&current, shared_ptr<const TileList>(new TileList()));
+}
+
+// snapshot:  the tiles loaded as of the last update() (any thread).  the
+//            tiles stay alive while the snapshot is held
+//
+shared_ptr<const TileList> TerrainTiles::snapshot() const {
+	return std::atomic_load(&current);
+}
+
+void TerrainTiles::tileOf(const Vector3& p, int& iRtn, int& jRtn) const {
+	iRtn = (int)floor(p.x() / tileSize);
+	jRtn = (int)floor(p.z() / tileSize);
+}
+
+// distance:  from p to the tile's square, on the x-z plane
+//
+float TerrainTiles::distance(const Key& key, const Vector3& p) const {
+	float x0 = key.first * tileSize, z0 = key.second * tileSize;
+	float dx = fmaxf(0, fmaxf(x0 - p.x(), p.x() - (x0 + tileSize)));
+	float dz = fmaxf(0, fmaxf(z0 - p.z(), p.z() - (z0 + tileSize)));
+	return sqrt(dx * dx + dz * dz);
+}
+
+// update:  frame thread, once a frame with the lander position.  takes
+//          in finished tiles, evicts far ones, asks for near ones and
+//          publishes a new snapshot if the loaded set changed
+//
+void TerrainTiles::update(const Vector3& center) {
+	if (loaders.size() == 0) return;
+	uint64_t start = ofGetElapsedTimeMicros();
+	vector<shared_ptr<TerrainTile> > done;
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		done.swap(ready);
+		focus = center;
+	}
+
+	bool bChanged = false;
+	vector<shared_ptr<const TerrainTile> > dropped;
+	for (int k = 0; k < done.size(); k++) {
+		Key key(done[k]->i, done[k]->j);
+		if (requested.erase(key) == 0) continue;
+		if (done[k]->terrain) {
+			numBuilt++;
+			maxBuildTime = fmaxf(maxBuildTime, done[k]->terrain->buildTime);
+		}
+		else numMissing++;
+		if (distance(key, center) > evictRadius) {
+			dropped.push_back(done[k]);
+			continue;
+		}
+		loaded[key] = done[k];		// kept even if missing, so it isn't asked for again
+		bChanged = bChanged || done[k]->terrain;
+	}
+	for (auto it = loaded.begin(); it != loaded.end();) {
+		if (distance(it->first, center) <= evictRadius) {
+			it++;
+			continue;
+		}
+		if (it->second->terrain) {
+			numEvicted++;
+			bChanged = true;
+		}
+		dropped.push_back(it->second);
+		it = loaded.erase(it);
+	}
+
+	vector<Key> wanted;
+	int i0, j0, i1, j1;
+	tileOf(center - Vector3(loadRadius, 0, loadRadius), i0, j0);
+	tileOf(center + Vector3(loadRadius, 0, loadRadius), i1, j1);
+	for (int i = i0; i <= i1; i++) {
+		for (int j = j0; j <= j1; j++) {
+			Key key(i, j);
+			if (distance(key, center) > loadRadius) continue;
+			if (loaded.count(key) || requested.count(key)) continue;
+			wanted.push_back(key);
+			requested.insert(key);
+		}
+	}
+
+	// requests not started that are out of range now are cancelled
+	//
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		for (int k = 0; k < pending.size();) {
+			if (distance(pending[k], center) > evictRadius) {
+				requested.erase(pending[k]);
+				pending[k] = pending.back();
+				pending.pop_back();
+			}
+			else k++;
+		}
+		pending.insert(pending.end(), wanted.begin(), wanted.end());
+		retired.insert(retired.end(), dropped.begin(), dropped.end());
+	}
+	if (wanted.size() > 0) wake.notify_all();
+
+	if (bChanged) {
+		TileList* tiles = new TileList();
+		for (auto it = loaded.begin(); it != loaded.end(); it++) {
+			if (it->second->terrain) tiles->push_back(it->second);
+		}
+		std::atomic_store(&current, shared_ptr<const TileList>(tiles));
+	}
+	maxUpdateTime = fmaxf(maxUpdateTime, (ofGetElapsedTimeMicros() - start) / 1000.0);
+}
+
+// run:  loader thread.  builds the pending tile nearest the lander, and
+//       frees evicted tiles no snapshot holds any more
+//
+void TerrainTiles::run() {
+	while (true) {
+		Key key;
+		bool bWork = false;
+		vector<shared_ptr<const TerrainTile> > unused;
+		{
+			std::unique_lock<std::mutex> lock(mutex);
+			wake.wait_for(lock, std::chrono::milliseconds(100), [this]() { return bStop || pending.size() > 0; });
+			if (bStop) break;
+			vector<shared_ptr<const TerrainTile> > inUse;
+			for (int k = 0; k < retired.size(); k++) {
+				if (retired[k].use_count() == 1) unused.push_back(retired[k]);
+				else inUse.push_back(retired[k]);
+			}
+			retired.swap(inUse);
+
+			int nearest = -1;
+			for (int k = 0; k < pending.size(); k++) {
+				if (nearest == -1 || distance(pending[k], focus) < distance(pending[nearest], focus)) nearest = k;
+			}
+			if (nearest != -1) {
+				key = pending[nearest];
+				pending.erase(pending.begin() + nearest);
+				bWork = true;
+			}
+		}
+		unused.clear();		// frees them, outside the lock
+
+		if (!bWork) continue;
+		shared_ptr<TerrainTile> tile = make_shared<TerrainTile>();
+		tile->i = key.first;
+		tile->j = key.second;
+		vector<ofMesh> meshes;
+		if (source(key.first, key.second, meshes) && meshes.size() > 0 && meshes[0].getNumVertices() > 0) {
+			tile->terrain = make_shared<Terrain>();
+			tile->terrain->build(meshes, numLevels);
+			tile->bounds = tile->terrain->octree.root.box;
+		}
+		std::lock_guard<std::mutex> lock(mutex);
+		ready.push_back(tile);
+	}
+}
+
+// intersectRay:  closest hit for t in (t0, t1) over the tiles, visited
+//                in the order the ray reaches them
+//
+bool TerrainTiles::intersectRay(const TileList& tiles, const Ray& ray, float t0, float t1, TileHit& hitRtn) {
+	vector<std::pair<float, int> > order;
+	for (int k = 0; k < tiles.size(); k++) {
+		float tNear, tFar;
+		if (tiles[k]->terrain->octree.root.faceBounds.intersect(ray, t0, t1, tNear, tFar)) {
+			order.push_back(std::make_pair(tNear, k));
+		}
+	}
+	sort(order.begin(), order.end());
+	hitRtn.tile = -1;
+	float best = t1;
+	for (int k = 0; k < order.size(); k++) {
+		if (order[k].first >= best) break;
+		RayHit hit;
+		if (tiles[order[k].second]->terrain->index->intersectRay(ray, t0, best, hit)) {
+			best = hit.t;
+			hitRtn.t = hit.t;
+			hitRtn.face = hit.face;
+			hitRtn.tile = order[k].second;
+		}
+	}
+	return hitRtn.tile != -1;
+}
+
+bool TerrainTiles::intersectAny(const TileList& tiles, const Ray& ray, float t0, float t1) {
+	for (int k = 0; k < tiles.size(); k++) {
+		const Terrain& terrain = *tiles[k]->terrain;
+		if (!terrain.octree.root.faceBounds.intersect(ray, t0, t1)) continue;
+		if (terrain.index->intersectAny(ray, t0, t1)) return true;
+	}
+	return false;
+}
+
+// intersect:  octree leaf boxes overlapping box, from every tile (as
+//             Octree::intersect(Box...))
+//
+bool TerrainTiles::intersect(const TileList& tiles, const Box& box, vector<Box>& boxListRtn) {
+	bool intersects = false;
+	for (int k = 0; k < tiles.size(); k++) {
+		const Octree& octree = tiles[k]->terrain->octree;
+		if (octree.intersect(box, octree.root, boxListRtn)) intersects = true;
+	}
+	return intersects;
+}
+
+int TerrainTiles::overlapping(const TileList& tiles, const Box& box, vector<int>& tilesRtn) {
+	tilesRtn.clear();
+	for (int k = 0; k < tiles.size(); k++) {
+		if (tiles[k]->bounds.overlap(box)) tilesRtn.push_back(k);
+	}
+	return tilesRtn.size();
+}
+
+// writeTiles:  dir is created if needed.  vertices on tile borders are
+//              written to every tile using them
+//
+int TerrainTiles::writeTiles(const ofMesh& mesh, float tileSize, const string& dir) {
+	ofDirectory::createDirectory(dir, true, true);
+	int numFaces = (mesh.getNumIndices() > 0) ? mesh.getNumIndices() / 3 : mesh.getNumVertices() / 3;
+
+	class TileMesh {
+	public:
+		vector<glm::vec3> verts;
+		vector<int> faces;					// 0 based, into verts
+		unordered_map<int, int> remap;		// mesh vertex to verts
+	};
+	std::map<Key, TileMesh> tiles;
+	for (int f = 0; f < numFaces; f++) {
+		int index[3];
+		glm::vec3 c(0, 0, 0);
+		for (int k = 0; k < 3; k++) {
+			index[k] = (mesh.getNumIndices() > 0) ? mesh.getIndex(f * 3 + k) : f * 3 + k;
+			c += mesh.getVertex(index[k]) / 3.0f;
+		}
+		TileMesh& tile = tiles[Key((int)floor(c.x / tileSize), (int)floor(c.z / tileSize))];
+		for (int k = 0; k < 3; k++) {
+			auto it = tile.remap.find(index[k]);
+			if (it == tile.remap.end()) {
+				it = tile.remap.insert(make_pair(index[k], (int)tile.verts.size())).first;
+				tile.verts.push_back(mesh.getVertex(index[k]));
+			}
+			tile.faces.push_back(it->second);
+		}
+	}
+
+	for (auto it = tiles.begin(); it != tiles.end(); it++) {
+		ofstream out(ofToDataPath(dir + "/tile_" + ofToString(it->first.first) + "_" + ofToString(it->first.second) + ".obj"));
+		const TileMesh& tile = it->second;
+		for (int i = 0; i < tile.verts.size(); i++) {
+			out << "v " << tile.verts[i].x << " " << tile.verts[i].y << " " << tile.verts[i].z << "\n";
+		}
+		for (int i = 0; i + 2 < tile.faces.size(); i += 3) {
+			out << "f " << tile.faces[i] + 1 << " " << tile.faces[i + 1] + 1 << " " << tile.faces[i + 2] + 1 << "\n";
+		}
+	}
+	return tiles.size();
+}
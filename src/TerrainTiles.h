@@ -0,0 +1,108 @@
+//--------------------------------------------------------------
+//
+//  TerrainTiles - terrain streamed in tiles around the lander
+//
+//  For worlds bigger than one Terrain can hold.  The ground is cut into
+//  square tiles on the x-z plane, tile (i, j) covering x in
+//  [i * tileSize, (i + 1) * tileSize] and z likewise, each a Terrain of
+//  its own (mesh, octree, occupancy, ray index).  Tiles come from a
+//  source function, by default OBJ files dir/tile_<i>_<j>.obj as written
+//  by writeTiles().
+//
+//  update() (frame thread, once a frame) asks for the tiles within
+//  loadRadius of the lander, nearest first, and loader threads build
+//  them; it takes in the tiles finished since last frame and drops the
+//  ones further than evictRadius.  It only ever holds a lock to move a
+//  few pointers:  building a tile and freeing an evicted one both
+//  happen on the loader threads, so no frame waits for either.
+//
+//  The loaded set is published as a TileList snapshot (atomic pointer
+//  swap, as TerrainLoader does for whole terrains).  Queries run on a
+//  snapshot from any thread and go across tile borders:  a ray is tried
+//  on every tile it passes through, nearest first.  Tiles share their
+//  border vertices, so the seams have no gaps.
+//
+#pragma once
+#include "ofMain.h"
+#include "Terrain.h"
+#include <functional>
+#include <map>
+#include <set>
+
+class TerrainTile {
+public:
+	int i = 0, j = 0;
+	Box bounds;					// mesh bounds
+	shared_ptr<Terrain> terrain;
+};
+
+typedef vector<shared_ptr<const TerrainTile> > TileList;
+
+class TileHit {
+public:
+	float t = 0;
+	int face = -1;
+	int tile = -1;				// index into the TileList
+};
+
+class TerrainTiles {
+public:
+	typedef std::function<bool(int i, int j, vector<ofMesh>& meshesRtn)> Source;
+
+	~TerrainTiles();
+
+	bool open(const string& dir, float tileSize, int numLoaders = 1);
+	void start(Source source, float tileSize, int numLoaders = 1);
+	void stop();
+	void update(const Vector3& center);
+	shared_ptr<const TileList> snapshot() const;
+
+	bool isStarted() const { return loaders.size() > 0; }
+	int numLoaded() const { return snapshot()->size(); }
+	void tileOf(const Vector3& p, int& iRtn, int& jRtn) const;
+
+	// queries on a snapshot, any thread
+	//
+	static bool intersectRay(const TileList& tiles, const Ray& ray, float t0, float t1, TileHit& hitRtn);
+	static bool intersectAny(const TileList& tiles, const Ray& ray, float t0, float t1);
+	static bool intersect(const TileList& tiles, const Box& box, vector<Box>& boxListRtn);
+	static int overlapping(const TileList& tiles, const Box& box, vector<int>& tilesRtn);
+
+	// cut a mesh into tile OBJ files for open().  a face goes to the tile
+	// holding its centroid.  returns the number of tiles written
+	//
+	static int writeTiles(const ofMesh& mesh, float tileSize, const string& dir);
+
+	float tileSize = 100;
+	float loadRadius = 150;		// start loading tiles this close (x-z distance)
+	float evictRadius = 250;	// drop tiles further than this
+	int numLevels = 20;			// octree levels per tile
+
+	// counts since start()
+	//
+	int64_t numBuilt = 0;
+	int64_t numEvicted = 0;
+	int64_t numMissing = 0;		// the source had no tile
+	float maxBuildTime = 0;		// ms, on a loader thread
+	float maxUpdateTime = 0;	// ms, update() on the frame thread
+
+private:
+	typedef std::pair<int, int> Key;
+
+	float distance(const Key& key, const Vector3& p) const;
+	void run();
+
+	Source source;
+	std::map<Key, shared_ptr<const TerrainTile> > loaded;	// frame thread only
+	std::set<Key> requested;								// frame thread only:  asked for, not back yet
+	shared_ptr<const TileList> current = shared_ptr<const TileList>(new TileList());	// only through atomic_load / atomic_store
+
+	vector<std::thread> loaders;
+	std::mutex mutex;
+	std::condition_variable wake;
+	vector<Key> pending;					// not started
+	vector<shared_ptr<TerrainTile> > ready;	// built (terrain NULL if the source had none)
+	vector<shared_ptr<const TerrainTile> > retired;
+	Vector3 focus = Vector3(0, 0, 0);		// center at the last update(), for load order
+	bool bStop = false;
+};
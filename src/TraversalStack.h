@@ -0,0 +1,35 @@
+//--------------------------------------------------------------
+//
+//  TraversalStack - the node stack of an iterative tree walk
+//
+//  The first N entries live in the stack frame, which covers the trees
+//  the walks normally see, with no allocation.  A deeper (degenerate)
+//  tree spills the rest into a vector rather than skipping subtrees.
+//
+#pragma once
+#include <vector>
+
+using std::vector;
+
+template <class T, int N = 64>
+class TraversalStack {
+public:
+	void push(const T& entry) {
+		if (count < N) fixed[count] = entry;
+		else spill.push_back(entry);
+		count++;
+	}
+	T pop() {
+		count--;
+		if (count < N) return fixed[count];
+		T entry = spill.back();
+		spill.pop_back();
+		return entry;
+	}
+	bool empty() const { return count == 0; }
+
+private:
+	T fixed[N];
+	vector<T> spill;
+	int count = 0;
+};
@@ -0,0 +1,88 @@
+#ifndef _TRIANGLE_H_
+#define _TRIANGLE_H_
+
+#include <math.h>
+#include "vector3.h"
+
+/*
+ * Triangle tests on Vector3, used by the narrow phase.
+ *
+ * triTriOverlap() is a separating axis test.  Two triangles are disjoint
+ * if and only if their projections are disjoint on one of: the two face
+ * normals, the 9 edge x edge cross products, or (for the coplanar case)
+ * the 6 in-plane edge normals.  Testing the extra axes when the triangles
+ * are not coplanar is harmless, so all 17 are always tried.
+ *
+ * rayTriangle() is the Moller-Trumbore test:
+ *
+ *      Tomas Moller and Ben Trumbore
+ *      "Fast, Minimum Storage Ray-Triangle Intersection"
+ *      Journal of graphics tools, 2(1):21-28, 1997
+ *
+ */
+
+// project triangle t on axis, return interval in (tmin, tmax)
+//
+inline void triProject(const Vector3 t[3], const Vector3& axis, float& tmin, float& tmax) {
+	float d0 = t[0] * axis;
+	float d1 = t[1] * axis;
+	float d2 = t[2] * axis;
+	tmin = fminf(d0, fminf(d1, d2));
+	tmax = fmaxf(d0, fmaxf(d1, d2));
+}
+
+// true if axis separates the two triangles (degenerate axes never separate)
+//
+inline bool triSeparated(const Vector3 a[3], const Vector3 b[3], const Vector3& axis) {
+	if (axis * axis < 1e-12f) return false;
+	float amin, amax, bmin, bmax;
+	triProject(a, axis, amin, amax);
+	triProject(b, axis, bmin, bmax);
+	return (amax < bmin || bmax < amin);
+}
+
+inline bool triTriOverlap(const Vector3 a[3], const Vector3 b[3]) {
+	Vector3 ea[3] = { a[1] - a[0], a[2] - a[1], a[0] - a[2] };
+	Vector3 eb[3] = { b[1] - b[0], b[2] - b[1], b[0] - b[2] };
+	Vector3 na = ea[0] ^ ea[1];
+	Vector3 nb = eb[0] ^ eb[1];
+
+	if (triSeparated(a, b, na)) return false;
+	if (triSeparated(a, b, nb)) return false;
+	for (int i = 0; i < 3; i++) {
+		for (int j = 0; j < 3; j++) {
+			if (triSeparated(a, b, ea[i] ^ eb[j])) return false;
+		}
+	}
+	for (int i = 0; i < 3; i++) {
+		if (triSeparated(a, b, na ^ ea[i])) return false;
+		if (triSeparated(a, b, nb ^ eb[i])) return false;
+	}
+	return true;
+}
+
+// ray origin + t * dir against triangle t, hit only counts for t in (t0, t1).
+// returns hit distance in tRtn
+//
+inline bool rayTriangle(const Vector3& origin, const Vector3& dir, const Vector3 t[3],
+	float t0, float t1, float& tRtn)
+{
+	Vector3 e1 = t[1] - t[0];
+	Vector3 e2 = t[2] - t[0];
+	Vector3 p = dir ^ e2;
+	float det = e1 * p;
+	if (fabsf(det) < 1e-12f) return false;
+	float inv = 1 / det;
+	Vector3 s = origin - t[0];
+	float u = (s * p) * inv;
+	if (u < 0 || u > 1) return false;
+	Vector3 q = s ^ e1;
+	float v = (dir * q) * inv;
+	if (v < 0 || u + v > 1) return false;
+	float dist = (e2 * q) * inv;
+	if (dist <= t0 || dist >= t1) return false;
+	tRtn = dist;
+	return true;
+}
+
+#endif // _TRIANGLE_H_
@@ -0,0 +1,164 @@
+//--------------------------------------------------------------
+//
+//  UniformGrid - uniform grid backend for SpatialIndex
+//
+
+#include "UniformGrid.h"
+#include "Triangle.h"
+#include <float.h>
+
+void UniformGridIndex::build(const ofMesh& mesh) {
+	cellStart.clear();
+	cellFaces.clear();
+	int n = numFaces(mesh);
+	verts.resize(n * 3);
+	faceBoxes.resize(n);
+	for (int f = 0; f < n; f++) {
+		faceVerts(mesh, f, &verts[f * 3]);
+		faceBoxes[f] = faceBox(&verts[f * 3]);
+	}
+	if (n == 0) return;
+	bounds = faceBoxes[0];
+	for (int f = 1; f < n; f++) bounds.expand(faceBoxes[f]);
+
+	// cube cells, about cellsPerFace * n of them.  flat axes (a height
+	// field seen edge on) get one cell
+	//
+	Vector3 size = bounds.parameters[1] - bounds.parameters[0];
+	float longest = fmaxf(size.x(), fmaxf(size.y(), size.z()));
+	float volume = 1;
+	int dims = 0;
+	for (int i = 0; i < 3; i++) {
+		if (size[i] > longest * 1e-3f) {
+			volume *= size[i];
+			dims++;
+		}
+	}
+	float cell = powf(volume / (cellsPerFace * n), 1.0f / dims);
+	for (int i = 0; i < 3; i++) {
+		res[i] = (size[i] > longest * 1e-3f) ? (int)ofClamp(ceilf(size[i] / cell), 1, 1024) : 1;
+	}
+	cellSize = Vector3(fmaxf(size.x(), 1e-6f) / res[0], fmaxf(size.y(), 1e-6f) / res[1], fmaxf(size.z(), 1e-6f) / res[2]);
+
+	// count, prefix sum, fill
+	//
+	int numCells = res[0] * res[1] * res[2];
+	cellStart.assign(numCells + 1, 0);
+	int lo[3], hi[3];
+	for (int f = 0; f < n; f++) {
+		cellRange(faceBoxes[f], lo, hi);
+		for (int z = lo[2]; z <= hi[2]; z++)
+			for (int y = lo[1]; y <= hi[1]; y++)
+				for (int x = lo[0]; x <= hi[0]; x++)
+					cellStart[cellIndex(x, y, z) + 1]++;
+	}
+	for (int c = 0; c < numCells; c++) cellStart[c + 1] += cellStart[c];
+	cellFaces.resize(cellStart[numCells]);
+	vector<int> fill(cellStart.begin(), cellStart.end() - 1);
+	for (int f = 0; f < n; f++) {
+		cellRange(faceBoxes[f], lo, hi);
+		for (int z = lo[2]; z <= hi[2]; z++)
+			for (int y = lo[1]; y <= hi[1]; y++)
+				for (int x = lo[0]; x <= hi[0]; x++)
+					cellFaces[fill[cellIndex(x, y, z)]++] = f;
+	}
+}
+
+// cellRange:  range of cells touched by box, clamped to the grid
+//
+void UniformGridIndex::cellRange(const Box& box, int lo[3], int hi[3]) const {
+	for (int i = 0; i < 3; i++) {
+		lo[i] = (int)floorf((box.parameters[0][i] - bounds.parameters[0][i]) / cellSize[i]);
+		hi[i] = (int)floorf((box.parameters[1][i] - bounds.parameters[0][i]) / cellSize[i]);
+		lo[i] = max(0, min(lo[i], res[i] - 1));
+		hi[i] = max(0, min(hi[i], res[i] - 1));
+	}
+}
+
+bool UniformGridIndex::intersectRay(const Ray& ray, float t0, float t1, RayHit& hitRtn) const {
+	return intersect(ray, t0, t1, false, hitRtn);
+}
+
+bool UniformGridIndex::intersectAny(const Ray& ray, float t0, float t1) const {
+	RayHit hit;
+	return intersect(ray, t0, t1, true, hit);
+}
+
+bool UniformGridIndex::intersect(const Ray& ray, float t0, float t1, bool anyHit, RayHit& hitRtn) const {
+	if (cellStart.size() == 0) return false;
+	float tNear, tFar;
+	if (!bounds.intersect(ray, t0, t1, tNear, tFar)) return false;
+
+	Vector3 p = ray.origin + ray.direction * tNear;
+	int cell[3], step[3];
+	float tMax[3], tDelta[3];
+	for (int i = 0; i < 3; i++) {
+		cell[i] = (int)floorf((p[i] - bounds.parameters[0][i]) / cellSize[i]);
+		cell[i] = max(0, min(cell[i], res[i] - 1));
+		float lo = bounds.parameters[0][i] + cell[i] * cellSize[i];
+		if (ray.direction[i] > 0) {
+			step[i] = 1;
+			tMax[i] = tNear + (lo + cellSize[i] - p[i]) / ray.direction[i];
+			tDelta[i] = cellSize[i] / ray.direction[i];
+		}
+		else if (ray.direction[i] < 0) {
+			step[i] = -1;
+			tMax[i] = tNear + (lo - p[i]) / ray.direction[i];
+			tDelta[i] = -cellSize[i] / ray.direction[i];
+		}
+		else {
+			step[i] = 0;
+			tMax[i] = FLT_MAX;
+			tDelta[i] = FLT_MAX;
+		}
+	}
+
+	float best = t1;
+	int bestFace = -1;
+	while (true) {
+		int c = cellIndex(cell[0], cell[1], cell[2]);
+		float t;
+		for (int i = cellStart[c]; i < cellStart[c + 1]; i++) {
+			int f = cellFaces[i];
+			if (rayTriangle(ray.origin, ray.direction, &verts[f * 3], t0, best, t)) {
+				if (anyHit) return true;
+				best = t;
+				bestFace = f;
+			}
+		}
+		int axis = 0;
+		if (tMax[1] < tMax[axis]) axis = 1;
+		if (tMax[2] < tMax[axis]) axis = 2;
+
+		// a hit before the cell exit can't be beaten further along
+		//
+		if (bestFace >= 0 && best <= tMax[axis]) break;
+		if (tMax[axis] > tFar) break;
+		cell[axis] += step[axis];
+		if (cell[axis] < 0 || cell[axis] >= res[axis]) break;
+		tMax[axis] += tDelta[axis];
+	}
+	if (bestFace < 0) return false;
+	hitRtn.t = best;
+	hitRtn.face = bestFace;
+	return true;
+}
+
+int UniformGridIndex::overlap(const Box& box, vector<int>& facesRtn) const {
+	if (cellStart.size() == 0) return 0;
+	if (!box.overlap(bounds)) return 0;
+	int count = facesRtn.size();
+	int lo[3], hi[3];
+	cellRange(box, lo, hi);
+	for (int z = lo[2]; z <= hi[2]; z++)
+		for (int y = lo[1]; y <= hi[1]; y++)
+			for (int x = lo[0]; x <= hi[0]; x++) {
+				int c = cellIndex(x, y, z);
+				for (int i = cellStart[c]; i < cellStart[c + 1]; i++) {
+					if (faceBoxes[cellFaces[i]].overlap(box)) facesRtn.push_back(cellFaces[i]);
+				}
+			}
+	sort(facesRtn.begin() + count, facesRtn.end());
+	facesRtn.erase(unique(facesRtn.begin() + count, facesRtn.end()), facesRtn.end());
+	return facesRtn.size() - count;
+}
@@ -0,0 +1,39 @@
+//--------------------------------------------------------------
+//
+//  UniformGrid - one level grid over the faces of a mesh
+//
+//  The mesh bounds are cut into about as many cells as there are
+//  faces (cube shaped as far as possible).  Each face is listed in
+//  every cell its bounding box touches; the lists are stored flat,
+//  cell c owns cellFaces[cellStart[c] .. cellStart[c+1] - 1].
+//
+//  Rays are walked cell by cell (Amanatides & Woo DDA); a hit only
+//  counts once it is inside the current cell, since a face listed in
+//  more than one cell may have a nearer hit further along.
+//
+#pragma once
+#include "SpatialIndex.h"
+
+class UniformGridIndex : public SpatialIndex {
+public:
+	string name() const { return "uniform grid"; }
+	void build(const ofMesh& mesh);
+	bool intersectRay(const Ray& ray, float t0, float t1, RayHit& hitRtn) const;
+	bool intersectAny(const Ray& ray, float t0, float t1) const;
+	int overlap(const Box& box, vector<int>& facesRtn) const;
+
+	vector<int> cellStart;
+	vector<int> cellFaces;
+	vector<Vector3> verts;		// 3 per face
+	vector<Box> faceBoxes;
+	Box bounds;
+	int res[3] = { 0, 0, 0 };
+	Vector3 cellSize;
+
+	float cellsPerFace = 1;
+
+private:
+	int cellIndex(int x, int y, int z) const { return (z * res[1] + y) * res[0] + x; }
+	void cellRange(const Box& box, int lo[3], int hi[3]) const;
+	bool intersect(const Ray& ray, float t0, float t1, bool anyHit, RayHit& hitRtn) const;
+};
@@ -12,8 +12,9 @@
  *
  */
 
-bool Box::intersect(const Ray& r, float t0, float t1) const {
-    float tmin, tmax, tymin, tymax, tzmin, tzmax;
+template <class T>
+bool TBox<T>::intersect(const TRay<T>& r, T t0, T t1) const {
+    T tmin, tmax, tymin, tymax, tzmin, tzmax;
 
     tmin = (parameters[r.sign[0]].x() - r.origin.x()) * r.inv_direction.x();
     tmax = (parameters[1 - r.sign[0]].x() - r.origin.x()) * r.inv_direction.x();
@@ -35,3 +36,35 @@ bool Box::intersect(const Ray& r, float t0, float t1) const {
         tmax = tzmax;
     return ((tmin < t1) && (tmax > t0));
 }
+
+template <class T>
+bool TBox<T>::intersect(const TRay<T>& r, T t0, T t1, T& tNear, T& tFar) const {
+    T tmin, tmax, tymin, tymax, tzmin, tzmax;
+
+    tmin = (parameters[r.sign[0]].x() - r.origin.x()) * r.inv_direction.x();
+    tmax = (parameters[1 - r.sign[0]].x() - r.origin.x()) * r.inv_direction.x();
+    tymin = (parameters[r.sign[1]].y() - r.origin.y()) * r.inv_direction.y();
+    tymax = (parameters[1 - r.sign[1]].y() - r.origin.y()) * r.inv_direction.y();
+    if ((tmin > tymax) || (tymin > tmax))
+        return false;
+    if (tymin > tmin)
+        tmin = tymin;
+    if (tymax < tmax)
+        tmax = tymax;
+    tzmin = (parameters[r.sign[2]].z() - r.origin.z()) * r.inv_direction.z();
+    tzmax = (parameters[1 - r.sign[2]].z() - r.origin.z()) * r.inv_direction.z();
+    if ((tmin > tzmax) || (tzmin > tmax))
+        return false;
+    if (tzmin > tmin)
+        tmin = tzmin;
+    if (tzmax < tmax)
+        tmax = tzmax;
+    if (!((tmin < t1) && (tmax > t0)))
+        return false;
+    tNear = (tmin > t0) ? tmin : t0;
+    tFar = (tmax < t1) ? tmax : t1;
+    return true;
+}
+
+template class TBox<float>;
+template class TBox<double>;
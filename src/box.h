@@ -15,28 +15,31 @@
  *
  */
 
-class Box {
+template <class T>
+class TBox {
 public:
-	Box() { }
-	Box(const Vector3& min, const Vector3& max) {
+	TBox() { }
+	TBox(const TVector3<T>& min, const TVector3<T>& max) {
 		//     assert(min < max);
 		parameters[0] = min;
 		parameters[1] = max;
 	}
 	// (t0, t1) is the interval for valid hits
-	bool intersect(const Ray&, float t0, float t1) const;
+	bool intersect(const TRay<T>&, T t0, T t1) const;
+	// same, but also return the part of (t0, t1) inside the box
+	bool intersect(const TRay<T>&, T t0, T t1, T& tNear, T& tFar) const;
 
 	// corners
-	Vector3 parameters[2];
+	TVector3<T> parameters[2];
 
-	Vector3 min() { return parameters[0]; }
-	Vector3 max() { return parameters[1]; }
-	const bool inside(const Vector3& p) {
+	TVector3<T> min() const { return parameters[0]; }
+	TVector3<T> max() const { return parameters[1]; }
+	bool inside(const TVector3<T>& p) const {
 		return ((p.x() >= parameters[0].x() && p.x() <= parameters[1].x()) &&
 			(p.y() >= parameters[0].y() && p.y() <= parameters[1].y()) &&
 			(p.z() >= parameters[0].z() && p.z() <= parameters[1].z()));
 	}
-	const bool inside(Vector3* points, int size) {
+	bool inside(const TVector3<T>* points, int size) const {
 		bool allInside = true;
 		for (int i = 0; i < size; i++) {
 			if (!inside(points[i])) allInside = false;
@@ -47,7 +50,7 @@ public:
 
 	// implement for Homework Project
 	//
-	bool overlap(const Box& box) {
+	bool overlap(const TBox& box) const {
 		if ((parameters[0].x() <= box.parameters[1].x() && parameters[1].x() >= box.parameters[0].x()) &&
 			(parameters[0].y() <= box.parameters[1].y() && parameters[1].y() >= box.parameters[0].y()) &&
 			(parameters[0].z() <= box.parameters[1].z() && parameters[1].z() >= box.parameters[0].z())) {
@@ -56,9 +59,27 @@ public:
 		return false;
 	}
 
-	Vector3 center() {
+	TVector3<T> center() const {
 		return ((max() - min()) / 2 + min());
 	}
+
+	// grow the box to take in p / b
+	//
+	void expand(const TVector3<T>& p) {
+		parameters[0] = TVector3<T>(p.x() < parameters[0].x() ? p.x() : parameters[0].x(),
+			p.y() < parameters[0].y() ? p.y() : parameters[0].y(),
+			p.z() < parameters[0].z() ? p.z() : parameters[0].z());
+		parameters[1] = TVector3<T>(p.x() > parameters[1].x() ? p.x() : parameters[1].x(),
+			p.y() > parameters[1].y() ? p.y() : parameters[1].y(),
+			p.z() > parameters[1].z() ? p.z() : parameters[1].z());
+	}
+	void expand(const TBox& b) {
+		expand(b.parameters[0]);
+		expand(b.parameters[1]);
+	}
 };
 
+typedef TBox<float> Box;
+typedef TBox<double> Boxd;
+
 #endif // _BOX_H_
@@ -1,8 +1,36 @@
 #include "ofMain.h"
 #include "ofApp.h"
+#include "QueryServer.h"
+#include "LanderSimulation.h"
+#include "LanderChecks.h"
+#include "OctreeBench.h"
 
 //========================================================================
-int main( ){
+int main(int argc, char* argv[]){
+	// no window:  serve terrain queries to other processes
+	// (--query-server [terrain.obj]), time a running server
+	// (--query-client), fly the game headless on autopilot
+	// (--headless [terrain.obj] [steps]), or run the simulation's
+	// pass/fail checks (--check, exits with the number failed) or every
+	// benchmark (--bench)
+	//
+	string mode = (argc > 1) ? argv[1] : "";
+	if (mode == "--check") return runLanderChecks();
+	if (mode == "--bench") {
+		runAllBenchmarks();
+		return 0;
+	}
+	if (mode == "--headless") {
+		return runHeadless((argc > 2) ? argv[2] : "geo/Terrain.obj", "geo/Lander.obj", (argc > 3) ? atoi(argv[3]) : 60 * 60 * 10);
+	}
+	if (mode == "--query-server") return runQueryServer((argc > 2) ? argv[2] : "geo/Terrain.obj");
+	if (mode == "--query-client") {
+		for (int numThreads = 1; numThreads <= 4; numThreads *= 4) {
+			benchQueryClient(defaultQueryServerName, numThreads, 20000 / numThreads, NULL);
+		}
+		return 0;
+	}
+
 	ofSetupOpenGL(1024,768,OF_WINDOW);			// <-------- setup the GL context
 
 	// this kicks off the running of my app
@@ -13,13 +13,12 @@
 #include "ofApp.h"
 #include "Util.h"
 #include <glm/gtx/intersect.hpp>
+#include <float.h>
 
 //--------------------------------------------------------------
 // setup scene, lighting, state and load geometry
 //
 void ofApp::setup() {
-	fuel = 20000;
-
 	font.load("OpenSans-Bold.ttf", 40);
 
 	thrustSound.load("thrust.mp3");
@@ -56,6 +55,7 @@ void ofApp::setup() {
 	lander.setPosition(0, 0, 0);
 	lander.setScale(0.005, 0.005, 0.005);
 	bLanderLoaded = true;
+	buildLanderBVH();
 
 	// texture loading
 	//
@@ -76,9 +76,39 @@ void ofApp::setup() {
 	gui.add(thrustSlider.setup("Thrust", 8, 0, 20));
 	bHide = false;
 
-	//  Create Octree for testing.
+	//  Create Octree for testing.  the first mesh is the terrain (octree,
+	//  occupancy voxels, ray queries on the octree until 'i' times the
+	//  other backends), the rest of the model's meshes are indexed once
+	//  each and placed as instances.  'R' or dropping a file named
+	//  terrain*.obj rebuilds all of it in the background
+	//
+	vector<ofMesh> meshes;
+	for (int i = 0; i < mars.getMeshCount(); i++) meshes.push_back(mars.getMesh(i));
+	terrain = make_shared<Terrain>();
+	terrain->build(meshes, 20);
+	terrainLoader.publish(terrain);
+	sim.setTerrain(terrain);
+
+	// altitude, line of sight, collision boxes and picks are answered by
+	// worker threads
+	//
+	queries.start(terrain);
+	sim.queries = &queries;
+
+	// the simulation steps on a thread of its own from here on (see
+	// SimulationThread); update() and draw() work from its snapshots
+	//
+	simThread.start(&sim);
+
+	// the rest of update() runs as a graph of jobs on worker threads
+	//
+	buildFrameJobs();
+	jobs.start();
+
+	// larger worlds:  tiles in data/geo/tiles (see TerrainTiles::writeTiles())
+	// are loaded in the background as the lander gets near them
 	//
-	octree.create(mars.getMesh(0), 20);
+	if (tiles.open("geo/tiles", tileSize)) cout << "terrain: streaming tiles from geo/tiles" << endl;
 
 	cout << "Number of Verts: " << mars.getMesh(0).getNumVertices() << endl;
 
@@ -143,104 +173,150 @@ void ofApp::setup() {
 //
 void ofApp::update() {
 
-	
-	if (fuel <= 0) {
-		thrustSound.stop();
-		gameplay = 5;
-	}
-
-	glm::vec3 landerPos = lander.getPosition();
-	exhaust.setPosition(landerPos );
-	explosion.setPosition(landerPos);
-	exhaust.update();
-	explosion.update();
-
-	thrust = thrustSlider;
-	if (!bgMusic.isPlaying()) bgMusic.play();
-
-	//CAMERAS
-	trackingCam.lookAt(landerPos);
-	bottomCam.setPosition(landerPos);
-	topCam.setPosition(glm::vec3(landerPos.x, landerPos.y + 20, landerPos.z));
+	// a terrain rebuilt in the background replaces the current one here,
+	// a pointer swap (queries still running finish on the old one)
+	//
+	shared_ptr<Terrain> latest = terrainLoader.current();
+	if (latest != terrain) useTerrain(latest);
 
+	// the newest state the simulation thread has published.  this frame
+	// draws from it while the thread goes on stepping
+	//
+	const LanderSnapshot& state = simThread.latest();
+	frameState = &state;
+	frameLanderPos = state.renderPosition(ofGetElapsedTimeMicros());
+	glm::vec3 landerPos = frameLanderPos;
 
-	dynamicLight.setPosition((ofVec3f)(landerPos.x, landerPos.y + 20, landerPos.z));
-	//COLLISION
-	checkCollision();
+	// terrain queries:  run the callbacks (picks) answered since last frame.
+	// the simulation's ground queries go out from its own thread
+	//
+	queries.deliver();
 
-	//ALTITUDE CHECKER
-	Ray altitudeRay = Ray(Vector3(landerPos.x, landerPos.y, landerPos.z), Vector3(landerPos.x, landerPos.y - 200, landerPos.z));
-	TreeNode node;
-	if (octree.intersect(altitudeRay, octree.root, node))
-	{
-		altitude = glm::length(octree.mesh.getVertex(node.points[0]) - lander.getPosition());
-	}
+	if (!bgMusic.isPlaying()) bgMusic.play();
 
-	//HERE, CHANGE COORDINATES TO EACH LANDER SPOT
-	if (gameplay == 0 && bGrounded && withinCircle(glm::vec3(5, 5, -4))) {
-		gameplay = 1;
-	}
-	else if (gameplay == 1 && bGrounded && withinCircle(glm::vec3(20, 20, -4))) {
-		gameplay = 2;
+	// the simulation steps on its own thread with these controls from now
+	// on (sent with the tiles, below).  the rest reacts to what the
+	// snapshot says happened
+	//
+	frameControls.thrust = thrustSlider;
+	frameControls.up = keymap[OF_KEY_UP];
+	frameControls.down = keymap[OF_KEY_DOWN];
+	frameControls.left = keymap[OF_KEY_LEFT];
+	frameControls.right = keymap[OF_KEY_RIGHT];
+	frameControls.forward = keymap['q'];
+	frameControls.back = keymap['w'];
+	frameControls.turnLeft = keymap['e'];
+	frameControls.turnRight = keymap['r'];
+
+	if (state.fuel <= 0 || state.bGrounded) thrustSound.stop();
+	if (state.bThrust && !thrustSound.isPlaying()) thrustSound.play();
+	if (state.numMainEngine != mainEngineSeen) {
+		exhaust.sys->reset();
+		exhaust.start();
+		mainEngineSeen = state.numMainEngine;
 	}
-	else if (gameplay == 2 && bGrounded && withinCircle(glm::vec3(40, 50, -4))) {
-		gameplay = 3;
+	if (state.numCrashes != crashesSeen) {
+		cam.lookAt(landerPos);
+		currentCam = &cam;
+		explosion.setPosition(landerPos);
+		explosion.sys->reset();
+		explosion.start();
+		crashesSeen = state.numCrashes;
+
+		// the crater is made here, the main thread being the only one
+		// that writes the terrain (draw() and the jobs below read it
+		// without a lock).  a crash on a streamed tile makes none
+		//
+		if (state.bCrashOnTerrain) {
+			{
+				std::lock_guard<std::mutex> lock(simThread.mutex);
+				sim.makeCrater(state.crashPoint);
+			}
+			craterMade();
+		}
 	}
+	colBoxList = state.groundBoxes;
+	dynamicLight.setPosition((ofVec3f)(landerPos.x, landerPos.y + 20, landerPos.z));
+
+	// the rest of the frame is independent stages (see buildFrameJobs()),
+	// run side by side on the job threads.  all are done before draw()
+	//
+	jobs.run(frameJobs);
+}
 
+// buildFrameJobs:  update()'s stages as a job graph, built once.  the
+//                  stages read frameState, frameLanderPos and
+//                  frameControls, set at the top of update().  only
+//                  sight waits for another stage (the camera it looks
+//                  from).  both particle systems are one stage:  they
+//                  share ofRandom()'s generator
+//
+void ofApp::buildFrameJobs() {
 
-	//GAME IS IN PLAY
-	if (gameplay > -1 && gameplay < 3) {
-		if (bGrounded && !keymap[OF_KEY_UP] && gameplay != 4)
-		{
-			velocity = glm::vec3(0, 0, 0);
-			acceleration = glm::vec3(0, 0, 0);
-			force = glm::vec3(0, 0, 0);
-		}
-		if (keymap[OF_KEY_UP]) {
-			force += thrust * ofVec3f(0, 1, 0);
-			fuel -= 10;
-			if (!thrustSound.isPlaying()) thrustSound.play();
-			exhaust.sys->reset();
-			exhaust.start();
-			bGrounded = false;
-		}
-		if (keymap[OF_KEY_LEFT] && !bGrounded) {
-			force += -thrust * ofVec3f(1, 0, 0);
-			if (!thrustSound.isPlaying()) thrustSound.play();
-		}
-		if (keymap[OF_KEY_RIGHT] && !bGrounded) {
-			force += thrust * ofVec3f(1, 0, 0);
-			if (!thrustSound.isPlaying()) thrustSound.play();
+	// streamed tiles near the lander in, far ones out (never waits for a
+	// build); queries and the simulation see the current set
+	//
+	frameJobs.add("tiles", [this] {
+		tiles.update(Vector3(frameLanderPos.x, frameLanderPos.y, frameLanderPos.z));
+		shared_ptr<const TileList> tileList = tiles.snapshot();
+		queries.setTiles(tileList);
+		simThread.setInput(frameControls, tileList);
+	});
+
+	frameJobs.add("particles", [this] {
+		exhaust.setPosition(frameLanderPos);
+		explosion.setPosition(frameLanderPos);
+		exhaust.update();
+		explosion.update();
+	});
+
+	int cameras = frameJobs.add("cameras", [this] {
+		glm::vec3 landerPos = frameLanderPos;
+		trackingCam.lookAt(landerPos);
+		bottomCam.setPosition(landerPos);
+		topCam.setPosition(glm::vec3(landerPos.x, landerPos.y + 20, landerPos.z));
+	});
+
+	// keep the lander in sight of the tracking camera:  if terrain blocked
+	// the line of sight last frame, raise the camera a little until it doesn't.
+	// (stop short of the lander so the ground it sits on doesn't count)
+	//
+	int sight = frameJobs.add("sight", [this] {
+		glm::vec3 landerPos = frameLanderPos;
+		glm::vec3 trackPos = trackingCam.getPosition();
+		if (sightQuery.valid() && sightQuery.get().hit) {
+			trackPos += glm::vec3(0, .5, 0);
+			trackingCam.setPosition(trackPos);
+			trackingCam.lookAt(landerPos);
 		}
-		if (keymap[OF_KEY_DOWN] && !bGrounded) {
-			force += -thrust * ofVec3f(0, 1, 0);
-			if (!thrustSound.isPlaying()) thrustSound.play();
+		glm::vec3 toLander = landerPos - trackPos;
+		float sightDist = glm::length(toLander);
+		if (sightDist > 1) {
+			glm::vec3 sightEnd = trackPos + toLander * ((sightDist - 1) / sightDist);
+			Vector3 eye = Vector3(trackPos.x, trackPos.y, trackPos.z);
+			Ray sight = makeRay(eye, Vector3(sightEnd.x, sightEnd.y, sightEnd.z) - eye);
+			sightQuery = queries.submit(QueryRequest::any(sight, 0, 1));
 		}
-		if (keymap['q'] && !bGrounded) {
-			force += thrust * ofVec3f(0, 0, 1);
-			if (!thrustSound.isPlaying()) thrustSound.play();
+	});
+	frameJobs.runsAfter(sight, cameras);
 
-		}
-		if (keymap['w'] && !bGrounded) {
-			force += -thrust * ofVec3f(0, 0, 1);
-			if (!thrustSound.isPlaying()) thrustSound.play();
-		}
-		if (keymap['e'] && !bGrounded) {
-			angularForce += 50;
-			if (!thrustSound.isPlaying()) thrustSound.play();
-		}
-		if (keymap['r'] && !bGrounded) {
-			angularForce += -50;
-			if (!thrustSound.isPlaying()) thrustSound.play();
-		}
-	}
+	frameJobs.add("lander", [this] {
+		lander.setPosition(frameLanderPos.x, frameLanderPos.y, frameLanderPos.z);
+		lander.setRotation(0, frameState->renderRotation(ofGetElapsedTimeMicros()), 0, 1, 0);
+	});
 
-	if (gameplay == 0 || gameplay == 1 || gameplay == 2 || gameplay == 4) {
-		integrate();
-		force = glm::vec3(0, 0, 0);
-		angularForce = 0;
-	}
+	// safe ground around the current pad, recomputed when the pad changes
+	//
+	frameJobs.add("landing sites", [this] {
+		int gameplay = frameState->gameplay;
+		if (bDisplayLandingSites && landingSitesFor != gameplay) {
+			int pad = (gameplay >= LanderSimulation::ToPad1 && gameplay <= LanderSimulation::ToPad3) ? gameplay : 0;
+			findLandingSites(sim.pads[pad]);
+			landingSitesFor = gameplay;
+		}
+	});
 }
+
 //--------------------------------------------------------------
 void ofApp::draw() {
 
@@ -253,20 +329,18 @@ void ofApp::draw() {
 
 	currentCam->begin();
 	ofPushMatrix();
-	if (gameplay == 0 || gameplay == -1) {
-		makeLanding(glm::vec3(5, 5, -4));
-	}
-	else if (gameplay == 1) {
-		makeLanding(glm::vec3(20, 20, -4));
-	}
-	else if (gameplay == 2) {
-		makeLanding(glm::vec3(40, 50, -4));
+	int gameplay = simThread.current().gameplay;
+	if (gameplay <= LanderSimulation::ToPad3) {
+		makeLanding(sim.pads[max(gameplay, 0)]);
 	}
 
 	if (bWireframe) {                    // wireframe mode  (include landerBoundsaxis)
 		ofDisableLighting();
 		ofSetColor(ofColor::slateGray);
-		mars.drawWireframe();
+		if (bTerrainEdited) terrain->octree.mesh.drawWireframe();
+		else mars.drawWireframe();
+		shared_ptr<const TileList> tileList = tiles.snapshot();
+		for (int i = 0; i < tileList->size(); i++) (*tileList)[i]->terrain->octree.mesh.drawWireframe();
 		if (bLanderLoaded) {
 			lander.drawWireframe();
 			if (!bTerrainSelected) drawAxis(lander.getPosition());
@@ -275,7 +349,10 @@ void ofApp::draw() {
 	}
 	else {
 		ofEnableLighting();              // shaded mode
-		mars.drawFaces();
+		if (bTerrainEdited) terrain->octree.mesh.drawFaces();
+		else mars.drawFaces();
+		shared_ptr<const TileList> tileList = tiles.snapshot();
+		for (int i = 0; i < tileList->size(); i++) (*tileList)[i]->terrain->octree.mesh.drawFaces();
 		ofMesh mesh;
 		if (bLanderLoaded) {
 			lander.drawFaces();
@@ -307,6 +384,9 @@ void ofApp::draw() {
 				for (int i = 0; i < colBoxList.size(); i++) {
 					Octree::drawBox(colBoxList[i]);
 				}
+				for (int i = 0; i < dragBoxList.size(); i++) {
+					Octree::drawBox(dragBoxList[i]);
+				}
 			}
 		}
 	}
@@ -317,7 +397,8 @@ void ofApp::draw() {
 	if (bDisplayPoints) {                // display points as an option    
 		glPointSize(3);
 		ofSetColor(ofColor::green);
-		mars.drawVertices();
+		if (bTerrainEdited) terrain->octree.mesh.drawVertices();
+		else mars.drawVertices();
 	}
 
 	// highlight selected point (draw sphere around selected point)
@@ -361,26 +442,54 @@ void ofApp::draw() {
 	//	ofNoFill();
 
 	if (bDisplayLeafNodes) {
-		octree.drawLeafNodes(octree.root);
-		cout << "num leaf: " << octree.numLeaf << endl;
+		terrain->octree.drawLeafNodes(terrain->octree.root);
 	}
 	else if (bDisplayOctree) {
 		ofNoFill();
 		ofSetColor(ofColor::white);
-		octree.draw(numLevels, 0);
+		terrain->octree.draw(numLevels, 0);
 	}
 
 	// if point selected, draw a sphere
 	//
 	if (pointSelected) {
-		ofVec3f p = octree.mesh.getVertex(selectedNode.points[0]);
+		ofVec3f p = terrain->octree.mesh.getVertex(selectedVertex);
 		ofVec3f d = p - cam.getPosition();
 		ofSetColor(ofColor::lightGreen);
 		ofDrawSphere(p, .02 * d.length());
 	}
+	// flat enough / smooth enough terrain near the pad
+	//
+	if (bDisplayLandingSites) {
+		ofNoFill();
+		ofSetColor(ofColor::green);
+		for (int i = 0; i < landingSites.size(); i++) {
+			Octree::drawBox(landingSites[i]->box);
+		}
+	}
+
+	// points picked with the selection rectangle
+	//
+	if (marqueePoints.size() > 0) {
+		glPointSize(3);
+		ofSetColor(ofColor::yellow);
+		ofMesh selection;
+		selection.setMode(OF_PRIMITIVE_POINTS);
+		for (int i = 0; i < marqueePoints.size(); i++) {
+			selection.addVertex(terrain->octree.mesh.getVertex(marqueePoints[i]));
+		}
+		selection.draw();
+	}
 	explosion.draw();
 	ofPopMatrix();
 	currentCam->end();
+
+	if (bInMarquee) {
+		ofNoFill();
+		ofSetColor(ofColor::yellow);
+		ofDrawRectangle(marqueeStart.x, marqueeStart.y, marqueeEnd.x - marqueeStart.x, marqueeEnd.y - marqueeStart.y);
+		ofFill();
+	}
 	drawText();
 }
 
@@ -428,8 +537,25 @@ void ofApp::keyPressed(int key) {
 	case 'f':
 		ofToggleFullscreen();
 		break;
+	case 'I':
+	case 'i':
+	{
+		SpatialIndex* index = chooseSpatialIndex(terrain->octree.mesh, QueryMix());
+		std::lock_guard<std::mutex> lock(simThread.mutex);	// stops the simulation's queries too
+		queries.drain();
+		delete terrain->index;
+		terrain->index = index;
+		break;
+	}
 	case 'H':
 	case 'h':
+		bDisplayLandingSites = !bDisplayLandingSites;
+		landingSitesFor = -2;
+		break;
+	case 'J':
+	case 'j':
+		bDisplayTimings = !bDisplayTimings;
+		frameJobs.resetTimings();
 		break;
 	case 'L':
 	case 'l':
@@ -442,6 +568,9 @@ void ofApp::keyPressed(int key) {
 	case 'r':
 		cam.reset();
 		break;
+	case 'R':
+		terrainLoader.reload("geo/Terrain.obj");
+		break;
 	case 's':
 		savePicture();
 		break;
@@ -449,6 +578,7 @@ void ofApp::keyPressed(int key) {
 		setCameraTarget();
 		break;
 	case 'u':
+		runOctreeBenchmarks(terrain->octree);
 		break;
 	case 'v':
 		togglePointsDisplay();
@@ -468,8 +598,9 @@ void ofApp::keyPressed(int key) {
 		currentCam = &topCam;
 		break;
 	case ' ':
-		if (gameplay == -1) {
-			gameplay = 0;
+		if (simThread.current().gameplay == LanderSimulation::Waiting) {
+			std::lock_guard<std::mutex> lock(simThread.mutex);
+			sim.start();
 			starttime = ofGetElapsedTimeMillis();
 		}
 		break;
@@ -539,6 +670,15 @@ void ofApp::mousePressed(int x, int y, int button) {
 //
 	if (cam.getMouseInputEnabled()) return;
 
+	// ctrl + drag selects terrain points in a screen rectangle
+	//
+	if (bCtrlKeyDown) {
+		bInMarquee = true;
+		marqueeStart = glm::vec3(x, y, 0);
+		marqueeEnd = marqueeStart;
+		return;
+	}
+
 	// if rover is loaded, test for selection
 	//
 	if (bLanderLoaded) {
@@ -562,25 +702,29 @@ void ofApp::mousePressed(int x, int y, int button) {
 		}
 	}
 	else {
-		ofVec3f p;
-		raySelectWithOctree(p);
+		raySelectWithOctree();
 	}
 }
 
-bool ofApp::raySelectWithOctree(ofVec3f& pointRet) {
+// raySelectWithOctree:  pick the terrain vertex nearest where the mouse ray
+//                       hits.  answered by the query service, the selection
+//                       changes next frame
+//
+void ofApp::raySelectWithOctree() {
 	ofVec3f mouse(mouseX, mouseY);
 	ofVec3f rayPoint = cam.screenToWorld(mouse);
 	ofVec3f rayDir = rayPoint - cam.getPosition();
 	rayDir.normalize();
-	Ray ray = Ray(Vector3(rayPoint.x, rayPoint.y, rayPoint.z),
+	Ray ray = makeRay(Vector3(rayPoint.x, rayPoint.y, rayPoint.z),
 		Vector3(rayDir.x, rayDir.y, rayDir.z));
 
-	pointSelected = octree.intersect(ray, octree.root, selectedNode);
-
-	if (pointSelected) {
-		pointRet = octree.mesh.getVertex(selectedNode.points[0]);
-	}
-	return pointSelected;
+	int version = terrain->version;
+	queries.submit(QueryRequest::pick(ray, pickRadius), [this, version](const QueryResult& result) {
+		if (version != terrain->version) return;
+		pointSelected = result.hit;
+		if (result.hit) selectedVertex = result.index;
+	});
+	queries.flush();
 }
 
 
@@ -589,6 +733,11 @@ bool ofApp::raySelectWithOctree(ofVec3f& pointRet) {
 void ofApp::mouseDragged(int x, int y, int button) {
 	if (cam.getMouseInputEnabled()) return;
 
+	if (bInMarquee) {
+		marqueeEnd = glm::vec3(x, y, 0);
+		return;
+	}
+
 	if (bInDrag) {
 
 		glm::vec3 landerPos = lander.getPosition();
@@ -598,6 +747,10 @@ void ofApp::mouseDragged(int x, int y, int button) {
 
 		landerPos += delta;
 		lander.setPosition(landerPos.x, landerPos.y, landerPos.z);
+		{
+			std::lock_guard<std::mutex> lock(simThread.mutex);
+			sim.place(landerPos);
+		}
 		mouseLastPos = mousePos;
 
 		ofVec3f min = lander.getSceneMin() + lander.getPosition();
@@ -605,26 +758,72 @@ void ofApp::mouseDragged(int x, int y, int button) {
 
 		Box bounds = Box(Vector3(min.x, min.y, min.z), Vector3(max.x, max.y, max.z));
 
-		colBoxList.clear();
-		octree.intersect(bounds, octree.root, colBoxList);
+		queries.submit(QueryRequest::leaves(bounds), [this](const QueryResult& result) {
+			if (bInDrag) dragBoxList = result.boxes;		// (answered after the release:  dropped)
+		});
+		queries.flush();
 	}
 	else {
-		ofVec3f p;
-		raySelectWithOctree(p);
+		raySelectWithOctree();
 	}
 }
 
 //--------------------------------------------------------------
 void ofApp::mouseReleased(int x, int y, int button) {
 	bInDrag = false;
+	dragBoxList.clear();
+	if (bInMarquee) {
+		marqueeEnd = glm::vec3(x, y, 0);
+		doMarqueeSelection();
+		bInMarquee = false;
+	}
 }
 
+//  Select all terrain points inside the screen rectangle dragged out with
+//  the mouse.  the rectangle becomes a frustum through the current camera
+//  and the octree does the rest (no per vertex projection)
+//
+void ofApp::doMarqueeSelection() {
+	ofRectangle viewport = ofRectangle(0, 0, ofGetWidth(), ofGetHeight());
+	ofRectangle rect = ofRectangle(marqueeStart.x, marqueeStart.y,
+		marqueeEnd.x - marqueeStart.x, marqueeEnd.y - marqueeStart.y);
+	if (rect.width == 0 || rect.height == 0) {
+		marqueePoints.clear();
+		return;
+	}
+	glm::mat4 viewProjection = currentCam->getModelViewProjectionMatrix(viewport);
+	Frustum frustum = Frustum::fromScreenRect(viewProjection, viewport, rect);
+	terrain->octree.getPointsInFrustum(frustum, marqueePoints);
+	cout << "points selected: " << marqueePoints.size() << endl;
+}
 
 
+
+//
+//  Select Target Point on Terrain:  the vertex within selectionRange pixels
+//  of the mouse that is closest to the camera.  the mouse and pixel radius
+//  become a cone from the eye and the octree is searched front to back, so
+//  only vertices near the cone are ever projected to the screen.
+//  if a point is selected, return true, else return false;
+//
+bool ofApp::doPointSelection() {
+	ofRectangle viewport = ofRectangle(0, 0, ofGetWidth(), ofGetHeight());
+	glm::vec3 eye = cam.getPosition();
+	PickCone cone = PickCone(cam.getModelViewProjectionMatrix(viewport), viewport,
+		Vector3(eye.x, eye.y, eye.z), mouseX, mouseY, selectionRange);
+
+	int index = terrain->octree.pickVertex(cone);
+	bPointSelected = (index >= 0);
+	if (bPointSelected) selectedPoint = terrain->octree.mesh.getVertex(index);
+	return bPointSelected;
+}
+
 // Set the camera to use the selected point as it's new target
 //  
 void ofApp::setCameraTarget() {
-
+	if (doPointSelection()) {
+		cam.setTarget(selectedPoint);
+	}
 }
 
 
@@ -719,6 +918,7 @@ void ofApp::dragEvent2(ofDragInfo dragInfo) {
 		for (int i = 0; i < lander.getMeshCount(); i++) {
 			bboxList.push_back(Octree::meshBounds(lander.getMesh(i)));
 		}
+		buildLanderBVH();
 
 		cout << "Mesh Count: " << lander.getMeshCount() << endl;
 	}
@@ -739,6 +939,16 @@ bool ofApp::mouseIntersectPlane(ofVec3f planePoint, ofVec3f planeNorm, ofVec3f&
 // model is dropped in viewport, place origin under cursor
 //
 void ofApp::dragEvent(ofDragInfo dragInfo) {
+
+	// a terrain file is rebuilt in the background, the game keeps running
+	// on the current terrain until it is ready
+	//
+	string name = ofToLower(ofFilePath::getFileName(dragInfo.files[0]));
+	if (name.find("terrain") == 0 && ofFilePath::getFileExt(name) == "obj") {
+		terrainLoader.reload(dragInfo.files[0]);
+		return;
+	}
+
 	if (lander.loadModel(dragInfo.files[0])) {
 		bLanderLoaded = true;
 		lander.setScaleNormalization(false);
@@ -748,6 +958,7 @@ void ofApp::dragEvent(ofDragInfo dragInfo) {
 		for (int i = 0; i < lander.getMeshCount(); i++) {
 			bboxList.push_back(Octree::meshBounds(lander.getMesh(i)));
 		}
+		buildLanderBVH();
 
 		//		lander.setRotation(1, 180, 1, 0, 0);
 
@@ -782,6 +993,8 @@ void ofApp::dragEvent(ofDragInfo dragInfo) {
 			glm::vec3 max = lander.getSceneMax();
 			float offset = (max.y - min.y) / 2.0;
 			lander.setPosition(intersectPoint.x, intersectPoint.y - offset, intersectPoint.z);
+			std::lock_guard<std::mutex> lock(simThread.mutex);
+			sim.place(lander.getPosition());
 
 			// set up bounding box for lander while we are at it
 			//
@@ -819,39 +1032,26 @@ glm::vec3 ofApp::getMousePointOnPlane(glm::vec3 planePt, glm::vec3 planeNorm) {
 	else return glm::vec3(0, 0, 0);
 }
 
-void ofApp::checkCollision()
-{
-	ofVec3f min = lander.getSceneMin() + lander.getPosition();
-	ofVec3f max = lander.getSceneMax() + lander.getPosition();
-
-	Box roverBounds = Box(Vector3(min.x, min.y, min.z), Vector3(max.x, max.y, max.z));
-
-	colBoxList.clear();
-	if (octree.intersect(roverBounds, octree.root, colBoxList))
-	{
-		glm::vec3 temp = force + velocity;
-		if (temp.y < -4) {
-			cam.lookAt(lander.getPosition());
-			currentCam = &cam;
-			velocity = glm::vec3(0, 200, 0);
-			explosion.setPosition(lander.getPosition());
-			explosion.sys->reset();
-			explosion.start();
-			gameplay = 4;
-		}
-		else {
-			bGrounded = true;
-			thrustSound.stop();
-		}
+// give the simulation the lander triangles (lander model space) for the
+// narrow phase, with the model loader's scale.  only needs to be redone
+// when a new lander model is loaded
+//
+void ofApp::buildLanderBVH() {
+	vector<ofMesh> meshes;
+	for (int i = 0; i < lander.getMeshCount(); i++) {
+		meshes.push_back(lander.getMesh(i));
 	}
-
+	std::lock_guard<std::mutex> lock(simThread.mutex);
+	sim.place(lander.getPosition());
+	sim.setLander(meshes, glm::inverse(sim.pose()) * lander.getModelMatrix());
 }
 
 void ofApp::drawText()
 {
 	ofSetColor(ofColor::white);
-	string alt = "Altitude: " + std::to_string(altitude);
-	string fue = "Fuel: " + std::to_string(fuel);
+	const LanderSnapshot& state = simThread.current();
+	string alt = "Altitude: " + std::to_string(state.altitude);
+	string fue = "Fuel: " + std::to_string(state.fuel);
 	int framerate = ofGetFrameRate();
 	string fps = "Frame Rate:" + std::to_string(framerate);
 	string start = "PRESS SPACE TO START";
@@ -869,8 +1069,29 @@ void ofApp::drawText()
 	ofDrawBitmapString(alt, ofGetWindowWidth() - 170, 55);
 	ofDrawBitmapString(fue, ofGetWindowWidth() - 170, 35);
 	ofDrawBitmapString(fps, ofGetWindowWidth() - 120, 15);
+	if (bDisplayLeafNodes) ofDrawBitmapString("Leaf Nodes: " + std::to_string(terrain->numLeaves), ofGetWindowWidth() - 170, 75);
 
-	if (gameplay == -1) {
+	// update() stages:  average microseconds and the thread each last ran
+	// on, then the whole graph against the stages added up
+	//
+	if (bDisplayTimings) {
+		uint64_t sum = 0;
+		for (int i = 0; i < frameJobs.jobs.size(); i++) {
+			const Job& job = frameJobs.jobs[i];
+			uint64_t average = job.totalMicros / max((int64_t)1, job.numRuns);
+			sum += job.micros;
+			ofDrawBitmapString(job.name + ": " + std::to_string(average) + " us (thread " + std::to_string(job.thread) + ")", 10, 200 + 15 * i);
+		}
+		int y = 200 + 15 * frameJobs.jobs.size();
+		ofDrawBitmapString("jobs: " + std::to_string(frameJobs.micros) + " us, stages " + std::to_string(sum) + " us, "
+			+ std::to_string(jobs.numThreads()) + " workers", 10, y);
+		uint64_t advance = simThread.advanceMicros / max((int64_t)1, (int64_t)simThread.numAdvances);
+		ofDrawBitmapString("simulation thread: " + std::to_string(advance) + " us an advance", 10, y + 15);
+		ofDrawBitmapString("landing sites: " + std::to_string(landingSites.size()) + " in " + std::to_string(landingSitesMicros) + " us, last search", 10, y + 30);
+		ofDrawBitmapString("craters: " + std::to_string(sim.numCraters) + ", last " + std::to_string(sim.craterMicros) + " us", 10, y + 45);
+	}
+
+	if (state.gameplay == LanderSimulation::Waiting) {
 		font.drawString(start, ofGetWindowWidth() / 2 - 250, ofGetWindowHeight() / 2);
 		ofDrawBitmapString(controls, ofGetWindowWidth() / 2 - 250, ofGetWindowHeight() / 2 + 50);
 		ofDrawBitmapString(up, ofGetWindowWidth() / 2 - 250, ofGetWindowHeight() / 2 + 70);
@@ -878,16 +1099,16 @@ void ofApp::drawText()
 		ofDrawBitmapString(rotate, ofGetWindowWidth() / 2 - 250, ofGetWindowHeight() / 2 + 110);
 		ofDrawBitmapString(zmovement, ofGetWindowWidth() / 2 - 250, ofGetWindowHeight() / 2 + 140);
 	}
-	else if (gameplay == 3) {
+	else if (state.gameplay == LanderSimulation::Landed) {
 
 		font.drawString(end, ofGetWindowWidth() / 2 - 250, ofGetWindowHeight() / 2);
 
 	}
-	else if (gameplay == 4) {
+	else if (state.gameplay == LanderSimulation::Exploded) {
 
 		font.drawString(explode, ofGetWindowWidth() / 2 - 250, ofGetWindowHeight() / 2);
 	}
-	else if (gameplay == 5) {
+	else if (state.gameplay == LanderSimulation::OutOfFuel) {
 		font.drawString(outOfFuel, ofGetWindowWidth() / 2 - 250, ofGetWindowHeight() / 2-50);
 
 	}
@@ -902,14 +1123,16 @@ void ofApp::makeLanding(glm::vec3 pos) {
 	ofPopMatrix();
 }
 
-bool ofApp::withinCircle(glm::vec3 pos) {
-	glm::vec3 landerPos = lander.getPosition();
-	return ((landerPos.x > pos.x - 5 && landerPos.x < pos.x + 5)
-		&& (landerPos.z > pos.y - 5 && landerPos.z < pos.y + 5));
+// find terrain regions around a landing pad that are safe to set down on.
+// pads are given as in LanderSimulation::pads (x, z in pos.x, pos.y).  the
+// time taken shows with the stage timings ('j')
+//
+void ofApp::findLandingSites(glm::vec3 pad) {
+	uint64_t t1 = ofGetElapsedTimeMicros();
+	terrain->octree.findLandingSites(Vector3(pad.x, 0, pad.y), 5, sim.maxLandingSlope, maxLandingRoughness, landingSites);
+	landingSitesMicros = ofGetElapsedTimeMicros() - t1;
 }
 
-
-
 void ofApp::loadVbo()
 {
 	if (exhaust.sys->particles.size() < 1) return;
@@ -929,3 +1152,37 @@ void ofApp::loadVbo()
 	vbo.setNormalData(&sizes[0], total, GL_STATIC_DRAW);
 }
 
+
+// craterMade:  the simulation stamped a crater into the terrain (see
+//              LanderSimulation::makeCrater()).  landing sites point into
+//              the old tree, and from then on the edited octree mesh is
+//              drawn in place of the loaded model
+//
+void ofApp::craterMade() {
+	landingSites.clear();
+	landingSitesFor = -2;
+	bTerrainEdited = true;
+}
+
+// useTerrain:  switch to a newly built terrain version.  anything that
+//              points into the old one (landing sites, selections) is
+//              dropped, and the old version goes to the loader to be
+//              freed off the frame thread
+//
+void ofApp::useTerrain(shared_ptr<Terrain> latest) {
+	terrainLoader.retire(terrain);
+	terrain = latest;
+	queries.setTerrain(terrain);
+
+	landingSites.clear();
+	landingSitesFor = -2;
+	marqueePoints.clear();
+	pointSelected = false;
+	selectedVertex = -1;
+	colBoxList.clear();
+	dragBoxList.clear();
+	std::lock_guard<std::mutex> lock(simThread.mutex);
+	sim.setTerrain(terrain);
+	bTerrainEdited = true;
+	cout << "terrain: now using version " << terrain->version << endl;
+}
@@ -4,6 +4,19 @@
 #include "ofxGui.h"
 #include  "ofxAssimpModelLoader.h"
 #include "Octree.h"
+#include "MeshBVH.h"
+#include "ContactManifold.h"
+#include "OctreeBench.h"
+#include "OccupancyGrid.h"
+#include "SpatialIndex.h"
+#include "AABBTree.h"
+#include "InstancedScene.h"
+#include "QueryService.h"
+#include "Terrain.h"
+#include "TerrainTiles.h"
+#include "LanderSimulation.h"
+#include "SimulationThread.h"
+#include "JobScheduler.h"
 #include "../ParticleEmitter.h"
 
 
@@ -35,50 +48,25 @@ public:
 	void toggleSelectTerrain();
 	void setCameraTarget();
 	bool mouseIntersectPlane(ofVec3f planePoint, ofVec3f planeNorm, ofVec3f& point);
-	bool raySelectWithOctree(ofVec3f& pointRet);
+	void raySelectWithOctree();
+	void doMarqueeSelection();
+	bool doPointSelection();
 	glm::vec3 ofApp::getMousePointOnPlane(glm::vec3 p, glm::vec3 n);
 	void loadVbo();
-	void checkCollision();
+	void buildLanderBVH();
 
 	void drawText();
 
 	void makeLanding(glm::vec3 pos);
-	bool withinCircle(glm::vec3 pos);
-
-	float thrust;
-	glm::vec3 velocity = glm::vec3(0, 0, 0);
-	glm::vec3 acceleration = glm::vec3(0, 0, 0);
-	glm::vec3 force = glm::vec3(0, 0, 0);
-	glm::vec3 gravity = glm::vec3(0, -2.5, 0);
-	float rotation = 0.0;
-	float angularForce = 0;
-	float angularVelocity = 0.0;
-	float angularAcceleration = 0.0;
-	float altitude;
-	map<int, bool> keymap;
-
-
-	void ofApp::integrate() {
-		float framerate = 60;	// workaround
-		float dt = 1.0 / framerate;
+	void findLandingSites(glm::vec3 pad);
+	void craterMade();
+	void useTerrain(shared_ptr<Terrain> latest);
+	void buildFrameJobs();
 
-		glm::vec3 pos = lander.getPosition();
-		lander.setPosition(pos.x + velocity.x * dt, pos.y + velocity.y * dt, pos.z + velocity.z * dt);
-		glm::vec3 accel = acceleration;
-		accel += (force + gravity);
-		velocity += accel * dt;
-		velocity *= .999;
-
-		rotation += (angularVelocity * dt);
+	LanderSimulation sim;		// lander physics, contact, fuel and pads; the app is a view on it
+	map<int, bool> keymap;
 
-		lander.setRotation(0, rotation, 0, 1, 0);
-		float a = angularAcceleration;
-		a += angularForce;
-		angularVelocity += a * dt;
-		angularVelocity *= .999;
-	}
 	ofTrueTypeFont font;
-	int gameplay = -1;
 
 	ofSoundPlayer thrustSound;
 	ofSoundPlayer bgMusic;
@@ -93,17 +81,41 @@ public:
 	//ofLight light;
 	Box boundingBox, landerBounds;
 	Box testBox;
-	vector<Box> colBoxList;
+	vector<Box> colBoxList;			// ground boxes the lander reached, from the snapshot
+	vector<Box> dragBoxList;		// leaf boxes under the lander while it is dragged
+	float maxLandingRoughness = .05;
+	vector<const TreeNode*> landingSites;
+	int landingSitesFor = -2;		// gameplay state the sites were found for
+	uint64_t landingSitesMicros = 0;	// last search
+	bool bDisplayLandingSites = false;
 	bool bLanderSelected = false;
-	Octree octree;
-	TreeNode selectedNode;
+	shared_ptr<Terrain> terrain;		// octree, occupancy, ray index (see chooseSpatialIndex()), props
+	TerrainLoader terrainLoader;		// background rebuilds, see useTerrain()
+	TerrainTiles tiles;				// ground past the main terrain, streamed in around the lander
+	float tileSize = 100;
+	bool bTerrainEdited = false;		// draw terrain->octree.mesh instead of mars (edited or reloaded)
+	QueryService queries;			// terrain queries on worker threads, answered next frame
+	std::future<QueryResult> sightQuery;	// tracking camera line of sight, last frame
+	SimulationThread simThread;		// steps sim; after sim and queries, so it stops first
+	int mainEngineSeen = 0;			// snapshot event counts already acted on
+	int crashesSeen = 0;
+	JobScheduler jobs;				// update()'s stages, see buildFrameJobs()
+	JobGraph frameJobs;
+	const LanderSnapshot* frameState = NULL;	// this frame's, for the jobs
+	glm::vec3 frameLanderPos;
+	LanderControls frameControls;
+	bool bDisplayTimings = false;
+	int selectedVertex = -1;
+	float pickRadius = 2;			// world distance from the ray hit to the picked vertex
 	glm::vec3 mouseDownPos, mouseLastPos;
 	bool bInDrag = false;
+	bool bInMarquee = false;
+	glm::vec3 marqueeStart, marqueeEnd;
+	vector<int> marqueePoints;
 
 	ofxIntSlider numLevels;
 	ofxFloatSlider thrustSlider;
 	ofxPanel gui;
-	int fuel;
 
 	bool bAltKeyDown;
 	bool bCtrlKeyDown;
@@ -115,7 +127,6 @@ public:
 	bool bDisplayLeafNodes = false;
 	bool bDisplayOctree = false;
 	bool bDisplayBBoxes = false;
-	bool bGrounded = false;
 
 	bool bLanderLoaded;
 	bool bTerrainSelected;
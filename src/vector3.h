@@ -3,27 +3,35 @@
 
 #include <math.h>
 
-class Vector3 {
+template <class T>
+class TVector3 {
 public:
-    Vector3() { };
-    Vector3(float x, float y, float z) { d[0] = x; d[1] = y; d[2] = z; }
-    Vector3(const Vector3& v)
+    typedef T Scalar;
+
+    TVector3() { };
+    TVector3(T x, T y, T z) { d[0] = x; d[1] = y; d[2] = z; }
+    TVector3(const TVector3& v)
     {
         d[0] = v.d[0]; d[1] = v.d[1]; d[2] = v.d[2];
     }
+    template <class U>
+    explicit TVector3(const TVector3<U>& v)     // float <-> double
+    {
+        d[0] = (T)v.x(); d[1] = (T)v.y(); d[2] = (T)v.z();
+    }
 
-    float x() const { return d[0]; }
-    float y() const { return d[1]; }
-    float z() const { return d[2]; }
+    T x() const { return d[0]; }
+    T y() const { return d[1]; }
+    T z() const { return d[2]; }
 
-    float operator[](int i) const { return d[i]; }
+    T operator[](int i) const { return d[i]; }
 
-    float length() const
+    T length() const
     {
         return sqrt(d[0] * d[0] + d[1] * d[1] + d[2] * d[2]);
     }
     void normalize() {
-        float temp = length();
+        T temp = length();
         if (temp == 0.0)
             return;	// 0 length vector
           // multiply by 1/magnitude
@@ -37,48 +45,51 @@ public:
     // Overloaded operators
     /////////////////////////////////////////////////////////
 
-    Vector3 operator+(const Vector3& op2) const {   // vector addition
-        return Vector3(d[0] + op2.d[0], d[1] + op2.d[1], d[2] + op2.d[2]);
+    TVector3 operator+(const TVector3& op2) const {   // vector addition
+        return TVector3(d[0] + op2.d[0], d[1] + op2.d[1], d[2] + op2.d[2]);
     }
-    Vector3 operator-(const Vector3& op2) const {   // vector subtraction
-        return Vector3(d[0] - op2.d[0], d[1] - op2.d[1], d[2] - op2.d[2]);
+    TVector3 operator-(const TVector3& op2) const {   // vector subtraction
+        return TVector3(d[0] - op2.d[0], d[1] - op2.d[1], d[2] - op2.d[2]);
     }
-    Vector3 operator-() const {                    // unary minus
-        return Vector3(-d[0], -d[1], -d[2]);
+    TVector3 operator-() const {                    // unary minus
+        return TVector3(-d[0], -d[1], -d[2]);
     }
-    Vector3 operator*(float s) const {            // scalar multiplication
-        return Vector3(d[0] * s, d[1] * s, d[2] * s);
+    TVector3 operator*(T s) const {            // scalar multiplication
+        return TVector3(d[0] * s, d[1] * s, d[2] * s);
     }
-    void operator*=(float s) {
+    void operator*=(T s) {
         d[0] *= s;
         d[1] *= s;
         d[2] *= s;
     }
-    Vector3 operator/(float s) const {            // scalar division
-        return Vector3(d[0] / s, d[1] / s, d[2] / s);
+    TVector3 operator/(T s) const {            // scalar division
+        return TVector3(d[0] / s, d[1] / s, d[2] / s);
     }
-    float operator*(const Vector3& op2) const {   // dot product
+    T operator*(const TVector3& op2) const {   // dot product
         return d[0] * op2.d[0] + d[1] * op2.d[1] + d[2] * op2.d[2];
     }
-    Vector3 operator^(const Vector3& op2) const {   // cross product
-        return Vector3(d[1] * op2.d[2] - d[2] * op2.d[1], d[2] * op2.d[0] - d[0] * op2.d[2],
+    TVector3 operator^(const TVector3& op2) const {   // cross product
+        return TVector3(d[1] * op2.d[2] - d[2] * op2.d[1], d[2] * op2.d[0] - d[0] * op2.d[2],
             d[0] * op2.d[1] - d[1] * op2.d[0]);
     }
-    bool operator==(const Vector3& op2) const {
+    bool operator==(const TVector3& op2) const {
         return (d[0] == op2.d[0] && d[1] == op2.d[1] && d[2] == op2.d[2]);
     }
-    bool operator!=(const Vector3& op2) const {
+    bool operator!=(const TVector3& op2) const {
         return (d[0] != op2.d[0] || d[1] != op2.d[1] || d[2] != op2.d[2]);
     }
-    bool operator<(const Vector3& op2) const {
+    bool operator<(const TVector3& op2) const {
         return (d[0] < op2.d[0] && d[1] < op2.d[1] && d[2] < op2.d[2]);
     }
-    bool operator<=(const Vector3& op2) const {
+    bool operator<=(const TVector3& op2) const {
         return (d[0] <= op2.d[0] && d[1] <= op2.d[1] && d[2] <= op2.d[2]);
     }
 
 private:
-    float d[3];
+    T d[3];
 };
 
+typedef TVector3<float> Vector3;
+typedef TVector3<double> Vector3d;
+
 #endif // _VECTOR3_H_